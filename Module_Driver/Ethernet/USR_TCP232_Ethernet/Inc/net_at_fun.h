@@ -3,6 +3,13 @@
 
 extern at_device_t net_at_dev;
 
+/* 批量配置接口,依赖mcu_network_config_t,需在本文件前包含mcu_config.h */
+#if NETWORK_CONFIG == 1
+#define NET_AT_CONFIG_APPLY 1
+#else
+#define NET_AT_CONFIG_APPLY 0
+#endif
+
 /* 基础开关 */
 typedef enum
 {
@@ -110,4 +117,12 @@ at_cmd_status_t net_at_set_clientrst(net_switch_t switch_t);
 at_cmd_status_t net_at_set_uartset(net_switch_t switch_t);
 at_cmd_status_t net_at_set_strson(net_switch_t *strson);
 
+/* 批量配置函数 */
+
+#if NET_AT_CONFIG_APPLY == 1
+at_cmd_status_t net_at_config_load(void);
+void net_at_config_invalidate(void);
+at_cmd_status_t net_at_config_apply(const mcu_network_config_t *config);
+#endif
+
 #endif /* _NET_AT_FUN_H__ */
@@ -2,6 +2,7 @@
 #include "usart.h"
 #include "string.h"
 #include "stdlib.h"
+#include "mcu_config.h"
 #include "net_at_fun.h"
 
 #define NET_ACK_OK "+OK"
@@ -108,8 +109,7 @@ at_cmd_status_t net_at_restart(void)
 at_cmd_status_t net_at_get_echo(net_switch_t *echo)
 {
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _echo[4];
 
@@ -123,13 +123,16 @@ at_cmd_status_t net_at_get_echo(net_switch_t *echo)
     {
         return ret;
     }
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_echo, sizeof(_echo));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_echo, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _echo[param_len] = '\0';
 
     if(strcmp((char *)_echo, "ON") == 0)
     {
@@ -159,8 +162,7 @@ at_cmd_status_t net_at_get_echo(net_switch_t *echo)
 at_cmd_status_t net_at_get_uart(net_uart_baudrate_t *baudrate, net_uart_databits_t *databit, net_uart_stopbits_t *stopbit, char *paritybit)
 {
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _baudrate[7];
     uint8_t _databit[2];
@@ -179,13 +181,16 @@ at_cmd_status_t net_at_get_uart(net_uart_baudrate_t *baudrate, net_uart_databits
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_baudrate, sizeof(_baudrate));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_baudrate, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _baudrate[param_len] = '\0';
     switch(atoi((char *)_baudrate))
     {
         case 1200:
@@ -225,13 +230,11 @@ at_cmd_status_t net_at_get_uart(net_uart_baudrate_t *baudrate, net_uart_databits
             return AT_CMD_ERROR;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 2, &param_index, &param_len);
+    ret = at_ack_field_copy(&fields, 2, (char *)_databit, sizeof(_databit));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_databit, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _databit[param_len] = '\0';
     switch(atoi((char *)_databit))
     {
         case 7:
@@ -244,13 +247,11 @@ at_cmd_status_t net_at_get_uart(net_uart_baudrate_t *baudrate, net_uart_databits
             return AT_CMD_ERROR;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 3, &param_index, &param_len);
+    ret = at_ack_field_copy(&fields, 3, (char *)_stopbit, sizeof(_stopbit));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_stopbit, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _stopbit[param_len] = '\0';
     switch(atoi((char *)_stopbit))
     {
         case 1:
@@ -263,13 +264,11 @@ at_cmd_status_t net_at_get_uart(net_uart_baudrate_t *baudrate, net_uart_databits
             return AT_CMD_ERROR;
     }
     
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 4, &param_index, &param_len);
+    ret = at_ack_field_copy(&fields, 4, (char *)_paritybit, sizeof(_paritybit));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_paritybit, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _paritybit[param_len] = '\0';
     strcpy(paritybit, (char *)_paritybit);
 
     return ret;
@@ -284,11 +283,10 @@ at_cmd_status_t net_at_get_uart(net_uart_baudrate_t *baudrate, net_uart_databits
 at_cmd_status_t net_at_get_uarttl(uint8_t *pack_len, uint16_t *pack_time)
 {
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[15];
-    uint8_t _pack_len[4];
-    uint8_t _pack_time[5];
+    uint8_t _pack_len[5];
+    uint8_t _pack_time[6];
 
     if(pack_len == NULL || pack_time == NULL)
     {
@@ -301,22 +299,23 @@ at_cmd_status_t net_at_get_uarttl(uint8_t *pack_len, uint16_t *pack_time)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_pack_time, sizeof(_pack_time));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_pack_time, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _pack_time[param_len] = '\0';
     *pack_time = atoi((char *)_pack_time);
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 2, &param_index, &param_len);
+    ret = at_ack_field_copy(&fields, 2, (char *)_pack_len, sizeof(_pack_len));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_pack_len, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _pack_len[param_len] = '\0';
     *pack_len = atoi((char *)_pack_len);
 
     return ret;
@@ -330,8 +329,7 @@ at_cmd_status_t net_at_get_uarttl(uint8_t *pack_len, uint16_t *pack_time)
 at_cmd_status_t net_at_get_uartclbuf(net_switch_t *switch_status)
 {
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[15];
     uint8_t _switch[4];
 
@@ -346,13 +344,16 @@ at_cmd_status_t net_at_get_uartclbuf(net_switch_t *switch_status)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_switch, sizeof(_switch));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_switch, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _switch[param_len] = '\0';
     if(strcmp((char *)_switch, "ON") == 0)
     {
         *switch_status = NET_ON;
@@ -385,10 +386,9 @@ at_cmd_status_t net_at_get_wann(char *ipmode, char *ipaddr, char *mask, char *ga
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
-    uint8_t _ipmode[6];
+    uint8_t _ipmode[7];
     uint8_t _ipaddr[16];
     uint8_t _mask[16];
     uint8_t _gateway[16];
@@ -399,40 +399,37 @@ at_cmd_status_t net_at_get_wann(char *ipmode, char *ipaddr, char *mask, char *ga
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_ipmode, sizeof(_ipmode));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_ipmode, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _ipmode[param_len] = '\0';
     strcpy(ipmode, (char *)_ipmode);
     
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 2, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_field_copy(&fields, 2, (char *)_ipaddr, sizeof(_ipaddr));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_ipaddr, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _ipaddr[param_len] = '\0';
     strcpy(ipaddr, (char *)_ipaddr);
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 3, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_field_copy(&fields, 3, (char *)_mask, sizeof(_mask));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_mask, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _mask[param_len] = '\0';
     strcpy(mask, (char *)_mask);
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 4, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_field_copy(&fields, 4, (char *)_gateway, sizeof(_gateway));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_gateway, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _gateway[param_len] = '\0';
     strcpy(gateway, (char *)_gateway);
 
     return ret;
@@ -452,11 +449,10 @@ at_cmd_status_t net_at_get_webu(char *username, char *password)
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
-    uint8_t _username[16];
-    uint8_t _password[16];
+    uint8_t _username[17];
+    uint8_t _password[17];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "WEBU", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if (ret != AT_CMD_OK)
@@ -464,22 +460,23 @@ at_cmd_status_t net_at_get_webu(char *username, char *password)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_username, sizeof(_username));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_username, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _username[param_len] = '\0';
     strcpy(username, (char *)_username);
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 2, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_field_copy(&fields, 2, (char *)_password, sizeof(_password));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_password, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _password[param_len] = '\0';
     strcpy(password, (char *)_password);
 
     return ret;
@@ -503,8 +500,7 @@ at_cmd_status_t net_at_get_sock(char *work_mode, char *ipaddr, char *prot)
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _work_mode[5];
     uint8_t _ipaddr[16];
@@ -516,31 +512,30 @@ at_cmd_status_t net_at_get_sock(char *work_mode, char *ipaddr, char *prot)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_work_mode, sizeof(_work_mode));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_work_mode, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _work_mode[param_len] = '\0';
     strcpy(work_mode, (char *)_work_mode);
     
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 2, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_field_copy(&fields, 2, (char *)_ipaddr, sizeof(_ipaddr));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_ipaddr, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _ipaddr[param_len] = '\0';
     strcpy(ipaddr, (char *)_ipaddr);
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 3, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_field_copy(&fields, 3, (char *)_prot, sizeof(_prot));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_prot, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _prot[param_len] = '\0';
     strcpy(prot, (char *)_prot);
 
     return ret;
@@ -555,8 +550,7 @@ at_cmd_status_t net_at_get_socklk(net_switch_t *switch_status)
 {
     at_cmd_status_t ret = AT_CMD_OK;
     char cmd[10];
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char __switch[12];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "SOCKLK", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
@@ -565,13 +559,16 @@ at_cmd_status_t net_at_get_socklk(net_switch_t *switch_status)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, __switch, sizeof(__switch));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(__switch, net_at_dev.at_cmd_ack() + param_index, param_len);
-    __switch[param_len] = '\0';
     if(strcmp(__switch, "connect") == 0)
     {
         *switch_status = NET_ON;
@@ -602,8 +599,7 @@ at_cmd_status_t net_at_get_sockport(char *server_port, char *client_port)
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _server_port[6];
     uint8_t _client_port[6];
@@ -614,22 +610,23 @@ at_cmd_status_t net_at_get_sockport(char *server_port, char *client_port)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_server_port, sizeof(_server_port));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_server_port, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _server_port[param_len] = '\0';
     strcpy(server_port, (char *)_server_port);
     
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 2, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_field_copy(&fields, 2, (char *)_client_port, sizeof(_client_port));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_client_port, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _client_port[param_len] = '\0';
     strcpy(client_port, (char *)_client_port);
 
     return ret;
@@ -644,8 +641,7 @@ at_cmd_status_t net_at_get_dhcpen(net_switch_t *switch_t)
 {
     at_cmd_status_t ret = AT_CMD_OK;
     char cmd[10];
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char __switch[4];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "DHCPEN", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
@@ -654,13 +650,16 @@ at_cmd_status_t net_at_get_dhcpen(net_switch_t *switch_t)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, __switch, sizeof(__switch));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(__switch, net_at_dev.at_cmd_ack() + param_index, param_len);
-    __switch[param_len] = '\0';
     if(strcmp(__switch, "ON") == 0)
     {
         *switch_t = NET_ON;
@@ -685,10 +684,9 @@ at_cmd_status_t net_at_get_dhcpen(net_switch_t *switch_t)
 at_cmd_status_t net_at_get_dnsmode(char *dns_mode)
 {
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
-    uint8_t _dns_mode[6];
+    uint8_t _dns_mode[7];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "DNSMODE", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if (ret != AT_CMD_OK)
@@ -696,13 +694,16 @@ at_cmd_status_t net_at_get_dnsmode(char *dns_mode)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_dns_mode, sizeof(_dns_mode));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_dns_mode, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _dns_mode[param_len] = '\0';
     strcpy(dns_mode, (char *)_dns_mode);
 
     return ret;
@@ -721,8 +722,7 @@ at_cmd_status_t net_at_get_dns(char *addr)
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _addr[16];
 
@@ -732,13 +732,16 @@ at_cmd_status_t net_at_get_dns(char *addr)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_addr, sizeof(_addr));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_addr, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _addr[param_len] = '\0';
     strcpy(addr, (char *)_addr);
 
     return ret;
@@ -757,8 +760,7 @@ at_cmd_status_t net_at_get_webport(char *port)
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _port[6];
 
@@ -768,13 +770,16 @@ at_cmd_status_t net_at_get_webport(char *port)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_port, sizeof(_port));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_port, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _port[param_len] = '\0';
     strcpy(port, (char *)_port);
 
     return ret;
@@ -794,11 +799,10 @@ at_cmd_status_t net_at_get_search(char *port, char *atcmd)
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _port[6];
-    uint8_t _atcmd[32];
+    uint8_t _atcmd[33];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "SEARCH", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if (ret != AT_CMD_OK)
@@ -806,22 +810,23 @@ at_cmd_status_t net_at_get_search(char *port, char *atcmd)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_port, sizeof(_port));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_port, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _port[param_len] = '\0';
     strcpy(port, (char *)_port);
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 2, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_field_copy(&fields, 2, (char *)_atcmd, sizeof(_atcmd));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_atcmd, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _atcmd[param_len] = '\0';
     strcpy(atcmd, (char *)_atcmd);
 
     return ret;
@@ -840,8 +845,7 @@ at_cmd_status_t net_at_get_tcpreip(char *ipaddr)
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _ipaddr[16];
 
@@ -851,13 +855,16 @@ at_cmd_status_t net_at_get_tcpreip(char *ipaddr)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_ipaddr, sizeof(_ipaddr));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_ipaddr, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _ipaddr[param_len] = '\0';
     strcpy(ipaddr, (char *)_ipaddr);
 
     return ret;
@@ -876,8 +883,7 @@ at_cmd_status_t net_at_get_maxsk(uint8_t *maxsk)
     }
 
     at_cmd_status_t ret = AT_CMD_OK;
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     char cmd[10];
     uint8_t _maxsk[4];
 
@@ -887,13 +893,16 @@ at_cmd_status_t net_at_get_maxsk(uint8_t *maxsk)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_maxsk, sizeof(_maxsk));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_maxsk, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _maxsk[param_len] = '\0';
     *maxsk = atoi((char *)_maxsk);
 
     return ret;
@@ -914,8 +923,7 @@ at_cmd_status_t net_at_get_ping(char *addr, char *result)
 
     at_cmd_status_t ret = AT_CMD_OK;
     char cmd[75];
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     uint8_t _result[8];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "PING", addr), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
@@ -924,13 +932,16 @@ at_cmd_status_t net_at_get_ping(char *addr, char *result)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_result, sizeof(_result));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_result, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _result[param_len] = '\0';
     strcpy(result, (char *)_result);
 
     return ret;
@@ -950,8 +961,7 @@ at_cmd_status_t net_at_get_mid(char *mid)
 
     at_cmd_status_t ret = AT_CMD_OK;
     char cmd[10];
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     uint8_t _mid[16];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "MID", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
@@ -960,13 +970,16 @@ at_cmd_status_t net_at_get_mid(char *mid)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_mid, sizeof(_mid));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_mid, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _mid[param_len] = '\0';
     strcpy(mid, (char *)_mid);
 
     return ret;
@@ -986,9 +999,8 @@ at_cmd_status_t net_at_get_rstim(char *time)
 
     at_cmd_status_t ret = AT_CMD_OK;
     char cmd[10];
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
-    uint8_t _time[5];
+    at_ack_fields_t fields;
+    uint8_t _time[6];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "RSTIM", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if (ret != AT_CMD_OK)
@@ -996,13 +1008,16 @@ at_cmd_status_t net_at_get_rstim(char *time)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
-    if (ret != AT_CMD_OK)
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_time, sizeof(_time));
+    if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_time, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _time[param_len] = '\0';
     strcpy(time, (char *)_time);
 
     return ret;
@@ -1017,8 +1032,7 @@ at_cmd_status_t net_at_get_clientrst(net_switch_t *switch_t)
 {
     at_cmd_status_t ret = AT_CMD_OK;
     char cmd[10];
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     uint8_t _switch[4];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "CLIENTRST", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
@@ -1027,13 +1041,16 @@ at_cmd_status_t net_at_get_clientrst(net_switch_t *switch_t)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_switch, sizeof(_switch));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_switch, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _switch[param_len] = '\0';
     if(strcmp((char *)_switch, "ON") == 0)
     {
         *switch_t = NET_ON;
@@ -1059,8 +1076,7 @@ at_cmd_status_t net_at_get_uartset(net_switch_t *switch_t)
 {
     at_cmd_status_t ret = AT_CMD_OK;
     char cmd[10];
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
+    at_ack_fields_t fields;
     uint8_t _switch[4];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "UARTSET", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
@@ -1069,13 +1085,16 @@ at_cmd_status_t net_at_get_uartset(net_switch_t *switch_t)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_switch, sizeof(_switch));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_switch, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _switch[param_len] = '\0';
     if(strcmp((char *)_switch, "ON") == 0)
     {
         *switch_t = NET_ON;
@@ -1106,9 +1125,8 @@ at_cmd_status_t net_at_get_strson(char *strson)
 
     at_cmd_status_t ret = AT_CMD_OK;
     char cmd[10];
-    uint16_t param_index = 0;
-    uint16_t param_len = 0;
-    uint8_t _strson[4];
+    at_ack_fields_t fields;
+    uint8_t _strson[5];
 
     ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "STRSON", NULL), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if(ret != AT_CMD_OK)
@@ -1116,13 +1134,16 @@ at_cmd_status_t net_at_get_strson(char *strson)
         return ret;
     }
 
-    ret = at_ack_get_normal_parameter(net_at_dev.at_cmd_ack(), 1, &param_index, &param_len);
+    ret = at_ack_tokenize(net_at_dev.at_cmd_ack(), NET_ACK_OK, &fields);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    ret = at_ack_field_copy(&fields, 1, (char *)_strson, sizeof(_strson));
     if(ret != AT_CMD_OK)
     {
         return ret;
     }
-    memcpy(_strson, net_at_dev.at_cmd_ack() + param_index, param_len);
-    _strson[param_len] = '\0';
     strcpy(strson, (char *)_strson);
 
     return ret;
@@ -1335,7 +1356,7 @@ at_cmd_status_t net_at_set_sockport(char *server_port, char *client_port)
     char cmd_para[15];
 
     sprintf(cmd_para, "%s,%s", server_port, client_port);
-    ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "SOCKPORTAN", cmd_para), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
+    ret = at_cmd_send(&net_at_dev, at_cmd_pack(cmd, "SOCKPORT", cmd_para), NET_ACK_OK, AT_WAIT_ACK_TIMEOUT);
 
     return ret;
 }
@@ -1589,3 +1610,174 @@ at_cmd_status_t net_at_set_strson(net_switch_t *switch_t)
 
     return ret;
 }
+
+#if NET_AT_CONFIG_APPLY == 1
+
+/* 批量配置 */
+
+static mcu_network_config_t net_at_config_cache;//模块当前配置快照
+static char net_at_config_sockport[6];//SOCKPORT中的服务器端口,可能与SOCK中的端口不同
+static uint8_t net_at_config_cached = 0;
+
+#define NET_AT_CONFIG_WANN     (1 << 0)
+#define NET_AT_CONFIG_SOCK     (1 << 1)
+#define NET_AT_CONFIG_SOCKPORT (1 << 2)
+
+/**
+ * @brief  比较目标配置与快照,得到需要下发的命令
+ * @param  config: 目标配置
+ * @retval 需要下发的命令位图,NET_AT_CONFIG_xxx
+ */
+static uint8_t net_at_config_diff(const mcu_network_config_t *config)
+{
+    const mcu_network_config_t *cache = &net_at_config_cache;
+    uint8_t diff = 0;
+
+    if(net_at_config_cached == 0)
+    {
+        return NET_AT_CONFIG_WANN | NET_AT_CONFIG_SOCK | NET_AT_CONFIG_SOCKPORT;
+    }
+    //DHCP模式下静态地址不下发,无需比较
+    if((config->dhcp_flag != 0) != (cache->dhcp_flag != 0) ||
+       (config->dhcp_flag == 0 &&
+        (strncmp(config->static_local_ip, cache->static_local_ip, sizeof(config->static_local_ip)) != 0 ||
+         strncmp(config->local_mask, cache->local_mask, sizeof(config->local_mask)) != 0 ||
+         strncmp(config->local_gateway, cache->local_gateway, sizeof(config->local_gateway)) != 0)))
+    {
+        diff |= NET_AT_CONFIG_WANN;
+    }
+    if(strncmp(config->tcp_server_ip, cache->tcp_server_ip, sizeof(config->tcp_server_ip)) != 0 ||
+       strncmp(config->tcp_server_port, cache->tcp_server_port, sizeof(config->tcp_server_port)) != 0)
+    {
+        diff |= NET_AT_CONFIG_SOCK;
+    }
+    if(strncmp(config->tcp_server_port, net_at_config_sockport, sizeof(net_at_config_sockport)) != 0 ||
+       strncmp(config->static_local_port, cache->static_local_port, sizeof(config->static_local_port)) != 0)
+    {
+        diff |= NET_AT_CONFIG_SOCKPORT;
+    }
+    return diff;
+}
+
+/**
+ * @brief  读取模块当前网络配置作为快照
+ * @note   进入AT模式一次,查询WANN/SOCK/SOCKPORT后退回透传模式
+ */
+at_cmd_status_t net_at_config_load(void)
+{
+    at_cmd_status_t ret = AT_CMD_OK;
+    mcu_network_config_t *cache = &net_at_config_cache;
+    char ipmode[7];
+    char work_mode[5];
+
+    net_at_config_cached = 0;
+    ret = net_at_mode_entry();
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+
+    ret = net_at_get_wann(ipmode, cache->static_local_ip, cache->local_mask, cache->local_gateway);
+    if(ret == AT_CMD_OK)
+    {
+        cache->dhcp_flag = (strcmp(ipmode, "DHCP") == 0);
+        ret = net_at_get_sock(work_mode, cache->tcp_server_ip, cache->tcp_server_port);
+    }
+    if(ret == AT_CMD_OK)
+    {
+        ret = net_at_get_sockport(net_at_config_sockport, cache->static_local_port);
+    }
+    if(net_at_mode_exit() != AT_CMD_OK && ret == AT_CMD_OK)
+    {
+        ret = AT_CMD_ERROR;
+    }
+    if(ret == AT_CMD_OK)
+    {
+        net_at_config_cached = 1;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief  快照失效,下次apply下发全部配置
+ */
+void net_at_config_invalidate(void)
+{
+    net_at_config_cached = 0;
+}
+
+/**
+ * @brief  声明式下发网络配置
+ * @param  config: 目标配置
+ * @retval AT_CMD_OK: 配置一致或下发成功
+ * @note   只下发与快照不同的命令,全程只进入一次AT模式,
+ *         有改动时以AT+CFGTF保存并AT+Z重启生效;
+ *         无快照时(未调用net_at_config_load或上次失败)下发全部命令
+ */
+at_cmd_status_t net_at_config_apply(const mcu_network_config_t *config)
+{
+    at_cmd_status_t ret = AT_CMD_OK;
+    uint8_t diff;
+
+    if(config == NULL)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+
+    diff = net_at_config_diff(config);
+    if(diff == 0)
+    {
+        return AT_CMD_OK;
+    }
+
+    ret = net_at_mode_entry();
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    //下发过程中失败则模块状态未知,快照作废
+    net_at_config_cached = 0;
+
+    if(diff & NET_AT_CONFIG_WANN)
+    {
+        if(config->dhcp_flag)
+        {
+            ret = net_at_set_wann("DHCP", NULL, NULL, NULL);
+        }
+        else
+        {
+            ret = net_at_set_wann("STATIC", (char *)config->static_local_ip,
+                                  (char *)config->local_mask, (char *)config->local_gateway);
+        }
+    }
+    if(ret == AT_CMD_OK && (diff & NET_AT_CONFIG_SOCK))
+    {
+        ret = net_at_set_sock("TCPC", (char *)config->tcp_server_ip, (char *)config->tcp_server_port);
+    }
+    if(ret == AT_CMD_OK && (diff & NET_AT_CONFIG_SOCKPORT))
+    {
+        ret = net_at_set_sockport((char *)config->tcp_server_port, (char *)config->static_local_port);
+    }
+    if(ret == AT_CMD_OK)
+    {
+        ret = net_at_save();
+    }
+    if(ret != AT_CMD_OK)
+    {
+        net_at_mode_exit();
+        return ret;
+    }
+
+    ret = net_at_restart();
+    if(ret == AT_CMD_OK)
+    {
+        net_at_config_cache = *config;
+        strncpy(net_at_config_sockport, config->tcp_server_port, sizeof(net_at_config_sockport));
+        net_at_config_cached = 1;
+    }
+
+    return ret;
+}
+
+#endif /* NET_AT_CONFIG_APPLY */
@@ -88,6 +88,18 @@ typedef enum
     LORA_UARTPARI_ODD        = 2,    /* 奇校验 */
 } lora_uartpari_t;
 
+/* 模块参数,用于缓存与差异配置 */
+typedef struct
+{
+    uint16_t addr;                   /* 设备地址 */
+    lora_tpower_t tpower;            /* 发射功率 */
+    lora_workmode_t workmode;        /* 工作模式 */
+    lora_tmode_t tmode;              /* 发射模式 */
+    lora_wlrate_t wlrate;            /* 空中速率 */
+    uint8_t channel;                 /* 信道，范围0~83 */
+    uint8_t netid;                   /* 网络地址 */
+} lora_param_t;
+
 /* 错误代码 */
 #define LORA_EOK             0       /* 没有错误 */
 #define LORA_ERROR           1       /* 通用错误 */
@@ -116,5 +128,8 @@ uint8_t lora_packsize_config(lora_packsize_t packsize);
 uint8_t lora_datakey_config(uint32_t datakey);                                         /* LORA模块数据加密密钥配置 */
 uint8_t lora_uaconfig(lora_uartrate_t baudrate, lora_uartpari_t parity);    				/* LORA模块串口配置 */
 uint8_t lora_lbt_config(lora_enable_t enable);                                         /* LORA模块信道检测配置 */
+void lora_cache_invalidate(void);                                                            /* LORA模块参数缓存失效 */
+uint8_t lora_param_read(lora_param_t *param);                                                /* 从缓存读取LORA模块参数 */
+uint8_t lora_param_apply(const lora_param_t *param);                                         /* 按缓存差异配置LORA模块 */
 
 #endif /* _LORA_AT_FUN_H__ */
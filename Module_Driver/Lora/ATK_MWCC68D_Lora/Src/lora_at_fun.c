@@ -10,6 +10,35 @@
 
 at_device_t lora_at_dev;
 
+/* 模块参数缓存,写穿透 */
+
+#define LORA_CACHE_ADDR     (1 << 0)
+#define LORA_CACHE_TPOWER   (1 << 1)
+#define LORA_CACHE_WORKMODE (1 << 2)
+#define LORA_CACHE_TMODE    (1 << 3)
+#define LORA_CACHE_WLRATE   (1 << 4)//空中速率和信道为同一条命令
+#define LORA_CACHE_NETID    (1 << 5)
+#define LORA_CACHE_ALL      (LORA_CACHE_ADDR | LORA_CACHE_TPOWER | LORA_CACHE_WORKMODE | \
+                             LORA_CACHE_TMODE | LORA_CACHE_WLRATE | LORA_CACHE_NETID)
+
+static lora_param_t lora_cache;
+static uint8_t lora_cache_valid = 0;//LORA_CACHE_xxx位图
+
+/**
+ * @brief       更新缓存中的一项,配置成功时置位,失败时清除
+ */
+static void lora_cache_update(uint8_t ret, uint8_t item)
+{
+    if (ret == LORA_EOK)
+    {
+        lora_cache_valid |= item;
+    }
+    else
+    {
+        lora_cache_valid &= ~item;
+    }
+}
+
 /**
  * @brief     LoRa AT设备初始化
 */
@@ -134,6 +163,7 @@ uint8_t lora_sw_reset(void)
 {
     uint8_t ret;
     
+    lora_cache_invalidate();
     ret = at_cmd_send(&lora_at_dev, "AT+RESET", "OK", AT_WAIT_ACK_TIMEOUT);
     if (ret != LORA_EOK)
     {
@@ -193,6 +223,7 @@ uint8_t lora_default(void)
 {
     uint8_t ret;
     
+    lora_cache_invalidate();
     ret = at_cmd_send(&lora_at_dev, "AT+DEFAULT", "OK", AT_WAIT_ACK_TIMEOUT);
     if (ret != LORA_EOK)
     {
@@ -216,6 +247,8 @@ uint8_t lora_addr_config(uint16_t addr)
     sprintf(cmd, "AT+ADDR=%02X,%02X", (uint8_t)(addr >> 8) & 0xFF, (uint8_t)addr & 0xFF);
     
     ret = at_cmd_send(&lora_at_dev, cmd, "OK", AT_WAIT_ACK_TIMEOUT);
+    lora_cache.addr = addr;
+    lora_cache_update(ret, LORA_CACHE_ADDR);
     if (ret != LORA_EOK)
     {
         return LORA_ERROR;
@@ -259,6 +292,8 @@ uint8_t lora_tpower_config(lora_tpower_t tpower)
     sprintf(cmd, "AT+TPOWER=%d", tpower);
     
     ret = at_cmd_send(&lora_at_dev, cmd, "OK", AT_WAIT_ACK_TIMEOUT);
+    lora_cache.tpower = tpower;
+    lora_cache_update(ret, LORA_CACHE_TPOWER);
     if (ret != LORA_EOK)
     {
         return LORA_ERROR;
@@ -304,6 +339,8 @@ uint8_t lora_workmode_config(lora_workmode_t workmode)
     sprintf(cmd, "AT+CWMODE=%d", workmode);
     
     ret = at_cmd_send(&lora_at_dev, cmd, "OK", AT_WAIT_ACK_TIMEOUT);
+    lora_cache.workmode = workmode;
+    lora_cache_update(ret, LORA_CACHE_WORKMODE);
     if (ret != LORA_EOK)
     {
         return LORA_ERROR;
@@ -341,6 +378,8 @@ uint8_t lora_tmode_config(lora_tmode_t tmode)
     sprintf(cmd, "AT+TMODE=%d", tmode);
     
     ret = at_cmd_send(&lora_at_dev, cmd, "OK", AT_WAIT_ACK_TIMEOUT);
+    lora_cache.tmode = tmode;
+    lora_cache_update(ret, LORA_CACHE_TMODE);
     if (ret != LORA_EOK)
     {
         return LORA_ERROR;
@@ -394,6 +433,9 @@ uint8_t lora_wlrate_channel_config(lora_wlrate_t wlrate, uint8_t channel)
     sprintf(cmd, "AT+WLRATE=%d,%d", channel, wlrate);
     
     ret = at_cmd_send(&lora_at_dev, cmd, "OK", AT_WAIT_ACK_TIMEOUT);
+    lora_cache.wlrate = wlrate;
+    lora_cache.channel = channel;
+    lora_cache_update(ret, LORA_CACHE_WLRATE);
     if (ret != LORA_EOK)
     {
         return LORA_ERROR;
@@ -416,6 +458,8 @@ uint8_t lora_netid_config(uint8_t netid)
     sprintf(cmd, "AT+NETID=%d", netid);
     
     ret = at_cmd_send(&lora_at_dev, cmd, "OK", AT_WAIT_ACK_TIMEOUT);
+    lora_cache.netid = netid;
+    lora_cache_update(ret, LORA_CACHE_NETID);
     if (ret != LORA_EOK)
     {
         return LORA_ERROR;
@@ -630,3 +674,110 @@ uint8_t lora_lbt_config(lora_enable_t enable)
     
     return LORA_EOK;
 }
+
+/**
+ * @brief       ATK-MWCC68D模块参数缓存失效
+ * @note        lora_sw_reset/lora_default已自动调用;硬件复位或掉电需手动调用
+ * @param       无
+ * @retval      无
+ */
+void lora_cache_invalidate(void)
+{
+    lora_cache_valid = 0;
+}
+
+/**
+ * @brief       从缓存读取ATK-MWCC68D模块参数,不产生串口数据
+ * @param       param: 模块参数
+ * @retval      LORA_EOK   : 读取成功
+ *              LORA_EINVAL: 参数未全部缓存(复位后尚未配置)
+ */
+uint8_t lora_param_read(lora_param_t *param)
+{
+    if (param == NULL || lora_cache_valid != LORA_CACHE_ALL)
+    {
+        return LORA_EINVAL;
+    }
+    
+    *param = lora_cache;
+    
+    return LORA_EOK;
+}
+
+/**
+ * @brief       按缓存差异配置ATK-MWCC68D模块
+ * @note        全部一致时不切换MD0也不产生串口数据,
+ *              否则只进入一次配置模式,只下发不同或未缓存的参数
+ * @param       param: 目标参数
+ * @retval      LORA_EOK   : 参数一致或配置成功
+ *              LORA_ERROR : 配置失败
+ *              LORA_EINVAL: 输入参数有误
+ */
+uint8_t lora_param_apply(const lora_param_t *param)
+{
+    uint8_t ret = LORA_EOK;
+    uint8_t diff = LORA_CACHE_ALL & ~lora_cache_valid;
+    
+    if (param == NULL)
+    {
+        return LORA_EINVAL;
+    }
+    
+    if (param->addr != lora_cache.addr)
+    {
+        diff |= LORA_CACHE_ADDR;
+    }
+    if (param->tpower != lora_cache.tpower)
+    {
+        diff |= LORA_CACHE_TPOWER;
+    }
+    if (param->workmode != lora_cache.workmode)
+    {
+        diff |= LORA_CACHE_WORKMODE;
+    }
+    if (param->tmode != lora_cache.tmode)
+    {
+        diff |= LORA_CACHE_TMODE;
+    }
+    if (param->wlrate != lora_cache.wlrate || param->channel != lora_cache.channel)
+    {
+        diff |= LORA_CACHE_WLRATE;
+    }
+    if (param->netid != lora_cache.netid)
+    {
+        diff |= LORA_CACHE_NETID;
+    }
+    if (diff == 0)
+    {
+        return LORA_EOK;
+    }
+    
+    lora_enter_config();
+    if (diff & LORA_CACHE_ADDR)
+    {
+        ret = lora_addr_config(param->addr);
+    }
+    if (ret == LORA_EOK && (diff & LORA_CACHE_TPOWER))
+    {
+        ret = lora_tpower_config(param->tpower);
+    }
+    if (ret == LORA_EOK && (diff & LORA_CACHE_WORKMODE))
+    {
+        ret = lora_workmode_config(param->workmode);
+    }
+    if (ret == LORA_EOK && (diff & LORA_CACHE_TMODE))
+    {
+        ret = lora_tmode_config(param->tmode);
+    }
+    if (ret == LORA_EOK && (diff & LORA_CACHE_WLRATE))
+    {
+        ret = lora_wlrate_channel_config(param->wlrate, param->channel);
+    }
+    if (ret == LORA_EOK && (diff & LORA_CACHE_NETID))
+    {
+        ret = lora_netid_config(param->netid);
+    }
+    lora_exit_config();
+    
+    return ret;
+}
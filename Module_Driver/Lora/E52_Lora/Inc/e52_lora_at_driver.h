@@ -59,6 +59,19 @@ typedef enum
     E52_LORA_SAVE_TO_FLASH = 1,
 }e52_lora_at_save_t;
 
+/**
+ * @brief  e52-lora模块参数,用于缓存与差异下发
+ */
+typedef struct
+{
+    int8_t transmit_power;//射频功率,-9~22dBm
+    uint8_t channel;//信道
+    uint16_t src_addr;//源地址
+    uint16_t dst_addr;//目的地址
+    uint16_t panid;
+    e52_lora_at_option_t option;
+}e52_lora_at_param_t;
+
 /**
  * @brief  e52-lora消息结构体
  * @note   直接指针转换或者memcpy
@@ -88,6 +101,23 @@ typedef struct
     uint8_t ack_data[198];
 }e52_lora_ack_t;
 
+/**
+ * @brief  e52-lora消息视图,由e52_lora_msg_parse生成,不拷贝数据
+ * @param  data: 指向接收缓冲区内的数据(不含自定义前置包信息),缓冲区被覆盖后失效
+ * @param  data_len: 数据长度,已减去自定义前置包信息
+ */
+typedef struct
+{
+    uint8_t head_type;
+    uint8_t pack_type;
+    uint8_t pack_num;
+    uint16_t panid;
+    uint16_t src_addr;
+    uint16_t dst_addr;
+    uint16_t data_len;
+    const uint8_t *data;
+}e52_lora_msg_view_t;
+
 /**
  * @brief E52 LoRa 通信确认消息定义
  * @{
@@ -135,6 +165,53 @@ typedef struct
 
 /** @} */
 
+/**
+ * @brief E52 LoRa 分包收发
+ * @note  单包: pack_type=0, pack_num=0, data为完整数据(<=198字节)
+ * @note  预通知: pack_type=2, pack_num=包总数, data=[大包长度低字节, 高字节, 序号]
+ * @note  分包: pack_type=1, pack_num=包序号(从0开始), data为该段数据
+ * @note  应答(接收端发出, pack_type=2, data以ACK字符串开头, 后跟序号):
+ * @note    PACK RECEIVE: pack_num=包总数, 大包接收完成
+ * @note    PACK RESEND: pack_num=首个缺失序号, 序号后附全部缺失序号, 发送端只重发这些分包
+ * @note    PACK FAIL: pack_num=包总数加1, 请求全部重发(未收到预通知时)
+ * @note  发送端等待应答超时后重发预通知作为查询, 接收端据此应答完成或缺失列表
+ * @{
+ */
+
+#define E52_PACK_DATA_LEN       198//单包最大有效数据长度
+#define E52_PACK_MAX_NUM        32//单个大包最大分包数,接收位图为uint32_t,不可超过32
+#define E52_PACK_MAX_LEN        2048//大包最大长度,不超过E52_PACK_DATA_LEN * E52_PACK_MAX_NUM
+#define E52_PACK_RX_SLOT_NUM    2//重组池大小,即可同时接收的大包数,按源地址区分
+#define E52_PACK_RX_TIMEOUT_MS  3000//接收端分包间隔超时,超时后请求重发缺失分包
+#define E52_PACK_NACK_RETRY     3//接收端连续请求重发次数,超过后丢弃该大包
+#define E52_PACK_DONE_HOLD_MS   30000//重组完成后保留时长,用于应答发送端的重复查询,应覆盖发送端全部重试时间
+#define E52_PACK_TX_TIMEOUT_MS  5000//发送端等待应答超时
+#define E52_PACK_TX_RETRY       5//发送端重发轮数,超过后发送失败
+#define E52_PACK_TX_INTERVAL_MS 50//分包发送间隔,避免模块缓存溢出(OUT OF CACHE)
+
+typedef enum
+{
+    E52_PACK_TYPE_SINGLE = 0,
+    E52_PACK_TYPE_FRAGMENT = 1,
+    E52_PACK_TYPE_NOTIFY = 2,
+}e52_lora_pack_type_t;
+
+/**
+ * @brief  接收完成回调
+ * @param  src_addr: 源地址
+ * @param  data: 完整数据,回调返回后失效
+ * @param  len: 数据长度
+ */
+typedef void (*p_e52_pack_recv)(uint16_t src_addr, uint8_t *data, uint16_t len);
+
+/**
+ * @brief  大包发送结束回调
+ * @param  dst_addr: 目的地址
+ * @param  status: AT_CMD_OK-对端已完整接收 AT_CMD_TIMEOUT-重发次数耗尽
+ */
+typedef void (*p_e52_pack_sent)(uint16_t dst_addr, at_cmd_status_t status);
+
+/** @} */
 
 
 void e52_lora_at_driver_init(void);
@@ -168,7 +245,17 @@ at_cmd_status_t e52_lora_at_set_group_clr(void);
 at_cmd_status_t e52_lora_at_set_group_del(uint16_t group_addr);
 at_cmd_status_t e52_lora_at_set_group_add(uint16_t group_addr);
 
+void e52_lora_at_cache_invalidate(void);
+at_cmd_status_t e52_lora_at_param_apply(const e52_lora_at_param_t *param, e52_lora_at_save_t save);
+
+at_cmd_status_t e52_lora_msg_parse(const uint8_t *frame, uint16_t len, e52_lora_msg_view_t *view);
 e52_lora_msg_t e52_lora_msg_analyse(uint8_t *data, uint16_t len);
 uint8_t e52_lora_ack_analyse(uint8_t *data, uint16_t len);
 
+void e52_lora_pack_init(p_e52_pack_recv recv, p_e52_pack_sent sent);
+at_cmd_status_t e52_lora_pack_send(uint16_t dst_addr, const uint8_t *data, uint16_t len);
+void e52_lora_pack_input(const uint8_t *frame, uint16_t len);
+void e52_lora_pack_poll(void);
+uint8_t e52_lora_pack_tx_busy(void);
+
 #endif /* __E52_LORA_AT_DRIVER_H__ */
@@ -3,10 +3,47 @@
 #include "usart.h"
 #include "sys_delay.h"
 #include "string.h"
+#include "stdlib.h"
 #include "e52_lora_at_driver.h"
 
+#define E52_LORA_LOG_LEVEL 0//0-关闭 1-帧头及应答 2-同时打印数据
+#if E52_LORA_LOG_LEVEL >= 1
+#define E52_LORA_LOG(fmt, ...) printf("[E52] " fmt "\r\n", ##__VA_ARGS__)
+#else
+#define E52_LORA_LOG(fmt, ...)
+#endif
+
 at_device_t e52_lora_at_dev;
 
+/* 模块参数缓存,写穿透 */
+
+#define E52_CACHE_POWER    (1 << 0)
+#define E52_CACHE_CHANNEL  (1 << 1)
+#define E52_CACHE_SRC_ADDR (1 << 2)
+#define E52_CACHE_DST_ADDR (1 << 3)
+#define E52_CACHE_PANID    (1 << 4)
+#define E52_CACHE_OPTION   (1 << 5)
+#define E52_CACHE_ALL      (E52_CACHE_POWER | E52_CACHE_CHANNEL | E52_CACHE_SRC_ADDR | \
+                            E52_CACHE_DST_ADDR | E52_CACHE_PANID | E52_CACHE_OPTION)
+
+static e52_lora_at_param_t e52_lora_at_cache;
+static uint8_t e52_lora_at_cache_valid = 0;//E52_CACHE_xxx位图
+
+/**
+ * @brief  更新缓存中的一项,set/query成功时置位,失败时清除
+ */
+static void e52_lora_at_cache_update(at_cmd_status_t ret, uint8_t item)
+{
+    if(ret == AT_CMD_OK)
+    {
+        e52_lora_at_cache_valid |= item;
+    }
+    else
+    {
+        e52_lora_at_cache_valid &= ~item;
+    }
+}
+
 void e52_lora_at_driver_init(void)
 {
     e52_lora_at_dev.at_id = 0;
@@ -24,6 +61,7 @@ void e52_lora_at_driver_init(void)
  */
 at_cmd_status_t e52_lora_at_reset(void)
 {
+    e52_lora_at_cache_invalidate();
     return at_sp_cmd_send(&e52_lora_at_dev, "AT+RESET", "OK", AT_WAIT_ACK_TIMEOUT);
 }
 
@@ -40,12 +78,17 @@ at_cmd_status_t e52_lora_at_query_transmit_power(int8_t *transmit_power)
     at_cmd_status_t ret;
     uint16_t param_index;
     uint16_t param_len;
-    int8_t _transmit_power[2];
+    char _transmit_power[4];
 
     if(transmit_power == NULL)
     {
         return AT_CMD_PARMINVAL;
     }
+    if(e52_lora_at_cache_valid & E52_CACHE_POWER)
+    {
+        *transmit_power = e52_lora_at_cache.transmit_power;
+        return AT_CMD_OK;
+    }
 
     ret = at_sp_cmd_send(&e52_lora_at_dev, "AT+POWER=?", "OK", AT_WAIT_ACK_TIMEOUT);
     if(ret != AT_CMD_OK)
@@ -59,9 +102,15 @@ at_cmd_status_t e52_lora_at_query_transmit_power(int8_t *transmit_power)
         return ret;
     }
 
+    if(param_len >= sizeof(_transmit_power))
+    {
+        return AT_CMD_ERROR;
+    }
     memcpy(_transmit_power, e52_lora_at_dev.at_cmd_ack() + param_index, param_len);
     _transmit_power[param_len] = '\0';
-    printf("transmit power: %s\r\n", _transmit_power);
+    *transmit_power = (int8_t)atoi(_transmit_power);
+    e52_lora_at_cache.transmit_power = *transmit_power;
+    e52_lora_at_cache_valid |= E52_CACHE_POWER;
 
     return ret;
 }
@@ -76,12 +125,17 @@ at_cmd_status_t e52_lora_at_query_channel(uint8_t *channel)
     at_cmd_status_t ret;
     uint16_t param_index;
     uint16_t param_len;
-    uint8_t _channel[2];
+    char _channel[4];
 
     if(channel == NULL)
     {
         return AT_CMD_PARMINVAL;
     }
+    if(e52_lora_at_cache_valid & E52_CACHE_CHANNEL)
+    {
+        *channel = e52_lora_at_cache.channel;
+        return AT_CMD_OK;
+    }
 
     ret = at_sp_cmd_send(&e52_lora_at_dev, "AT+CH=?", "OK", AT_WAIT_ACK_TIMEOUT);
     if(ret != AT_CMD_OK)
@@ -95,9 +149,15 @@ at_cmd_status_t e52_lora_at_query_channel(uint8_t *channel)
         return ret;
     }
 
+    if(param_len >= sizeof(_channel))
+    {
+        return AT_CMD_ERROR;
+    }
     memcpy(_channel, e52_lora_at_dev.at_cmd_ack() + param_index, param_len);
     _channel[param_len] = '\0';
-    printf("channel: %s\r\n", _channel);
+    *channel = (uint8_t)atoi(_channel);
+    e52_lora_at_cache.channel = *channel;
+    e52_lora_at_cache_valid |= E52_CACHE_CHANNEL;
 
     return ret;
 }
@@ -133,7 +193,7 @@ at_cmd_status_t e52_lora_at_query_ack_time(uint16_t *ack_time)
 
     memcpy(_ack_time, e52_lora_at_dev.at_cmd_ack() + param_index, param_len);
     _ack_time[param_len] = '\0';
-    printf("ack time: %s\r\n", _ack_time);
+    E52_LORA_LOG("ack time: %s", _ack_time);
 
     return ret;
 }
@@ -169,7 +229,7 @@ at_cmd_status_t e52_lora_at_query_router_time(uint16_t *router_time)
 
     memcpy(_router_time, e52_lora_at_dev.at_cmd_ack() + param_index, param_len);
     _router_time[param_len] = '\0';
-    printf("router time: %s\r\n", _router_time);
+    E52_LORA_LOG("router time: %s", _router_time);
 
     return ret;
 }
@@ -202,7 +262,7 @@ at_cmd_status_t e52_lora_at_set_transmit_power(int8_t transmit_power, e52_lora_a
 {
     at_cmd_status_t ret;
     char cmd[15];
-    char param[5];
+    char param[8];
     if(transmit_power < -9 || transmit_power > 22)
     {
         transmit_power = 22;
@@ -210,6 +270,8 @@ at_cmd_status_t e52_lora_at_set_transmit_power(int8_t transmit_power, e52_lora_a
     sprintf(param, "%d,%d", transmit_power, save);
 
     ret = at_sp_cmd_send(&e52_lora_at_dev, at_cmd_pack(cmd, "POWER", param), "OK", AT_WAIT_ACK_TIMEOUT);
+    e52_lora_at_cache.transmit_power = transmit_power;
+    e52_lora_at_cache_update(ret, E52_CACHE_POWER);
 
     return ret;
 }
@@ -224,7 +286,7 @@ at_cmd_status_t e52_lora_at_set_channel(uint8_t channel, e52_lora_at_save_t save
 {
     at_cmd_status_t ret;
     char cmd[18];
-    char param[5];
+    char param[8];
     if(channel >= 255)
     {
         channel = 60;
@@ -232,6 +294,8 @@ at_cmd_status_t e52_lora_at_set_channel(uint8_t channel, e52_lora_at_save_t save
     sprintf(param, "%d,%d", channel, save);
 
     ret = at_sp_cmd_send(&e52_lora_at_dev, at_cmd_pack(cmd, "CHANNEL", param), "OK", AT_WAIT_ACK_TIMEOUT);
+    e52_lora_at_cache.channel = channel;
+    e52_lora_at_cache_update(ret, E52_CACHE_CHANNEL);
 
     return ret;
 }
@@ -294,6 +358,8 @@ at_cmd_status_t e52_lora_at_set_option(e52_lora_at_option_t option, e52_lora_at_
     sprintf(param, "%d,%d", option, save);
 
     ret = at_sp_cmd_send(&e52_lora_at_dev, at_cmd_pack(cmd, "OPTION", param), "OK", AT_WAIT_ACK_TIMEOUT);
+    e52_lora_at_cache.option = option;
+    e52_lora_at_cache_update(ret, E52_CACHE_OPTION);
 
     return ret;
 }
@@ -312,6 +378,8 @@ at_cmd_status_t e52_lora_at_set_panid(uint16_t panid, e52_lora_at_save_t save)
     sprintf(param, "%d,%d", panid, save);
 
     ret = at_sp_cmd_send(&e52_lora_at_dev, at_cmd_pack(cmd, "PANID", param), "OK", AT_WAIT_ACK_TIMEOUT);
+    e52_lora_at_cache.panid = panid;
+    e52_lora_at_cache_update(ret, E52_CACHE_PANID);
 
     return ret;
 }
@@ -351,6 +419,8 @@ at_cmd_status_t e52_lora_at_set_src_addr(uint16_t src_addr, e52_lora_at_save_t s
     sprintf(param, "%d,%d", src_addr, save);
 
     ret = at_sp_cmd_send(&e52_lora_at_dev, at_cmd_pack(cmd, "SRC_ADDR", param), "OK", AT_WAIT_ACK_TIMEOUT);
+    e52_lora_at_cache.src_addr = src_addr;
+    e52_lora_at_cache_update(ret, E52_CACHE_SRC_ADDR);
 
     return ret;
 }
@@ -360,15 +430,24 @@ at_cmd_status_t e52_lora_at_set_src_addr(uint16_t src_addr, e52_lora_at_save_t s
  * @param  dst_addr: 目的地址,0x0000~0xFFFE
  * @param  save: 是否保存到flash
  * @note   AT+DST_ADDR=dst_addr,save
+ * @note   不保存且与缓存一致时不下发,分包逐包发送时避免重复设置
  */
 at_cmd_status_t e52_lora_at_set_dst_addr(uint16_t dst_addr, e52_lora_at_save_t save)
 {
     at_cmd_status_t ret;
     char cmd[24];
     char param[12];
+
+    if(save == E52_LORA_DO_NOT_SAVE_TO_FLASH && (e52_lora_at_cache_valid & E52_CACHE_DST_ADDR) &&
+       e52_lora_at_cache.dst_addr == dst_addr)
+    {
+        return AT_CMD_OK;
+    }
     sprintf(param, "%d,%d", dst_addr, save);
 
     ret = at_sp_cmd_send(&e52_lora_at_dev, at_cmd_pack(cmd, "DST_ADDR", param), "OK", AT_WAIT_ACK_TIMEOUT);
+    e52_lora_at_cache.dst_addr = dst_addr;
+    e52_lora_at_cache_update(ret, E52_CACHE_DST_ADDR);
 
     return ret;
 }
@@ -574,35 +653,179 @@ at_cmd_status_t e52_lora_at_set_router_save(e52_lora_at_functional_t enable)
     return ret;
 }
 
+/* 参数缓存 */
+
+/**
+ * @brief  缓存失效,模块复位后调用
+ * @note   e52_lora_at_reset已自动调用;硬件复位或掉电需手动调用
+ */
+void e52_lora_at_cache_invalidate(void)
+{
+    e52_lora_at_cache_valid = 0;
+}
+
+/**
+ * @brief  按缓存差异下发参数
+ * @param  param: 目标参数
+ * @param  save: 是否保存到flash
+ * @retval AT_CMD_OK: 参数一致或下发成功
+ * @note   全部一致时不产生串口数据,否则只下发不同或未缓存的参数
+ */
+at_cmd_status_t e52_lora_at_param_apply(const e52_lora_at_param_t *param, e52_lora_at_save_t save)
+{
+    at_cmd_status_t ret = AT_CMD_OK;
+    const e52_lora_at_param_t *cache = &e52_lora_at_cache;
+    uint8_t diff = E52_CACHE_ALL & ~e52_lora_at_cache_valid;
+
+    if(param == NULL)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+
+    if(param->transmit_power != cache->transmit_power)
+    {
+        diff |= E52_CACHE_POWER;
+    }
+    if(param->channel != cache->channel)
+    {
+        diff |= E52_CACHE_CHANNEL;
+    }
+    if(param->src_addr != cache->src_addr)
+    {
+        diff |= E52_CACHE_SRC_ADDR;
+    }
+    if(param->dst_addr != cache->dst_addr)
+    {
+        diff |= E52_CACHE_DST_ADDR;
+    }
+    if(param->panid != cache->panid)
+    {
+        diff |= E52_CACHE_PANID;
+    }
+    if(param->option != cache->option)
+    {
+        diff |= E52_CACHE_OPTION;
+    }
+
+    if(diff & E52_CACHE_POWER)
+    {
+        ret = e52_lora_at_set_transmit_power(param->transmit_power, save);
+    }
+    if(ret == AT_CMD_OK && (diff & E52_CACHE_CHANNEL))
+    {
+        ret = e52_lora_at_set_channel(param->channel, save);
+    }
+    if(ret == AT_CMD_OK && (diff & E52_CACHE_SRC_ADDR))
+    {
+        ret = e52_lora_at_set_src_addr(param->src_addr, save);
+    }
+    if(ret == AT_CMD_OK && (diff & E52_CACHE_DST_ADDR))
+    {
+        ret = e52_lora_at_set_dst_addr(param->dst_addr, save);
+    }
+    if(ret == AT_CMD_OK && (diff & E52_CACHE_PANID))
+    {
+        ret = e52_lora_at_set_panid(param->panid, save);
+    }
+    if(ret == AT_CMD_OK && (diff & E52_CACHE_OPTION))
+    {
+        ret = e52_lora_at_set_option(param->option, save);
+    }
+
+    return ret;
+}
+
 /* 额外解析函数 */
 
+#define E52_MSG_HEAD_LEN 8//模块输出帧头: head_type, data_len, panid, src_addr, dst_addr
+#define E52_MSG_INFO_LEN 2//自定义前置包信息: pack_type, pack_num
+
+/**
+ * @brief  解析e52-lora的LORA MSG,不拷贝数据,AT+HEAD=E52_LORA_FUNCTIONAL_ENABLEMENT时有效
+ * @param  frame: 模块输出的一帧,通常直接为串口接收缓冲区
+ * @param  len: 帧长度
+ * @param  view: 解析结果,data指向frame内部
+ * @retval AT_CMD_PARMINVAL: 帧长度不足或帧头长度与实际不符
+ * @note   多字节字段按小端逐字节读取,frame无需对齐
+ */
+at_cmd_status_t e52_lora_msg_parse(const uint8_t *frame, uint16_t len, e52_lora_msg_view_t *view)
+{
+    if(frame == NULL || view == NULL || len < E52_MSG_HEAD_LEN + E52_MSG_INFO_LEN)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+    if(frame[1] < E52_MSG_INFO_LEN || E52_MSG_HEAD_LEN + frame[1] > len)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+    view->head_type = frame[0];
+    view->data_len = frame[1] - E52_MSG_INFO_LEN;//减去自定义前置包信息
+    view->panid = frame[2] | ((uint16_t)frame[3] << 8);
+    view->src_addr = frame[4] | ((uint16_t)frame[5] << 8);
+    view->dst_addr = frame[6] | ((uint16_t)frame[7] << 8);
+    view->pack_type = frame[E52_MSG_HEAD_LEN];
+    view->pack_num = frame[E52_MSG_HEAD_LEN + 1];
+    view->data = &frame[E52_MSG_HEAD_LEN + E52_MSG_INFO_LEN];
+#if E52_LORA_LOG_LEVEL >= 1
+    E52_LORA_LOG("msg head %#02X src %#04X dst %#04X panid %#04X pack %d/%d len %d", view->head_type, view->src_addr,
+                 view->dst_addr, view->panid, view->pack_type, view->pack_num, view->data_len);
+#endif
+#if E52_LORA_LOG_LEVEL >= 2
+    for(uint16_t i = 0; i < view->data_len; i++)
+    {
+        printf("%02X ", view->data[i]);
+    }
+    printf("\r\n");
+#endif
+    return AT_CMD_OK;
+}
+
 /**
  * @brief  解析e52-lora的LORA MSG,AT+HEAD=E52_LORA_FUNCTIONAL_ENABLEMENT时有效
  * @param  data: 需解析的数据
  * @param  len: 数据长度
+ * @note   拷贝为e52_lora_msg_t,帧无效时data_len为0;接收热路径使用e52_lora_msg_parse
  */
 e52_lora_msg_t e52_lora_msg_analyse(uint8_t *data, uint16_t len)
 {
-    //e52_lora_msg_t *head = (e52_lora_msg_t *)data;
     e52_lora_msg_t head;
-    memcpy(&head, data, len);
-    head.data_len -= 2;//减去自定义前置包信息
-    printf("head type: %#02X\r\n", head.head_type);
-    printf("data len: %d\r\n", head.data_len);
-    printf("panid: %#02X\r\n", head.panid);
-    printf("src addr: %#02X\r\n", head.src_addr);
-    printf("dst addr: %#02X\r\n", head.dst_addr);
-    printf("pack type: %#02X\r\n", head.pack_type);
-    printf("pack num: %#02X\r\n", head.pack_num);
-    printf("data: ");
-    for(uint16_t i = 0; i < head.data_len; i++)
-    {
-        printf("%#02X ", head.data[i]);
+    e52_lora_msg_view_t view;
+
+    memset(&head, 0, sizeof(head));
+    if(e52_lora_msg_parse(data, len, &view) != AT_CMD_OK)
+    {
+        return head;
     }
-    printf("\r\n");
+    head.head_type = view.head_type;
+    head.data_len = view.data_len;
+    head.panid = view.panid;
+    head.src_addr = view.src_addr;
+    head.dst_addr = view.dst_addr;
+    head.pack_type = view.pack_type;
+    head.pack_num = view.pack_num;
+    memcpy(head.data, view.data, (view.data_len < sizeof(head.data)) ? view.data_len : sizeof(head.data));
     return head;
 }
 
+/**
+ * @brief  应答关键字表,序号即e52_lora_ack_analyse的返回值
+ */
+static const struct
+{
+    const char *str;
+    uint8_t len;
+} e52_lora_ack_table[] =
+{
+    {E52_LORA_MSG_ACK_SUCCESS, sizeof(E52_LORA_MSG_ACK_SUCCESS) - 1},
+    {E52_LORA_MSG_ACK_NO_ACK, sizeof(E52_LORA_MSG_ACK_NO_ACK) - 1},
+    {E52_LORA_MSG_ACK_NO_ROUTE, sizeof(E52_LORA_MSG_ACK_NO_ROUTE) - 1},
+    {E52_LORA_MSG_ACK_OUT_OF_CACHE, sizeof(E52_LORA_MSG_ACK_OUT_OF_CACHE) - 1},
+    {E52_LORA_MSG_ACK_LORA_MSG, sizeof(E52_LORA_MSG_ACK_LORA_MSG) - 1},
+    {E52_LORA_MSG_ACK_PACK_RECEIVE, sizeof(E52_LORA_MSG_ACK_PACK_RECEIVE) - 1},
+    {E52_LORA_MSG_ACK_PACK_RESEND, sizeof(E52_LORA_MSG_ACK_PACK_RESEND) - 1},
+    {E52_LORA_MSG_ACK_PACK_FAIL, sizeof(E52_LORA_MSG_ACK_PACK_FAIL) - 1},
+};
+
 /**
  * @brief  解析e52-lora的ack, AT+BACK=E52_LORA_FUNCTIONAL_ENABLEMENT时有效
  * @param  data: 需解析的数据
@@ -615,28 +838,582 @@ e52_lora_msg_t e52_lora_msg_analyse(uint8_t *data, uint16_t len)
  * @note   5: PACK RECEIVE
  * @note   6: PACK RESEND
  * @note   7: PACK FAIL
+ * @note   单次扫描,按首字符分派到候选关键字,返回最先出现的关键字;无应答关键字时返回4
  */
 uint8_t e52_lora_ack_analyse(uint8_t *data, uint16_t len)
 {
-    char *ack[] = {E52_LORA_MSG_ACK_SUCCESS, E52_LORA_MSG_ACK_NO_ACK, E52_LORA_MSG_ACK_NO_ROUTE, E52_LORA_MSG_ACK_OUT_OF_CACHE, E52_LORA_MSG_ACK_LORA_MSG, E52_LORA_MSG_ACK_PACK_RECEIVE, E52_LORA_MSG_ACK_PACK_RESEND, E52_LORA_MSG_ACK_PACK_FAIL};
+    uint8_t first;
+    uint8_t last;
 
-    for (uint8_t i = 0; i < 7; i++)
-    {   
-        if(i == 4)
+    for(uint16_t pos = 0; pos < len; pos++)
+    {
+        switch(data[pos])
         {
-            continue;
+            case 'S': first = 0; last = 0; break;
+            case 'N': first = 1; last = 2; break;
+            case 'O': first = 3; last = 3; break;
+            case 'P': first = 5; last = 7; break;
+            default: continue;
         }
-        size_t ack_len = strlen(ack[i]);
-        for (uint16_t pos = 0; pos <= len - ack_len; pos++)
+        for(uint8_t i = first; i <= last; i++)
         {
-            if (memcmp(data + pos, ack[i], ack_len) == 0)
+            if(len - pos >= e52_lora_ack_table[i].len &&
+               memcmp(&data[pos], e52_lora_ack_table[i].str, e52_lora_ack_table[i].len) == 0)
             {
-                printf("ack: %s\r\n", ack[i]);
-                // if (i == 4)
-                //     i += 1;
+                E52_LORA_LOG("ack: %s", e52_lora_ack_table[i].str);
                 return i;
             }
         }
     }
     return 4;
 }
+
+/* 分包收发 */
+
+#define E52_PACK_NOTIFY_LEN 3//预通知数据: 大包长度(2字节), 序号
+
+#define E52_PACK_ACK_RECEIVE 0
+#define E52_PACK_ACK_RESEND 1
+#define E52_PACK_ACK_FAIL 2
+
+#if E52_PACK_MAX_NUM > 32 || E52_PACK_MAX_LEN > E52_PACK_DATA_LEN * E52_PACK_MAX_NUM
+#error "E52_PACK_MAX_NUM or E52_PACK_MAX_LEN out of range"
+#endif
+
+typedef enum
+{
+    E52_PACK_SLOT_FREE = 0,
+    E52_PACK_SLOT_RECV = 1,//接收中
+    E52_PACK_SLOT_DONE = 2,//已完成并上报,保留以应答重复查询
+}e52_pack_slot_state_t;
+
+/**
+ * @brief  重组池中的一个接收槽
+ * @param  total: 包总数,0表示预通知未到,分包先到时按序号先行存放
+ * @param  recv_map: 已收分包位图
+ * @param  tick: 最近一次收到分包或发出重发请求的时间
+ */
+typedef struct
+{
+    uint8_t state;
+    uint8_t seq;
+    uint8_t total;
+    uint8_t nack_count;
+    uint16_t src_addr;
+    uint16_t len;
+    uint32_t recv_map;
+    uint32_t tick;
+    uint8_t buf[E52_PACK_MAX_LEN];
+}e52_pack_rx_slot_t;
+
+/**
+ * @brief  发送会话,同一时间只发送一个大包,数据由调用者保持至发送结束
+ */
+typedef struct
+{
+    uint8_t busy;
+    uint8_t seq;
+    uint8_t total;
+    uint8_t retry;
+    uint16_t dst_addr;
+    uint16_t len;
+    const uint8_t *data;
+    uint32_t tick;
+}e52_pack_tx_t;
+
+static e52_pack_rx_slot_t e52_pack_rx_pool[E52_PACK_RX_SLOT_NUM];
+static e52_pack_tx_t e52_pack_tx;
+static uint8_t e52_pack_tx_buf[E52_MSG_INFO_LEN + E52_PACK_DATA_LEN];
+static p_e52_pack_recv e52_pack_recv_cb = NULL;
+static p_e52_pack_sent e52_pack_sent_cb = NULL;
+static const char *e52_pack_ack_str[] = {E52_LORA_MSG_ACK_PACK_RECEIVE, E52_LORA_MSG_ACK_PACK_RESEND, E52_LORA_MSG_ACK_PACK_FAIL};
+
+/**
+ * @brief  包总数对应的完整位图
+ */
+static uint32_t e52_pack_full_map(uint8_t total)
+{
+    return (total >= 32) ? 0xFFFFFFFFU : ((1U << total) - 1U);
+}
+
+/**
+ * @brief  分包index的数据长度,最后一包为余下长度
+ */
+static uint16_t e52_pack_frag_len(uint16_t len, uint8_t total, uint8_t index)
+{
+    if(index + 1 < total)
+    {
+        return E52_PACK_DATA_LEN;
+    }
+    return len - (uint16_t)index * E52_PACK_DATA_LEN;
+}
+
+/**
+ * @brief  发送e52_pack_tx_buf中的前len字节
+ * @note   目的地址经缓存下发,地址不变时不产生AT指令
+ */
+static at_cmd_status_t e52_pack_output(uint16_t dst_addr, uint16_t len)
+{
+    at_cmd_status_t ret;
+
+    ret = e52_lora_at_set_dst_addr(dst_addr, E52_LORA_DO_NOT_SAVE_TO_FLASH);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    if(e52_lora_at_dev.at_hex_printf_cmd(e52_pack_tx_buf, len) != 0)
+    {
+        return AT_CMD_ERROR;
+    }
+    return AT_CMD_OK;
+}
+
+/**
+ * @brief  发送预通知,首次发送及超时查询共用
+ */
+static at_cmd_status_t e52_pack_send_notify(void)
+{
+    e52_pack_tx_buf[0] = E52_PACK_TYPE_NOTIFY;
+    e52_pack_tx_buf[1] = e52_pack_tx.total;
+    e52_pack_tx_buf[2] = (uint8_t)(e52_pack_tx.len & 0xFF);
+    e52_pack_tx_buf[3] = (uint8_t)(e52_pack_tx.len >> 8);
+    e52_pack_tx_buf[4] = e52_pack_tx.seq;
+    return e52_pack_output(e52_pack_tx.dst_addr, E52_MSG_INFO_LEN + E52_PACK_NOTIFY_LEN);
+}
+
+/**
+ * @brief  发送一个分包
+ */
+static at_cmd_status_t e52_pack_send_fragment(uint8_t index)
+{
+    uint16_t frag_len = e52_pack_frag_len(e52_pack_tx.len, e52_pack_tx.total, index);
+
+    e52_pack_tx_buf[0] = E52_PACK_TYPE_FRAGMENT;
+    e52_pack_tx_buf[1] = index;
+    memcpy(&e52_pack_tx_buf[E52_MSG_INFO_LEN], &e52_pack_tx.data[(uint16_t)index * E52_PACK_DATA_LEN], frag_len);
+    e52_lora_at_dev.at_delay_ms(E52_PACK_TX_INTERVAL_MS);
+    return e52_pack_output(e52_pack_tx.dst_addr, E52_MSG_INFO_LEN + frag_len);
+}
+
+/**
+ * @brief  发送预通知和全部分包
+ */
+static at_cmd_status_t e52_pack_send_all(void)
+{
+    at_cmd_status_t ret;
+
+    ret = e52_pack_send_notify();
+    for(uint8_t i = 0; i < e52_pack_tx.total && ret == AT_CMD_OK; i++)
+    {
+        ret = e52_pack_send_fragment(i);
+    }
+    return ret;
+}
+
+/**
+ * @brief  结束发送会话并回调
+ */
+static void e52_pack_tx_finish(at_cmd_status_t status)
+{
+    e52_pack_tx.busy = 0;
+    e52_pack_tx.data = NULL;
+    if(e52_pack_sent_cb != NULL)
+    {
+        e52_pack_sent_cb(e52_pack_tx.dst_addr, status);
+    }
+}
+
+/**
+ * @brief  接收端应答
+ * @param  slot: 接收槽
+ * @param  ack: E52_PACK_ACK_RECEIVE/RESEND/FAIL
+ * @note   RESEND时附上全部缺失序号
+ */
+static void e52_pack_send_ack(e52_pack_rx_slot_t *slot, uint8_t ack)
+{
+    uint16_t len = strlen(e52_pack_ack_str[ack]);
+    uint16_t pos = E52_MSG_INFO_LEN;
+
+    e52_pack_tx_buf[0] = E52_PACK_TYPE_NOTIFY;
+    memcpy(&e52_pack_tx_buf[pos], e52_pack_ack_str[ack], len);
+    pos += len;
+    e52_pack_tx_buf[pos++] = slot->seq;
+    if(ack == E52_PACK_ACK_RECEIVE)
+    {
+        e52_pack_tx_buf[1] = slot->total;
+    }
+    else if(ack == E52_PACK_ACK_RESEND)
+    {
+        e52_pack_tx_buf[1] = 0xFF;
+        for(uint8_t i = 0; i < slot->total; i++)
+        {
+            if((slot->recv_map & (1U << i)) == 0)
+            {
+                if(e52_pack_tx_buf[1] == 0xFF)
+                {
+                    e52_pack_tx_buf[1] = i;//首个缺失序号
+                }
+                e52_pack_tx_buf[pos++] = i;
+            }
+        }
+    }
+    else
+    {
+        e52_pack_tx_buf[1] = slot->total + 1;
+    }
+    e52_pack_output(slot->src_addr, pos);
+}
+
+/**
+ * @brief  查找源地址对应的接收槽
+ * @param  alloc: 1-找不到时分配,优先空闲槽,其次最早完成的槽
+ * @retval 接收槽,池满时返回NULL
+ */
+static e52_pack_rx_slot_t *e52_pack_rx_slot(uint16_t src_addr, uint8_t alloc)
+{
+    e52_pack_rx_slot_t *slot = NULL;
+
+    for(uint8_t i = 0; i < E52_PACK_RX_SLOT_NUM; i++)
+    {
+        if(e52_pack_rx_pool[i].state != E52_PACK_SLOT_FREE && e52_pack_rx_pool[i].src_addr == src_addr)
+        {
+            return &e52_pack_rx_pool[i];
+        }
+    }
+    if(alloc == 0)
+    {
+        return NULL;
+    }
+    for(uint8_t i = 0; i < E52_PACK_RX_SLOT_NUM; i++)
+    {
+        if(e52_pack_rx_pool[i].state == E52_PACK_SLOT_FREE)
+        {
+            return &e52_pack_rx_pool[i];
+        }
+        if(e52_pack_rx_pool[i].state == E52_PACK_SLOT_DONE &&
+           (slot == NULL || (int32_t)(e52_pack_rx_pool[i].tick - slot->tick) < 0))
+        {
+            slot = &e52_pack_rx_pool[i];
+        }
+    }
+    return slot;
+}
+
+/**
+ * @brief  初始化接收槽
+ */
+static void e52_pack_rx_start(e52_pack_rx_slot_t *slot, uint16_t src_addr)
+{
+    slot->state = E52_PACK_SLOT_RECV;
+    slot->seq = 0;
+    slot->total = 0;
+    slot->nack_count = 0;
+    slot->src_addr = src_addr;
+    slot->len = 0;
+    slot->recv_map = 0;
+    slot->tick = HAL_GetTick();
+}
+
+/**
+ * @brief  检查是否收齐,收齐后上报并应答
+ */
+static void e52_pack_rx_check(e52_pack_rx_slot_t *slot)
+{
+    if(slot->total == 0 || slot->recv_map != e52_pack_full_map(slot->total))
+    {
+        return;
+    }
+    slot->state = E52_PACK_SLOT_DONE;
+    slot->tick = HAL_GetTick();
+    e52_pack_send_ack(slot, E52_PACK_ACK_RECEIVE);
+    if(e52_pack_recv_cb != NULL)
+    {
+        e52_pack_recv_cb(slot->src_addr, slot->buf, slot->len);
+    }
+}
+
+/**
+ * @brief  收到预通知
+ * @note   序号与槽内一致时视为发送端查询,应答完成或缺失列表
+ */
+static void e52_pack_rx_notify(uint16_t src_addr, uint8_t total, const uint8_t *data)
+{
+    e52_pack_rx_slot_t *slot;
+    uint16_t len = data[0] | ((uint16_t)data[1] << 8);
+    uint8_t seq = data[2];
+
+    if(len == 0 || len > E52_PACK_MAX_LEN || total != (len + E52_PACK_DATA_LEN - 1) / E52_PACK_DATA_LEN)
+    {
+        return;
+    }
+    slot = e52_pack_rx_slot(src_addr, 1);
+    if(slot == NULL)
+    {
+        return;//重组池满,由发送端超时重试
+    }
+    if(slot->state != E52_PACK_SLOT_FREE && slot->src_addr == src_addr && slot->total == total &&
+       slot->seq == seq && slot->len == len)
+    {
+        slot->tick = HAL_GetTick();//发送端仍在查询,延长保留,避免重复上报
+        e52_pack_send_ack(slot, (slot->state == E52_PACK_SLOT_DONE) ? E52_PACK_ACK_RECEIVE : E52_PACK_ACK_RESEND);
+        return;
+    }
+    if(slot->state != E52_PACK_SLOT_RECV || slot->src_addr != src_addr || slot->total != 0)
+    {
+        e52_pack_rx_start(slot, src_addr);//新的大包
+    }
+    slot->seq = seq;
+    slot->total = total;
+    slot->len = len;
+    slot->recv_map &= e52_pack_full_map(total);//预通知前先到的分包
+    e52_pack_rx_check(slot);
+}
+
+/**
+ * @brief  收到分包,按序号直接存入重组缓冲区,可乱序
+ */
+static void e52_pack_rx_fragment(uint16_t src_addr, uint8_t index, const uint8_t *data, uint16_t len)
+{
+    e52_pack_rx_slot_t *slot;
+    uint16_t offset = (uint16_t)index * E52_PACK_DATA_LEN;
+
+    if(index >= E52_PACK_MAX_NUM || len == 0 || len > E52_PACK_DATA_LEN || offset + len > E52_PACK_MAX_LEN)
+    {
+        return;
+    }
+    slot = e52_pack_rx_slot(src_addr, 1);
+    if(slot == NULL || (slot->state == E52_PACK_SLOT_DONE && slot->src_addr == src_addr))
+    {
+        return;//池满,或已完成大包的重复分包
+    }
+    if(slot->state != E52_PACK_SLOT_RECV || slot->src_addr != src_addr)
+    {
+        e52_pack_rx_start(slot, src_addr);//预通知丢失,先行存放
+    }
+    if(slot->total != 0 && (index >= slot->total || len != e52_pack_frag_len(slot->len, slot->total, index)))
+    {
+        return;
+    }
+    slot->tick = HAL_GetTick();
+    if(slot->recv_map & (1U << index))
+    {
+        return;
+    }
+    memcpy(&slot->buf[offset], data, len);
+    slot->recv_map |= 1U << index;
+    slot->nack_count = 0;
+    e52_pack_rx_check(slot);
+    if(slot->state == E52_PACK_SLOT_RECV && slot->total != 0 && index == slot->total - 1)
+    {
+        e52_pack_send_ack(slot, E52_PACK_ACK_RESEND);//末包已到仍有缺失,不等超时
+    }
+}
+
+/**
+ * @brief  发送端收到应答
+ */
+static void e52_pack_tx_ack(uint16_t src_addr, const uint8_t *data, uint16_t len)
+{
+    uint16_t ack_len;
+
+    if(e52_pack_tx.busy == 0 || src_addr != e52_pack_tx.dst_addr)
+    {
+        return;
+    }
+    ack_len = strlen(E52_LORA_MSG_ACK_PACK_RECEIVE);
+    if(len > ack_len && memcmp(data, E52_LORA_MSG_ACK_PACK_RECEIVE, ack_len) == 0)
+    {
+        if(data[ack_len] == e52_pack_tx.seq)
+        {
+            e52_pack_tx_finish(AT_CMD_OK);
+        }
+        return;
+    }
+    ack_len = strlen(E52_LORA_MSG_ACK_PACK_RESEND);
+    if(len > ack_len && memcmp(data, E52_LORA_MSG_ACK_PACK_RESEND, ack_len) == 0)
+    {
+        if(data[ack_len] != e52_pack_tx.seq)
+        {
+            return;
+        }
+        if(++e52_pack_tx.retry > E52_PACK_TX_RETRY)
+        {
+            e52_pack_tx_finish(AT_CMD_TIMEOUT);
+            return;
+        }
+        //data指向接收缓冲,发送分包时at_ack_restart会释放缓冲,先拷贝缺失序号
+        uint8_t missing[E52_PACK_MAX_NUM];
+        uint8_t missing_num = 0;
+        for(uint16_t i = ack_len + 1; i < len && missing_num < E52_PACK_MAX_NUM; i++)
+        {
+            if(data[i] < e52_pack_tx.total)
+            {
+                missing[missing_num++] = data[i];
+            }
+        }
+        for(uint8_t i = 0; i < missing_num; i++)
+        {
+            e52_pack_send_fragment(missing[i]);
+        }
+        e52_pack_tx.tick = HAL_GetTick();
+        return;
+    }
+    ack_len = strlen(E52_LORA_MSG_ACK_PACK_FAIL);
+    if(len > ack_len && memcmp(data, E52_LORA_MSG_ACK_PACK_FAIL, ack_len) == 0)
+    {
+        //未收到预通知的接收端不知道序号,不校验
+        if(++e52_pack_tx.retry > E52_PACK_TX_RETRY)
+        {
+            e52_pack_tx_finish(AT_CMD_TIMEOUT);
+            return;
+        }
+        e52_pack_send_all();
+        e52_pack_tx.tick = HAL_GetTick();
+    }
+}
+
+/**
+ * @brief  初始化分包收发
+ * @param  recv: 接收完成回调,单包和重组后的大包均由此上报
+ * @param  sent: 大包发送结束回调,可为NULL
+ */
+void e52_lora_pack_init(p_e52_pack_recv recv, p_e52_pack_sent sent)
+{
+    memset(e52_pack_rx_pool, 0, sizeof(e52_pack_rx_pool));
+    memset(&e52_pack_tx, 0, sizeof(e52_pack_tx));
+    e52_pack_recv_cb = recv;
+    e52_pack_sent_cb = sent;
+}
+
+/**
+ * @brief  发送数据,超过E52_PACK_DATA_LEN时分包
+ * @param  dst_addr: 目的地址
+ * @param  data: 数据,分包发送时须保持有效直至sent回调
+ * @param  len: 数据长度,不超过E52_PACK_MAX_LEN
+ * @retval AT_CMD_ERROR: 上一个大包仍在发送
+ * @note   大包发送完预通知和全部分包后返回,之后由e52_lora_pack_input处理应答,e52_lora_pack_poll处理超时
+ */
+at_cmd_status_t e52_lora_pack_send(uint16_t dst_addr, const uint8_t *data, uint16_t len)
+{
+    at_cmd_status_t ret;
+
+    if(data == NULL || len == 0 || len > E52_PACK_MAX_LEN)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+    if(len <= E52_PACK_DATA_LEN)
+    {
+        e52_pack_tx_buf[0] = E52_PACK_TYPE_SINGLE;
+        e52_pack_tx_buf[1] = 0;
+        memcpy(&e52_pack_tx_buf[E52_MSG_INFO_LEN], data, len);
+        return e52_pack_output(dst_addr, E52_MSG_INFO_LEN + len);
+    }
+    if(e52_pack_tx.busy)
+    {
+        return AT_CMD_ERROR;
+    }
+    e52_pack_tx.seq++;
+    e52_pack_tx.total = (len + E52_PACK_DATA_LEN - 1) / E52_PACK_DATA_LEN;
+    e52_pack_tx.retry = 0;
+    e52_pack_tx.dst_addr = dst_addr;
+    e52_pack_tx.len = len;
+    e52_pack_tx.data = data;
+    ret = e52_pack_send_all();
+    if(ret != AT_CMD_OK)
+    {
+        e52_pack_tx.data = NULL;
+        return ret;
+    }
+    e52_pack_tx.busy = 1;
+    e52_pack_tx.tick = HAL_GetTick();
+    return AT_CMD_OK;
+}
+
+/**
+ * @brief  接收帧入口,AT+HEAD使能时模块输出的一帧
+ * @param  frame: 帧头+自定义前置包信息+数据,与e52_lora_msg_t一致
+ * @param  len: 帧长度
+ * @note   会发送应答和重发分包,须在任务中调用,不可在中断中调用
+ */
+void e52_lora_pack_input(const uint8_t *frame, uint16_t len)
+{
+    e52_lora_msg_view_t view;
+
+    if(e52_lora_msg_parse(frame, len, &view) != AT_CMD_OK)
+    {
+        return;
+    }
+    switch(view.pack_type)
+    {
+        case E52_PACK_TYPE_SINGLE:
+            if(e52_pack_recv_cb != NULL && view.data_len > 0)
+            {
+                e52_pack_recv_cb(view.src_addr, (uint8_t *)view.data, view.data_len);
+            }
+            break;
+        case E52_PACK_TYPE_FRAGMENT:
+            e52_pack_rx_fragment(view.src_addr, view.pack_num, view.data, view.data_len);
+            break;
+        case E52_PACK_TYPE_NOTIFY:
+            if(view.data_len == E52_PACK_NOTIFY_LEN)
+            {
+                e52_pack_rx_notify(view.src_addr, view.pack_num, view.data);
+            }
+            else
+            {
+                e52_pack_tx_ack(view.src_addr, view.data, view.data_len);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief  分包超时处理,周期调用
+ * @note   接收端: 分包间隔超时请求重发缺失分包(未收到预通知则请求全部重发),次数耗尽后丢弃
+ * @note   发送端: 等待应答超时重发预通知查询,次数耗尽后回调AT_CMD_TIMEOUT
+ */
+void e52_lora_pack_poll(void)
+{
+    uint32_t now = HAL_GetTick();
+    e52_pack_rx_slot_t *slot;
+
+    for(uint8_t i = 0; i < E52_PACK_RX_SLOT_NUM; i++)
+    {
+        slot = &e52_pack_rx_pool[i];
+        if(slot->state == E52_PACK_SLOT_DONE && now - slot->tick >= E52_PACK_DONE_HOLD_MS)
+        {
+            slot->state = E52_PACK_SLOT_FREE;
+        }
+        else if(slot->state == E52_PACK_SLOT_RECV && now - slot->tick >= E52_PACK_RX_TIMEOUT_MS)
+        {
+            if(slot->nack_count >= E52_PACK_NACK_RETRY)
+            {
+                slot->state = E52_PACK_SLOT_FREE;
+                continue;
+            }
+            slot->nack_count++;
+            slot->tick = now;
+            e52_pack_send_ack(slot, slot->total ? E52_PACK_ACK_RESEND : E52_PACK_ACK_FAIL);
+        }
+    }
+    if(e52_pack_tx.busy && now - e52_pack_tx.tick >= E52_PACK_TX_TIMEOUT_MS)
+    {
+        if(++e52_pack_tx.retry > E52_PACK_TX_RETRY)
+        {
+            e52_pack_tx_finish(AT_CMD_TIMEOUT);
+            return;
+        }
+        e52_pack_send_notify();
+        e52_pack_tx.tick = now;
+    }
+}
+
+/**
+ * @brief  是否有大包正在等待应答
+ */
+uint8_t e52_lora_pack_tx_busy(void)
+{
+    return e52_pack_tx.busy;
+}
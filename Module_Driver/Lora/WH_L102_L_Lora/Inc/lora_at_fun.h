@@ -88,6 +88,16 @@ typedef enum
     LORA_SPD_21875BPS = 10,
 } lora_spd_t;
 
+/* 模块参数,用于缓存与差异下发 */
+typedef struct
+{
+    lora_wmode_t wmode;//工作模式
+    lora_spd_t spd;//空中速率
+    char addr[6];//目标地址,0~65535
+    char ch[4];//信道,0~127
+    char pwr[3];//发射功率,10~20dBm
+} lora_at_param_t;
+
 /* at_cmd_tools初始化 */
 void lora_at_fun_init(void);
 at_cmd_status_t lora_at_mode_entry(void);
@@ -127,5 +137,8 @@ at_cmd_status_t lora_at_set_key(char *key);
 at_cmd_status_t lora_at_set_pflag(lora_switch_t sta);
 at_cmd_status_t lora_at_set_sendok(lora_switch_t sta);
 at_cmd_status_t lora_at_set_fec(lora_switch_t sta);
+/* 参数缓存 */
+void lora_at_cache_invalidate(void);
+at_cmd_status_t lora_at_param_apply(const lora_at_param_t *param);
 
 #endif /* _LORA_AT_FUN_H__ */
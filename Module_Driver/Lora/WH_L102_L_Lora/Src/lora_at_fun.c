@@ -10,6 +10,33 @@
 
 at_device_t lora_at_dev;
 
+/* 模块参数缓存,写穿透 */
+
+#define LORA_CACHE_WMODE (1 << 0)
+#define LORA_CACHE_SPD   (1 << 1)
+#define LORA_CACHE_ADDR  (1 << 2)
+#define LORA_CACHE_CH    (1 << 3)
+#define LORA_CACHE_PWR   (1 << 4)
+#define LORA_CACHE_ALL   (LORA_CACHE_WMODE | LORA_CACHE_SPD | LORA_CACHE_ADDR | LORA_CACHE_CH | LORA_CACHE_PWR)
+
+static lora_at_param_t lora_at_cache;
+static uint8_t lora_at_cache_valid = 0;//LORA_CACHE_xxx位图
+
+/**
+ * @brief  更新缓存中的一项,set/get成功时调用,失败时清除对应位
+ */
+static void lora_at_cache_update(at_cmd_status_t ret, uint8_t item)
+{
+    if(ret == AT_CMD_OK)
+    {
+        lora_at_cache_valid |= item;
+    }
+    else
+    {
+        lora_at_cache_valid &= ~item;
+    }
+}
+
 /**
  * @brief     LoRa AT设备初始化
 */
@@ -70,6 +97,7 @@ at_cmd_status_t lora_at_default(void)
 {
     at_cmd_status_t ret = AT_CMD_OK;
     ret = at_cmd_send(&lora_at_dev, "AT+RELD", LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
+    lora_at_cache_invalidate();
     return ret;
 }
 
@@ -84,6 +112,8 @@ at_cmd_status_t lora_at_restart(void)
 
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "Z", NULL), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
 
+    lora_at_cache_invalidate();
+
     return ret;
 }
 
@@ -147,12 +177,17 @@ at_cmd_status_t lora_at_get_wmode(lora_wmode_t *wmode)
     uint16_t param_index = 0;
     uint16_t param_len = 0;
     char cmd[10];
-    uint8_t _wmode[4];
+    uint8_t _wmode[6];
 
     if(wmode == NULL)
     {
         return AT_CMD_PARMINVAL;
     }
+    if(lora_at_cache_valid & LORA_CACHE_WMODE)
+    {
+        *wmode = lora_at_cache.wmode;
+        return AT_CMD_OK;
+    }
 
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "WMODE", NULL), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if(ret != AT_CMD_OK)
@@ -179,6 +214,8 @@ at_cmd_status_t lora_at_get_wmode(lora_wmode_t *wmode)
     {
         return AT_CMD_ERROR;
     }
+    lora_at_cache.wmode = *wmode;
+    lora_at_cache_valid |= LORA_CACHE_WMODE;
 
     return ret;
 }
@@ -419,6 +456,11 @@ at_cmd_status_t lora_at_get_spd(lora_spd_t *spd)
     {
         return AT_CMD_PARMINVAL;
     }
+    if(lora_at_cache_valid & LORA_CACHE_SPD)
+    {
+        *spd = lora_at_cache.spd;
+        return AT_CMD_OK;
+    }
 
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "SPD", NULL), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if(ret != AT_CMD_OK)
@@ -467,6 +509,8 @@ at_cmd_status_t lora_at_get_spd(lora_spd_t *spd)
         default:
             return AT_CMD_ERROR;
     }
+    lora_at_cache.spd = *spd;
+    lora_at_cache_valid |= LORA_CACHE_SPD;
 
     return ret;
 }
@@ -487,6 +531,11 @@ at_cmd_status_t lora_at_get_addr(char *addr)
     {
         return AT_CMD_PARMINVAL;
     }
+    if(lora_at_cache_valid & LORA_CACHE_ADDR)
+    {
+        strcpy(addr, lora_at_cache.addr);
+        return AT_CMD_OK;
+    }
 
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "ADDR", NULL), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if(ret != AT_CMD_OK)
@@ -498,8 +547,14 @@ at_cmd_status_t lora_at_get_addr(char *addr)
     {
         return ret;
     }
+    if(param_len >= sizeof(lora_at_cache.addr))
+    {
+        return AT_CMD_ERROR;
+    }
     memcpy(addr, lora_at_dev.at_cmd_ack() + param_index, param_len);
     addr[param_len] = '\0';
+    strcpy(lora_at_cache.addr, addr);
+    lora_at_cache_valid |= LORA_CACHE_ADDR;
 
     return ret;
 }
@@ -520,6 +575,11 @@ at_cmd_status_t lora_at_get_pwr(char *pwr)
     {
         return AT_CMD_PARMINVAL;
     }
+    if(lora_at_cache_valid & LORA_CACHE_PWR)
+    {
+        strcpy(pwr, lora_at_cache.pwr);
+        return AT_CMD_OK;
+    }
 
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "PWR", NULL), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if(ret != AT_CMD_OK)
@@ -531,8 +591,14 @@ at_cmd_status_t lora_at_get_pwr(char *pwr)
     {
         return ret;
     }
+    if(param_len >= sizeof(lora_at_cache.pwr))
+    {
+        return AT_CMD_ERROR;
+    }
     memcpy(pwr, lora_at_dev.at_cmd_ack() + param_index, param_len);
     pwr[param_len] = '\0';
+    strcpy(lora_at_cache.pwr, pwr);
+    lora_at_cache_valid |= LORA_CACHE_PWR;
 
     return ret;
 }
@@ -714,6 +780,11 @@ at_cmd_status_t lora_at_get_ch(char *ch)
     {
         return AT_CMD_PARMINVAL;
     }
+    if(lora_at_cache_valid & LORA_CACHE_CH)
+    {
+        strcpy(ch, lora_at_cache.ch);
+        return AT_CMD_OK;
+    }
 
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "CH", NULL), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
     if(ret != AT_CMD_OK)
@@ -725,8 +796,14 @@ at_cmd_status_t lora_at_get_ch(char *ch)
     {
         return ret;
     }
+    if(param_len >= sizeof(lora_at_cache.ch))
+    {
+        return AT_CMD_ERROR;
+    }
     memcpy(ch, lora_at_dev.at_cmd_ack() + param_index, param_len);
     ch[param_len] = '\0';
+    strcpy(lora_at_cache.ch, ch);
+    lora_at_cache_valid |= LORA_CACHE_CH;
 
     return ret;
 }
@@ -800,8 +877,10 @@ at_cmd_status_t lora_at_set_wmode(lora_wmode_t wmode)
         break;
     default:
         ret = AT_CMD_PARMINVAL;
-        break;
+        return ret;
     }
+    lora_at_cache.wmode = wmode;
+    lora_at_cache_update(ret, LORA_CACHE_WMODE);
 
     return ret;
 }
@@ -889,6 +968,8 @@ at_cmd_status_t lora_at_set_spd(lora_spd_t spd)
 
     sprintf(cmd_para, "%d", spd);
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "SPD", cmd_para), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
+    lora_at_cache.spd = spd;
+    lora_at_cache_update(ret, LORA_CACHE_SPD);
 
     return ret;
 }
@@ -905,6 +986,8 @@ at_cmd_status_t lora_at_set_addr(uint16_t addr)
     char cmd_para[6];
     sprintf(cmd_para, "%d", addr);
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "ADDR", cmd_para), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
+    strcpy(lora_at_cache.addr, cmd_para);
+    lora_at_cache_update(ret, LORA_CACHE_ADDR);
 
     return ret;
 }
@@ -917,9 +1000,15 @@ at_cmd_status_t lora_at_set_addr(uint16_t addr)
 at_cmd_status_t lora_at_set_ch(char *ch)
 {
     at_cmd_status_t ret = AT_CMD_OK;
-    char cmd[10];
-    
+    char cmd[16];
+
+    if(ch == NULL || strlen(ch) >= sizeof(lora_at_cache.ch))
+    {
+        return AT_CMD_PARMINVAL;
+    }
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "CH", ch), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
+    strcpy(lora_at_cache.ch, ch);
+    lora_at_cache_update(ret, LORA_CACHE_CH);
 
     return ret;
 }
@@ -958,9 +1047,15 @@ at_cmd_status_t lora_at_set_fec(lora_switch_t fec)
 at_cmd_status_t lora_at_set_pwr(char *pwr)
 {
     at_cmd_status_t ret = AT_CMD_OK;
-    char cmd[10];
+    char cmd[16];
 
+    if(pwr == NULL || strlen(pwr) >= sizeof(lora_at_cache.pwr))
+    {
+        return AT_CMD_PARMINVAL;
+    }
     ret = at_cmd_send(&lora_at_dev, at_cmd_pack(cmd, "PWR", pwr), LORA_ACK_OK, AT_WAIT_ACK_TIMEOUT);
+    strcpy(lora_at_cache.pwr, pwr);
+    lora_at_cache_update(ret, LORA_CACHE_PWR);
 
     return ret;
 }
@@ -1080,3 +1175,89 @@ at_cmd_status_t lora_at_set_sendok(lora_switch_t sta)
 
     return ret;
 }
+
+/* 参数缓存 */
+
+/**
+ * @brief  缓存失效,模块复位或恢复出厂后调用
+ * @note   lora_at_restart/lora_at_default已自动调用;硬件复位需手动调用
+ */
+void lora_at_cache_invalidate(void)
+{
+    lora_at_cache_valid = 0;
+}
+
+/**
+ * @brief  按缓存差异下发参数
+ * @param  param: 目标参数
+ * @retval AT_CMD_OK: 参数一致或下发成功
+ * @note   在透传模式下调用;全部一致时不产生串口数据,
+ *         否则只进入一次AT模式,只下发不同或未缓存的参数后退出
+ */
+at_cmd_status_t lora_at_param_apply(const lora_at_param_t *param)
+{
+    at_cmd_status_t ret = AT_CMD_OK;
+    uint8_t diff = LORA_CACHE_ALL & ~lora_at_cache_valid;
+
+    if(param == NULL)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+
+    if(param->wmode != lora_at_cache.wmode)
+    {
+        diff |= LORA_CACHE_WMODE;
+    }
+    if(param->spd != lora_at_cache.spd)
+    {
+        diff |= LORA_CACHE_SPD;
+    }
+    if(strcmp(param->addr, lora_at_cache.addr) != 0)
+    {
+        diff |= LORA_CACHE_ADDR;
+    }
+    if(strcmp(param->ch, lora_at_cache.ch) != 0)
+    {
+        diff |= LORA_CACHE_CH;
+    }
+    if(strcmp(param->pwr, lora_at_cache.pwr) != 0)
+    {
+        diff |= LORA_CACHE_PWR;
+    }
+    if(diff == 0)
+    {
+        return AT_CMD_OK;
+    }
+
+    ret = lora_at_mode_entry();
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    if(diff & LORA_CACHE_WMODE)
+    {
+        ret = lora_at_set_wmode(param->wmode);
+    }
+    if(ret == AT_CMD_OK && (diff & LORA_CACHE_SPD))
+    {
+        ret = lora_at_set_spd(param->spd);
+    }
+    if(ret == AT_CMD_OK && (diff & LORA_CACHE_ADDR))
+    {
+        ret = lora_at_set_addr((uint16_t)atoi(param->addr));
+    }
+    if(ret == AT_CMD_OK && (diff & LORA_CACHE_CH))
+    {
+        ret = lora_at_set_ch((char *)param->ch);
+    }
+    if(ret == AT_CMD_OK && (diff & LORA_CACHE_PWR))
+    {
+        ret = lora_at_set_pwr((char *)param->pwr);
+    }
+    if(lora_at_mode_exit() != AT_CMD_OK && ret == AT_CMD_OK)
+    {
+        ret = AT_CMD_ERROR;
+    }
+
+    return ret;
+}
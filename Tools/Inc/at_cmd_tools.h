@@ -7,6 +7,8 @@ typedef void (*p_ack_restart)(void);
 typedef void (*p_delay_ms)(uint32_t ms);
 typedef uint8_t* (*p_get_buf)(void);
 
+struct __at_engine_t;
+
 /**
  * @brief  AT device structure
  * @param  at_id: AT device ID
@@ -14,6 +16,7 @@ typedef uint8_t* (*p_get_buf)(void);
  * @param  at_ack_restart: AT ack restart function
  * @param  at_delay_ms: AT delay ms function
  * @param  at_cmd_ack: AT command ack buffer
+ * @param  engine: async AT engine, NULL if not used
  */
 typedef struct __at_device_t
 {
@@ -23,6 +26,7 @@ typedef struct __at_device_t
     p_delay_ms at_delay_ms;
     p_get_buf at_cmd_ack;
     p_hex_printf_cmd at_hex_printf_cmd;
+    struct __at_engine_t *engine;
 } at_device_t;
 
 typedef enum
@@ -36,10 +40,82 @@ typedef enum
 #define AT_WAIT_ACK_TIMEOUT 3000
 #define AT_SP_SEND_CMD "%s"
 
+#define AT_ACK_FIELD_NUM 8//单行应答最大参数个数
+
+/**
+ * @brief  AT应答参数表,由at_ack_tokenize一次扫描生成
+ * @param  src: 应答缓冲区
+ * @param  num: 参数个数
+ * @param  field: 各参数在src中的偏移和长度,带双引号的参数不含引号
+ */
+typedef struct __at_ack_fields_t
+{
+    const uint8_t *src;
+    uint8_t num;
+    struct
+    {
+        uint16_t index;
+        uint16_t len;
+    } field[AT_ACK_FIELD_NUM];
+} at_ack_fields_t;
+
+/* async AT engine */
+#define AT_ENGINE_QUEUE_LEN 4//每个设备的命令队列深度
+#define AT_ENGINE_CMD_LEN 64//命令最大长度
+#define AT_ENGINE_LINE_LEN 128//单行最大长度
+#define AT_ENGINE_RESP_LEN 256//一条命令的全部应答行
+#define AT_ENGINE_URC_NUM 8//URC最大注册数
+
+/* resp: 命令发出后收到的全部行,以\n分隔,仅在回调内有效 */
+typedef void (*p_at_complete)(at_cmd_status_t status, const char *resp, void *arg);
+typedef void (*p_at_urc)(const char *line, void *arg);
+
+typedef struct __at_engine_cmd_t
+{
+    char cmd[AT_ENGINE_CMD_LEN];
+    const char *ack;//应答行前缀,需为常量字符串
+    uint32_t timeout;
+    uint8_t sp;//1:不追加\r\n
+    p_at_complete complete;
+    void *arg;
+} at_engine_cmd_t;
+
+typedef struct __at_urc_t
+{
+    const char *prefix;
+    p_at_urc handler;
+    void *arg;
+} at_urc_t;
+
+typedef struct __at_engine_t
+{
+    at_engine_cmd_t queue[AT_ENGINE_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+    volatile uint8_t busy;//队首命令已发出,等待应答
+    uint32_t start_tick;
+    char line[AT_ENGINE_LINE_LEN];
+    uint16_t line_len;
+    char resp[AT_ENGINE_RESP_LEN];
+    uint16_t resp_len;
+    at_urc_t urc[AT_ENGINE_URC_NUM];
+    uint8_t urc_num;
+} at_engine_t;
+
 at_cmd_status_t at_ack_get_str_parameter(uint8_t *src, uint8_t param_num, uint16_t *param_index, uint16_t *param_len);
 at_cmd_status_t at_ack_get_normal_parameter(uint8_t *src, uint8_t param_num, uint16_t *param_index, uint16_t *param_len);
+at_cmd_status_t at_ack_tokenize(const uint8_t *src, const char *prefix, at_ack_fields_t *fields);
+at_cmd_status_t at_ack_field_copy(const at_ack_fields_t *fields, uint8_t param_num, char *dst, uint16_t size);
 at_cmd_status_t at_cmd_send(at_device_t *at_dev, char *cmd, char *ack, uint32_t timeout);
 at_cmd_status_t at_sp_cmd_send(at_device_t *at_dev, char *cmd, char *ack, uint32_t timeout);
 char *at_cmd_pack(char *at_cmd, char *cmd_code, char *cmd_para);
 
+void at_engine_init(at_device_t *at_dev, at_engine_t *engine);
+at_cmd_status_t at_engine_urc_register(at_device_t *at_dev, const char *prefix, p_at_urc handler, void *arg);
+at_cmd_status_t at_cmd_send_async(at_device_t *at_dev, const char *cmd, const char *ack, uint32_t timeout, p_at_complete complete, void *arg);
+at_cmd_status_t at_sp_cmd_send_async(at_device_t *at_dev, const char *cmd, const char *ack, uint32_t timeout, p_at_complete complete, void *arg);
+at_cmd_status_t at_cmd_send_wait(at_device_t *at_dev, const char *cmd, const char *ack, uint32_t timeout, char *resp, uint16_t resp_len);
+void at_engine_rx_input(at_device_t *at_dev, const uint8_t *data, uint16_t len);
+void at_engine_poll(at_device_t *at_dev);
+
 #endif /* _AT_CMD_TOOLS_H__ */
@@ -1,8 +1,38 @@
 #ifndef __CRC_TOOL_H__
 #define __CRC_TOOL_H__
 
+#include <stdint.h>
+
+/* CRC8实现选择 0:逐位计算 1:256项查表 2:slice-by-4(4张查表,占用1KB Flash);可在编译选项中定义 */
+#ifndef CRC8_MODE
+#define CRC8_MODE 1
+#endif
+/* CRC32计算方式 1:对齐部分使用CRC外设(hcrc) 0:纯软件,结果一致;可在编译选项中定义 */
+#ifndef CRC32_USE_HW
+#define CRC32_USE_HW 1
+#endif
+/* Modbus CRC16实现选择 0:高低字节分表 1:16位查表 2:slice-by-4(4张查表,占用2KB Flash);可在编译选项中定义 */
+#ifndef CRC16_MODE
+#define CRC16_MODE 1
+#endif
+/* Modbus CRC16初值,整帧(含末尾2字节CRC)累加后为0即校验通过 */
+#define MODBUS_CRC16_INIT 0xFFFF
+
+/* 流式crc32计算上下文 */
+typedef struct {
+    uint32_t crc;       // 当前crc值
+    uint8_t tail[4];    // 未凑满4字节的暂存数据
+    uint8_t tail_len;   // 暂存字节数
+} Crc32Context;
+
 uint32_t crc_calculate(uint8_t *input, uint16_t input_len);
+void crc32_init(Crc32Context *ctx);
+void crc32_update(Crc32Context *ctx, const uint8_t *data, uint32_t len);
+uint32_t crc32_final(Crc32Context *ctx);
 uint8_t crc8(uint8_t* data, uint32_t len);
 uint16_t modbus_rtu_crc16(uint8_t *buffer, uint16_t buffer_length);
+uint16_t modbus_rtu_crc16_byte(uint16_t crc, uint8_t data);
+uint16_t modbus_rtu_crc16_update(uint16_t crc, const uint8_t *buffer, uint16_t buffer_length);
+uint16_t modbus_rtu_crc16_final(uint16_t crc);
 
 #endif /* __CRC_TOOL_H__ */
@@ -20,8 +20,41 @@ extern "C" {
 #include "w25qxx_spi_driver.h"
 
 #define STORAGE_BLOCK_DATA_SIZE 12 // 数据块内容大小,后续可考虑存入配置
+#define STORAGE_MAX_SECTOR_NUM 256 // 最大管理数据扇区数
+#define STORAGE_SECTOR_HEADER_SIZE 6 // 扇区头(0xA5 0x5A 序列号)长度
+#define STORAGE_META_SECTOR_NUM 2 // 管理扇区数量,两个扇区交替使用
+#define STORAGE_META_HEADER_SIZE 15 // 管理扇区头(0xA5 0x5A 格式 环形起点 代数 扇区数 序列号基准)长度
+#define STORAGE_META_JOURNAL_MIN 8 // 管理扇区至少保留的日志项数,限制数据扇区数量
+#define STORAGE_META_JOURNAL_TAG 0xA7 // 索引日志项标记
+#define STORAGE_ERASE_COUNT_MAX 0xFFFE // 擦除计数上限,0xFFFF为擦除状态
+#define STORAGE_VAR_SECTOR_HEADER_SIZE 10 // 变长格式扇区头(0xA5 0x5A 序列号 基准时间戳)长度
+#define STORAGE_SEQ_INVALID 0xFFFFFFFF // 扇区头无效或已擦除
+#define STORAGE_RECOVER_PROBE 16 // 恢复时判断擦除区的探测长度
+#define STORAGE_RECORD_SYNC 0xA6 // 变长记录同步字节
+#define STORAGE_RECORD_MAX_SIZE 255 // 变长记录最大长度
+#define STORAGE_RECORD_MAX_DATA_SIZE (STORAGE_RECORD_MAX_SIZE - 16) // 变长记录最大数据长度
+#define STORAGE_INVALID_ADDR 0xFFFFFFFF
+#define STORAGE_PAGE_SIZE 256 // W25Q页大小,写入暂存缓冲按页对齐
+#define STORAGE_FLUSH_TIMEOUT_MS 1000 // 暂存数据超时自动写入时间
+#define STORAGE_CURSOR_WINDOW_SIZE STORAGE_PAGE_SIZE // 游标读取窗口大小
+#define STORAGE_PAGE_POOL_NUM 2 // 暂存页缓冲池大小,各实例共用
 
-/* 驱动接口结构体 */
+/* 游标过滤条件标志 */
+#define STORAGE_FILTER_TIME 0x01
+#define STORAGE_FILTER_TYPE 0x02
+#define STORAGE_FILTER_ID   0x04
+
+/* 数据块格式 */
+typedef enum {
+    STORAGE_FORMAT_FIXED = 0x00U, // 定长StorageBlock
+    STORAGE_FORMAT_VAR = 0x01U,   // 变长记录
+} StorageFormat;
+
+/**
+ * 驱动接口结构体
+ * write须支持任意地址、任意长度写入已擦除的字节(如W25QXX页编程),暂存页补写、日志项(17字节)均为奇数地址与长度;
+ * 片内Flash(如F1按半字编程)不满足该要求,不能直接作为驱动
+ */
 typedef struct {//1:成功 0:失败
     uint8_t (*read)(uint32_t addr, uint8_t* buf, uint32_t len);
     uint8_t (*write)(uint32_t addr, uint8_t* buf, uint32_t len);
@@ -39,27 +72,199 @@ typedef struct {
     uint32_t  timestamp;                        // Unix时间戳（4字节）
     uint8_t   crc;                              // CRC8校验（1字节）
 } StorageBlock;                                 // 总长度19字节
+
+/* 扇区摘要索引,用于时间范围查询时跳过无关扇区 */
+typedef struct {
+    uint32_t  min_time;                         // 扇区内最小时间戳（4字节）
+    uint32_t  max_time;                         // 扇区内最大时间戳（4字节）
+    uint16_t  count;                            // 扇区内数据块数量（2字节）
+    uint16_t  used;                             // 扇区数据区已用字节数（2字节）
+} StorageSectorSummary;                         // 总长度12字节
+
+/* 索引日志项,追加在管理扇区表格之后,避免改写已写入的表项 */
+typedef struct {
+    uint8_t   tag;                              // STORAGE_META_JOURNAL_TAG（1字节）
+    uint8_t   sector;                           // 数据扇区序号（1字节）
+    uint16_t  erase_count;                      // 扇区擦除次数（2字节）
+    StorageSectorSummary summary;               // 扇区摘要（12字节）
+    uint8_t   crc;                              // CRC8校验（1字节）
+} StorageMetaEntry;                             // 总长度17字节
 #pragma pack(pop)
 
-/* 存储管理器状态 */
+/**
+ * 变长记录格式(STORAGE_FORMAT_VAR):
+ * [0xA6][len][type varint][id varint][时间戳差值 zigzag varint][data][crc8]
+ * len为len之后的字节数(含crc8),时间戳差值相对于所在扇区头中的基准时间戳
+ * crc8覆盖同步字节至data末尾,校验失败时扫描逐字节重新同步
+ */
+typedef struct {
+    uint16_t  type;              // 数据类型
+    uint32_t  id;                // 数据标识
+    uint32_t  timestamp;         // Unix时间戳
+    uint16_t  length;            // 数据长度
+    uint16_t  size;              // 记录在Flash中的总长度
+    const uint8_t* data;         // 指向读取缓冲内的数据,不复制
+} StorageRecord;
+
+/**
+ * 存储区布局:
+ * start_addr起两个扇区为管理扇区: [0xA5 0x5A 格式 环形起点 代数 扇区数 序列号基准][sector_erase][sector_index][StorageMetaEntry]...
+ * 表项变化以日志追加,日志写满时将完整表格写入另一管理扇区(代数加1),上电时取代数较新的扇区
+ * 其后为数据扇区,按环形顺序写入: [0xA5 0x5A 序列号][StorageBlock]...[StorageBlock]
+ * 变长格式数据扇区: [0xA5 0x5A 序列号][基准时间戳][记录]...[记录]
+ * 数据块不跨扇区存放,扇区剩余空间不足时切换至下一扇区
+ * 序列号每切换一次扇区加1,上电时据此二分查找写入扇区
+ * 格式化时序列号接续全部扇区头中的最大值并记为序列号基准,小于基准的扇区头为格式化前的残留,视为无效
+ * 时间范围查询按扇区摘要二分定位,要求时间戳随写入顺序不减;RTC回拨等导致时间戳倒退时
+ * 自动退化为逐扇区扫描,直至倒退的数据所在扇区被回收
+ */
+
+/* 写入统计,写放大 = flash_bytes / logical_bytes */
 typedef struct {
+    uint32_t  logical_bytes;     // 用户写入的数据块字节数
+    uint32_t  flash_bytes;       // 实际写入Flash的字节数(含管理信息)
+    uint32_t  page_writes;       // Flash写入次数
+    uint32_t  sector_erases;     // 扇区擦除次数
+    uint32_t  records;           // 写入的数据块/记录数
+} StorageWriteStats;
+
+/* 磨损统计 */
+typedef struct {
+    uint16_t  min_erase;         // 数据扇区最少擦除次数
+    uint16_t  max_erase;         // 数据扇区最多擦除次数
+    uint32_t  avg_erase;         // 数据扇区平均擦除次数
+    uint32_t  min_sector;        // 擦除次数最少的扇区序号
+    uint32_t  max_sector;        // 擦除次数最多的扇区序号
+    uint32_t  meta_generation;   // 管理扇区代数,两个管理扇区合计擦除次数
+} StorageWearStats;
+
+/**
+ * 存储实例配置,由storage_dev_open使用
+ * 擦除计数表与摘要索引表由调用者提供,长度table_num决定可管理的最大数据扇区数
+ */
+typedef struct {
+    StorageDriver driver;        // 驱动接口
+    uint32_t  start_addr;        // 起始地址,需扇区对齐
+    uint32_t  end_addr;          // 结束地址
+    uint32_t  sector_size;       // 擦除扇区大小,如W25QXX_SECTOR_SIZE
+    StorageFormat format;        // 数据块格式
+    uint16_t* sector_erase;      // 擦除计数表
+    StorageSectorSummary* sector_index; // 摘要索引表
+    uint32_t  table_num;         // 表长度,不超过STORAGE_MAX_SECTOR_NUM
+} StorageConfig;
+
+/* 存储管理器状态,每个实例一个 */
+typedef struct FlashManager {
+    StorageDriver driver;        // 驱动接口
+    uint32_t  sector_size;       // 擦除扇区大小
     uint32_t  start_addr;        // 用户指定起始地址
     uint32_t  end_addr;          // 用户指定结束地址
     uint32_t  current_addr;      // 当前写入地址
     uint32_t  oldest_sector;     // 最早数据所在扇区
-    uint16_t  sector_usage[256]; // 扇区使用计数
+    uint32_t  head_sector;       // 当前写入的数据扇区序号
+    uint32_t  head_seq;          // 当前写入扇区的序列号
+    uint32_t  seq_base;          // 格式化时的序列号,小于此值的扇区头无效
+    uint32_t  ring_start;        // 格式化时的环形起点扇区
+    uint32_t  sector_num;        // 数据扇区数量
+    StorageFormat format;        // 数据块格式
+    uint32_t  head_base_time;    // 写入扇区的基准时间戳(变长格式)
+    uint32_t  last_time;         // 已写入数据的最大时间戳
+    uint8_t   time_ordered;      // 1:各扇区时间戳按写入顺序不减,可二分查找 0:需逐扇区扫描
+    uint16_t* sector_erase;      // 扇区擦除次数
+    StorageSectorSummary* sector_index; // 扇区摘要索引
+    uint32_t  table_num;         // 表长度
+    uint32_t  meta_dirty[STORAGE_MAX_SECTOR_NUM / 32]; // 待回写的索引表项
+    uint32_t  meta_sector;       // 当前使用的管理扇区(0/1)
+    uint32_t  meta_gen;          // 当前管理扇区代数
+    uint32_t  journal_addr;      // 下一条索引日志写入地址
+    uint8_t*  page_buf;          // 写入暂存页,写入时从缓冲池获取
+    uint32_t  page_addr;         // 暂存页对应的页起始地址
+    uint16_t  page_flushed;      // 暂存页中已写入Flash的长度
+    uint16_t  page_fill;         // 暂存页中已填充的长度
+    uint32_t  last_write_tick;   // 最近一次写入时刻
+    StorageWriteStats stats;     // 写入统计
+    struct FlashManager* next;   // 已注册实例链表
 } FlashManager;
 
-/* 公有接口 */ //后续考虑添加最新数据读取接口
+/* 游标遍历方向 */
+typedef enum {
+    STORAGE_CURSOR_FORWARD = 0x00U, // 由旧到新
+    STORAGE_CURSOR_REVERSE = 0x01U, // 由新到旧
+} StorageCursorDir;
+
+/* 游标过滤条件 */
+typedef struct {
+    uint8_t   flags;             // STORAGE_FILTER_xxx组合
+    uint16_t  type;              // 数据类型
+    uint32_t  id;                // 数据标识
+    uint32_t  start_time;        // 起始时间戳(含)
+    uint32_t  end_time;          // 结束时间戳(含)
+} StorageFilter;
+
+/**
+ * 数据块游标,按页读取至窗口缓冲,storage_cursor_next返回指向窗口内的指针
+ * 返回的指针在下一次调用storage_cursor_next前有效
+ */
+typedef struct {
+    FlashManager* dev;           // 所属实例
+    StorageCursorDir dir;        // 遍历方向
+    StorageFilter filter;        // 过滤条件
+    uint32_t  logic;             // 当前扇区环形逻辑序号
+    uint32_t  addr;              // 正向:下一个数据块地址 反向:上一个数据块结束地址
+    uint32_t  sector_start;      // 当前扇区数据区起始地址
+    uint32_t  sector_end;        // 当前扇区数据区结束地址
+    uint32_t  record_addr;       // 最近一次返回的数据块/记录地址
+    uint32_t  base_time;         // 当前扇区基准时间戳(变长格式)
+    StorageRecord record;        // 最近一次返回的记录(变长格式)
+    uint32_t  win_addr;          // 窗口对应的Flash地址
+    uint16_t  win_len;           // 窗口有效长度
+    uint8_t   opened;            // 0:未打开或已结束
+    uint8_t   window[STORAGE_CURSOR_WINDOW_SIZE]; // 窗口缓冲
+} StorageCursor;
+
+/* 实例接口 */
+
+uint8_t storage_dev_open(FlashManager* dev, const StorageConfig* config);
+void storage_dev_close(FlashManager* dev);
+uint8_t storage_dev_write_block(FlashManager* dev, StorageBlock* block);
+uint8_t storage_dev_write_record(FlashManager* dev, uint16_t type, uint32_t id, uint32_t timestamp, const uint8_t* data, uint16_t length);
+uint8_t storage_dev_read_block(FlashManager* dev, uint32_t addr, StorageBlock* out);
+uint8_t storage_dev_read_record(FlashManager* dev, uint32_t addr, StorageRecord* out, uint8_t* buf);
+uint8_t storage_dev_read_newest(FlashManager* dev, uint8_t num, StorageBlock* out);
+uint32_t storage_dev_find_by_time(FlashManager* dev, uint32_t start_time, uint32_t end_time);
+uint32_t storage_dev_get_position(FlashManager* dev);
+const StorageSectorSummary* storage_dev_get_sector_summary(FlashManager* dev, uint32_t sector);
+uint8_t storage_dev_flush(FlashManager* dev);
+void storage_dev_flush_poll(FlashManager* dev);
+void storage_dev_get_write_stats(FlashManager* dev, StorageWriteStats* stats);
+void storage_dev_reset_write_stats(FlashManager* dev);
+void storage_dev_get_wear_stats(FlashManager* dev, StorageWearStats* stats);
+uint8_t storage_dev_cursor_open(FlashManager* dev, StorageCursor* cursor, StorageCursorDir dir, const StorageFilter* filter);
+
+/* 公有接口 *///后续考虑添加最新数据读取接口
+/* 以下接口操作默认实例(W25Q),storage_flush_poll轮询全部已注册实例 */
 
 void storage_driver_register(StorageDriver* driver);
+void storage_set_format(StorageFormat format);
 uint8_t storage_init(uint32_t user_start, uint32_t user_end);
 uint8_t write_data_block(StorageBlock* block);
+uint8_t write_record(uint16_t type, uint32_t id, uint32_t timestamp, const uint8_t* data, uint16_t length);
+uint8_t read_record_by_address(uint32_t addr, StorageRecord* out, uint8_t* buf);
 uint8_t read_by_address(uint32_t addr, StorageBlock* out);
 uint8_t read_by_new_num(uint8_t num, StorageBlock* out);
 uint32_t find_by_time_range(uint32_t start_time, uint32_t end_time);
 void set_storage_range(uint32_t start, uint32_t end);
 uint32_t get_current_position(void);
+const StorageSectorSummary* storage_get_sector_summary(uint32_t sector);
+uint8_t storage_flush(void);
+void storage_flush_poll(void);
+void storage_get_write_stats(StorageWriteStats* stats);
+void storage_reset_write_stats(void);
+void storage_get_wear_stats(StorageWearStats* stats);
+uint8_t storage_cursor_open(StorageCursor* cursor, StorageCursorDir dir, const StorageFilter* filter);
+const StorageBlock* storage_cursor_next(StorageCursor* cursor);
+const StorageRecord* storage_cursor_next_record(StorageCursor* cursor);
+void storage_cursor_close(StorageCursor* cursor);
 
 #ifdef __cplusplus
 }
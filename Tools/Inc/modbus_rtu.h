@@ -24,6 +24,7 @@ typedef enum
     MODBUS_STATUS_ERROR = 0x01U,
     MODBUS_STATUS_TIMEOUT = 0x02U,
     MODBUS_STATUS_PARMINVAL = 0x03U,
+    MODBUS_STATUS_EXCEPTION = 0x04U,
 }MODBUS_STATUS_CODE;
 
 typedef enum
@@ -42,9 +43,13 @@ typedef enum
 
 //modbus_rtu_fun_t modbus_rtu_master_fun;
 
-/* MODBUS MODE */
+/* MODBUS MODE, can be set by compiler options */
+#ifndef MODBUS_RTU_MASTER_MODE
 #define MODBUS_RTU_MASTER_MODE 1
+#endif
+#ifndef MODBUS_RTU_SLAVE_MODE
 #define MODBUS_RTU_SLAVE_MODE 0
+#endif
 
 /* MODBUS CACHE */
 #define MODBUS_RTU_SEND_BUF_LEN 64
@@ -84,22 +89,167 @@ uint8_t modbus_rtu_write_and_read_registers(modbus_rtu_fun_t *fun, uint8_t slave
 /* modbus recv start */
 
 uint8_t modbus_rtu_recv_msg_pack(modbus_rtu_fun_t *fun, modbus_rtu_msg_t *msg);
+uint16_t modbus_rtu_msg_pdu_pack(modbus_rtu_msg_t *msg, uint8_t exception, uint8_t *pdu);
 
 /* modbus recv end */
 
+/* modbus async master start */
+
+#define MODBUS_RTU_QUEUE_LEN 8//事务队列深度
+#define MODBUS_RTU_TIMEOUT_MS 100//默认应答超时
+#define MODBUS_RTU_RETRY 2//默认重试次数
+
+typedef void (*p_rtu_timer_start)(uint32_t us);//单次定时,重复调用则重新计时
+typedef void (*p_rtu_complete)(uint8_t status, modbus_rtu_msg_t *msg, void *arg);
+
+typedef enum
+{
+    MODBUS_RTU_MASTER_IDLE = 0x00U,//总线空闲,提交即发送
+    MODBUS_RTU_MASTER_WAIT = 0x01U,//等待应答
+    MODBUS_RTU_MASTER_GAP = 0x02U,//等待3.5字符帧间隔
+}MODBUS_RTU_MASTER_STATE;
+
+typedef struct __modbus_rtu_req_t
+{
+    uint8_t buf[MODBUS_RTU_SEND_BUF_LEN];//含crc
+    uint8_t len;
+    uint8_t retry;//剩余重试次数
+    uint16_t timeout_ms;
+    p_rtu_complete complete;
+    void *arg;
+}modbus_rtu_req_t;
+
+struct __modbus_rtu_plan_t;
+
+typedef struct __modbus_rtu_master_t
+{
+    modbus_rtu_fun_t *fun;
+    p_rtu_timer_start timer_start;
+    uint32_t char_us;//单字符时间
+    uint32_t gap_us;//帧间隔
+    uint16_t timeout_ms;//read/write默认超时
+    uint8_t retry;//read/write默认重试次数
+    volatile uint8_t state;
+    uint8_t head;
+    uint8_t count;
+    modbus_rtu_req_t queue[MODBUS_RTU_QUEUE_LEN];
+    modbus_rtu_msg_t msg;
+    struct __modbus_rtu_plan_t *wait;//队列满时等待提交的扫描计划,请求完成腾出队列后继续提交
+}modbus_rtu_master_t;
+
+void modbus_rtu_master_init(modbus_rtu_master_t *master, modbus_rtu_fun_t *fun, p_rtu_timer_start timer_start, uint32_t baudrate);
+uint8_t modbus_rtu_master_submit(modbus_rtu_master_t *master, uint8_t *buf, uint16_t len, uint16_t timeout_ms, uint8_t retry, p_rtu_complete complete, void *arg);
+uint8_t modbus_rtu_master_read(modbus_rtu_master_t *master, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num, p_rtu_complete complete, void *arg);
+uint8_t modbus_rtu_master_write(modbus_rtu_master_t *master, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num, uint8_t *data, uint8_t data_count, p_rtu_complete complete, void *arg);
+void modbus_rtu_master_rx_irq(modbus_rtu_master_t *master);
+void modbus_rtu_master_timer_irq(modbus_rtu_master_t *master);
+uint8_t modbus_rtu_master_pending(modbus_rtu_master_t *master);
+
+/* modbus async master end */
+
+/* modbus poll plan start */
+
+#define MODBUS_RTU_PLAN_FRAME_NUM 32//合并后最大帧数
+
+typedef struct __modbus_rtu_point_t
+{
+    uint8_t slave_addr;
+    uint8_t function_code;//0x01-0x04
+    uint16_t reg_addr;
+    uint16_t reg_num;
+    uint16_t *value;//reg_num个值,线圈/离散输入为0或1
+    uint8_t frame;//所属帧,由modbus_rtu_plan_build填写
+}modbus_rtu_point_t;
+
+typedef void (*p_rtu_plan_complete)(struct __modbus_rtu_plan_t *plan);
+
+typedef struct __modbus_rtu_plan_frame_t
+{
+    struct __modbus_rtu_plan_t *plan;
+    uint8_t slave_addr;
+    uint8_t function_code;
+    uint16_t reg_addr;
+    uint16_t reg_num;
+    uint8_t status;//本次扫描结果 MODBUS_STATUS_CODE
+}modbus_rtu_plan_frame_t;
+
+typedef struct __modbus_rtu_plan_t
+{
+    modbus_rtu_point_t *point;
+    uint16_t point_num;
+    modbus_rtu_plan_frame_t frame[MODBUS_RTU_PLAN_FRAME_NUM];
+    uint8_t frame_num;
+    modbus_rtu_master_t *master;
+    p_rtu_plan_complete complete;
+    volatile uint8_t next;//下一个待提交的帧
+    volatile uint8_t done;//已完成的帧数
+    volatile uint8_t waiting;//在master->wait中等待队列空位
+    struct __modbus_rtu_plan_t *wait_next;
+}modbus_rtu_plan_t;
+
+uint8_t modbus_rtu_plan_build(modbus_rtu_plan_t *plan, modbus_rtu_point_t *point, uint16_t point_num, uint16_t gap);
+uint8_t modbus_rtu_plan_scatter(modbus_rtu_plan_t *plan, uint8_t index, modbus_rtu_msg_t *msg);
+uint8_t modbus_rtu_plan_scan(modbus_rtu_plan_t *plan, modbus_rtu_master_t *master, p_rtu_plan_complete complete);
+
+/* modbus poll plan end */
+
 #endif /* MODBUS_RTU_MASTER_MODE */
 
 #if MODBUS_RTU_SLAVE_MODE == 1
-/* modbus slave msg */
-typedef struct __modbus_rtu_slave_msg_t
+/* modbus slave */
+
+#define MODBUS_RTU_SLAVE_CHUNK 32//单次访问区域的最大数据项数
+
+typedef enum
 {
-    uint8_t function_code;//功能码
-    uint16_t reg_addr;//寄存器地址
-    uint16_t reg_num;//寄存器数量
-    uint8_t data[MODBUS_RTU_RECV_BUF_LEN];
-    uint16_t data_len;
-}modbus_rtu_slave_msg_t;
+    MODBUS_RTU_TABLE_COIL = 0x00U,
+    MODBUS_RTU_TABLE_DISCRETE_INPUT = 0x01U,
+    MODBUS_RTU_TABLE_HOLDING_REGISTER = 0x02U,
+    MODBUS_RTU_TABLE_INPUT_REGISTER = 0x03U,
+}MODBUS_RTU_TABLE;
+
+typedef enum
+{
+    MODBUS_RTU_EXCEPTION_ILLEGAL_FUNCTION = 0x01U,
+    MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_ADDRESS = 0x02U,
+    MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE = 0x03U,
+    MODBUS_RTU_EXCEPTION_DEVICE_FAILURE = 0x04U,
+}MODBUS_RTU_EXCEPTION;
+
+/* addr为绝对地址,num不超过MODBUS_RTU_SLAVE_CHUNK,线圈/离散输入每项为0或1,返回0或异常码 */
+typedef uint8_t (*p_rtu_region_read)(uint16_t addr, uint16_t num, uint16_t *value);
+typedef uint8_t (*p_rtu_region_write)(uint16_t addr, uint16_t num, const uint16_t *value);
+typedef uint8_t* (*p_rtu_tx_get_buf)(void);//返回空闲的TX DMA缓冲区
+typedef uint8_t (*p_rtu_tx_start)(uint16_t len);//发送TX DMA缓冲区中的len字节
+
+typedef struct __modbus_rtu_region_t
+{
+    uint8_t table;//MODBUS_RTU_TABLE
+    uint16_t start;
+    uint16_t num;
+    uint16_t *value;//直接映射的存储,为NULL时使用回调
+    p_rtu_region_read read;
+    p_rtu_region_write write;//value与write均为NULL时只读
+    struct __modbus_rtu_region_t *next;
+}modbus_rtu_region_t;
+
+typedef struct __modbus_rtu_slave_t
+{
+    modbus_rtu_fun_t *fun;
+    p_rtu_tx_get_buf tx_get_buf;//为NULL时经fun->rtu_hex_printf拷贝发送
+    p_rtu_tx_start tx_start;
+    uint8_t *tx_buf;//tx_get_buf为NULL时使用的应答缓冲区
+    uint16_t tx_len;//应答缓冲区长度
+    uint8_t slave_addr;
+    uint16_t *addr_reg;//非NULL时从站地址取自该寄存器
+    modbus_rtu_region_t *region;
+}modbus_rtu_slave_t;
+
+uint8_t modbus_rtu_slave_init(modbus_rtu_slave_t *slave, modbus_rtu_fun_t *fun, uint8_t slave_addr, p_rtu_tx_get_buf tx_get_buf, p_rtu_tx_start tx_start, uint16_t tx_len);
+void modbus_rtu_slave_region_add(modbus_rtu_slave_t *slave, modbus_rtu_region_t *region);
+uint8_t modbus_rtu_slave_poll(modbus_rtu_slave_t *slave);
 
+/* 单从站兼容接口,reg[0]为从站地址,保持寄存器与输入寄存器均映射到reg */
 void modbus_rtu_slave_reg_init(uint16_t *reg, uint16_t reg_len);
 uint8_t modbus_rtu_slave_recv(modbus_rtu_fun_t *fun);
 
@@ -0,0 +1,49 @@
+#ifndef __MODBUS_TCP_H__
+#define __MODBUS_TCP_H__
+
+#include "main.h"
+#include "modbus_rtu.h"
+
+#if MODBUS_RTU_MASTER_MODE == 1
+
+/* MODBUS TCP GATEWAY */
+#define MODBUS_TCP_MBAP_LEN 7//事务标识2+协议标识2+长度2+单元标识1
+#define MODBUS_TCP_PDU_MAX_LEN (MODBUS_RTU_SEND_BUF_LEN - 3)//受RTU发送缓冲限制
+#define MODBUS_TCP_RX_BUF_LEN (MODBUS_TCP_MBAP_LEN + MODBUS_TCP_PDU_MAX_LEN)
+#define MODBUS_TCP_TX_BUF_LEN (MODBUS_TCP_MBAP_LEN + MODBUS_RTU_RECV_BUF_LEN + 2)
+#define MODBUS_TCP_TXN_NUM MODBUS_RTU_QUEUE_LEN//同时在途的事务数
+
+/* gateway exception code */
+#define MODBUS_TCP_EXCEPTION_ILLEGAL_DATA_VALUE 0x03
+#define MODBUS_TCP_EXCEPTION_BUSY 0x06
+#define MODBUS_TCP_EXCEPTION_GATEWAY_TARGET 0x0B
+
+typedef struct __modbus_tcp_txn_t
+{
+    struct __modbus_tcp_gateway_t *gw;
+    uint16_t transaction_id;
+    uint8_t unit_id;
+    uint8_t function_code;
+    volatile uint8_t used;
+}modbus_tcp_txn_t;
+
+typedef struct __modbus_tcp_gateway_t
+{
+    modbus_rtu_master_t *master;//下行RTU主站
+    modbus_rtu_fun_t *net;//上行透传链路,rtu_hex_printf不可阻塞(在中断中应答)
+    modbus_tcp_txn_t txn[MODBUS_TCP_TXN_NUM];
+    uint8_t rx_buf[MODBUS_TCP_RX_BUF_LEN];//TCP流拼帧
+    uint16_t rx_len;
+    uint16_t rx_skip;//超长帧待丢弃的字节数
+    uint8_t tx_buf[MODBUS_TCP_TX_BUF_LEN];
+    uint32_t frame_count;//已转发的请求数
+    uint32_t drop_count;//丢弃的异常字节数
+}modbus_tcp_gateway_t;
+
+void modbus_tcp_gateway_init(modbus_tcp_gateway_t *gw, modbus_rtu_master_t *master, modbus_rtu_fun_t *net);
+uint8_t modbus_tcp_gateway_input(modbus_tcp_gateway_t *gw, const uint8_t *data, uint16_t len);
+uint8_t modbus_tcp_gateway_poll(modbus_tcp_gateway_t *gw);
+
+#endif /* MODBUS_RTU_MASTER_MODE */
+
+#endif /* __MODBUS_TCP_H__ */
@@ -0,0 +1,99 @@
+#ifndef __TRACE_LOG_H__
+#define __TRACE_LOG_H__
+
+#include "main.h"
+#include "stdio.h"
+
+/**
+ * @brief  二进制日志:格式串留在flash,串口只发送格式串地址和整型参数,由上位机解析axf还原文本
+ * @note   解析工具: Tools/Scripts/trace_decode.py
+ * @note   记录格式: [TRACE_LOG_SYNC][负载长度][时间差][格式串ID][参数...],时间差与ID为变长无符号数,参数为zigzag变长数
+ * @note   只支持整型参数(%d %u %x %c等),不支持%s %f
+ */
+
+#define TRACE_LOG_ENABLE 1//1-模块日志输出二进制记录 0-模块日志仍使用printf
+#define TRACE_LOG_SYNC 0xFF//记录起始字节,UTF-8文本中不会出现
+#define TRACE_LOG_ARG_MAX 8//单条记录最多参数个数
+#ifndef TRACE_LOG_ID_BASE
+#define TRACE_LOG_ID_BASE 0x08000000U//格式串ID为其地址减去此值,与flash起始地址一致时ID不超过3字节
+#endif
+
+#if defined(__CC_ARM) || defined(__ARMCC_VERSION) || defined(__GNUC__)
+#define TRACE_LOG_SECTION __attribute__((section(".trace_fmt")))
+#else
+#define TRACE_LOG_SECTION
+#endif
+
+/**
+ * @brief  日志模块,运行时按模块设置等级,新增模块时同步修改trace_log.c中的名称表
+ */
+typedef enum
+{
+    TRACE_MOD_SYS = 0,
+    TRACE_MOD_RTC = 1,
+    TRACE_MOD_TIMINGTASK = 2,
+    TRACE_MOD_MODBUS_RTU = 3,
+    TRACE_MOD_MODBUS_TCP = 4,
+    TRACE_MOD_AT = 5,
+    TRACE_MOD_NUM,
+    TRACE_MOD_ALL = 0xFF,
+}trace_module_t;
+
+typedef enum
+{
+    TRACE_LEVEL_OFF = 0,
+    TRACE_LEVEL_ERROR = 1,
+    TRACE_LEVEL_WARN = 2,
+    TRACE_LEVEL_INFO = 3,
+    TRACE_LEVEL_DEBUG = 4,
+    TRACE_LEVEL_NUM,
+}trace_level_t;
+
+#define TRACE_LOG_DEFAULT_LEVEL TRACE_LEVEL_DEBUG//上电默认等级,与原先各模块日志全开一致
+
+/**
+ * @brief  各等级已开启的模块位图,trace_log_mask[level]的第module位为1表示输出
+ * @note   过滤在组织参数之前完成,关闭的日志只有一次读内存和位与
+ */
+extern volatile uint32_t trace_log_mask[TRACE_LEVEL_NUM];
+
+#define TRACE_LOG_ON(module, level) (trace_log_mask[level] & (1UL << (module)))
+
+/**
+ * @brief  按模块和等级过滤后输出,TRACE_LOG_ENABLE为1时输出二进制记录,否则printf
+ */
+#if TRACE_LOG_ENABLE == 1
+#define TRACE_LOG_OUT(module, level, fmt, ...) do { \
+    if(TRACE_LOG_ON(module, level)) { TRACE_LOG(fmt, ##__VA_ARGS__); } \
+} while(0)
+#else
+#define TRACE_LOG_OUT(module, level, fmt, ...) do { \
+    if(TRACE_LOG_ON(module, level)) { printf(fmt, ##__VA_ARGS__); } \
+} while(0)
+#endif
+
+/**
+ * @brief  按模块和等级过滤后printf输出,用于含%s等无法二进制输出的日志
+ */
+#define TRACE_LOG_TEXT(module, level, fmt, ...) do { \
+    if(TRACE_LOG_ON(module, level)) { printf(fmt, ##__VA_ARGS__); } \
+} while(0)
+
+/**
+ * @brief  输出一条二进制日志
+ * @param  fmt: 格式串,须为字符串常量
+ * @param  ...: 整型参数,按int32_t传递
+ */
+#define TRACE_LOG(fmt, ...) do { \
+    static const char trace_fmt[] TRACE_LOG_SECTION = fmt; \
+    const int32_t trace_arg[] = {0, ##__VA_ARGS__}; \
+    trace_log_write(trace_fmt, &trace_arg[1], sizeof(trace_arg) / sizeof(trace_arg[0]) - 1); \
+} while(0)
+
+void trace_log_write(const char *fmt, const int32_t *arg, uint8_t num);
+uint32_t trace_log_overflow(void);
+void trace_log_level_set(uint8_t module, uint8_t level);
+uint8_t trace_log_level_get(uint8_t module);
+uint8_t trace_log_config(const char *cmd);
+
+#endif /* __TRACE_LOG_H__ */
@@ -0,0 +1,103 @@
+#ifndef __UART_PORT_H__
+#define __UART_PORT_H__
+
+#include "main.h"
+#include "usart_printf.h"
+
+/**
+ * @brief  串口端口管理:每个物理串口注册一次接收缓冲、发送环形缓冲与DMA句柄,
+ *         中断与回调按句柄分发,AT设备与modbus等协议栈绑定端口即可收发,无需各自实现缓冲与收发函数
+ * @note   USARTx_IRQHandler中调用uart_port_irq,HAL_UART_TxCpltCallback中调用uart_port_tx_cplt,
+ *         环形接收时HAL_UART_RxHalfCpltCallback/HAL_UART_RxCpltCallback中调用uart_port_rx_dma_irq
+ */
+
+#define UART_PORT_NUM 4//端口数,即uart_port_bind_xxx可绑定的端口数,不超过4
+#define UART_PORT_LINE_LEN 256//uart_port_printf单次格式化最大长度
+
+#define UART_PORT_RX_FRAME 0//接收帧模式:DMA普通模式,空闲中断时停止并重启DMA接收(不影响发送),缓冲即为帧数据
+#define UART_PORT_RX_RING 1//接收环形模式:DMA须配置为循环模式,多帧排队,任务中零拷贝读取
+
+#define UART_PORT_TX_DROP_NEWEST 0//发送缓冲满时丢弃新数据
+#define UART_PORT_TX_DROP_OLDEST 1//发送缓冲满时丢弃最早未发送的数据(延伸至行尾),仅适用于按行输出的文本日志,会截断二进制记录
+#define UART_PORT_TX_BLOCK 2//发送缓冲满时等待,适用于仅在任务中发送的端口;中断中或关中断时按丢弃新数据处理
+
+struct __at_device_t;
+struct __modbus_rtu_fun_t;
+
+/**
+ * @brief  接收回调,由uart_port_poll在任务中调用
+ * @param  data: 一帧连续数据,回调返回后失效
+ * @param  len: 数据长度
+ * @param  arg: 注册时的透传参数
+ */
+typedef void (*p_uart_port_rx)(const uint8_t *data, uint16_t len, void *arg);
+
+/**
+ * @brief  端口注册参数
+ * @param  rx_buf: DMA接收缓冲,帧模式下末尾保留1字节用于'\0'
+ * @param  rx_line: 环形模式下跨越缓冲末尾的帧拷贝至此,帧模式可为NULL
+ * @param  tx_buf: 发送环形缓冲,大小须为2的幂
+ * @param  tx_policy: UART_PORT_TX_xxx
+ */
+typedef struct
+{
+    UART_HandleTypeDef *huart;
+    DMA_HandleTypeDef *hdma_rx;
+    uint8_t rx_mode;
+    uint8_t *rx_buf;
+    uint16_t rx_size;
+    uint8_t *rx_line;
+    uint16_t rx_line_size;
+    uint8_t *tx_buf;
+    uint16_t tx_size;
+    uint8_t tx_policy;
+}uart_port_config_t;
+
+typedef struct __uart_port_t
+{
+    uint8_t id;
+    UART_HandleTypeDef *huart;
+    DMA_HandleTypeDef *hdma_rx;
+    uint8_t rx_mode;
+    uart_rx_frame rx_frame;//帧模式
+    uint16_t rx_size;
+    uart_rx_ring rx_ring;//环形模式
+    uint8_t *rx_line;
+    uint16_t rx_line_size;
+    uint16_t rx_line_len;
+    uint8_t rx_line_ready;//环形模式下队首帧已拷贝至rx_line
+    p_uart_port_rx rx_handler;
+    void *rx_arg;
+    /* head/tail为累计字节数,下标取低位;[tail, tail + tx_dma_len)为DMA正在发送的数据 */
+    uint8_t *tx_buf;
+    uint16_t tx_size;
+    uint8_t tx_policy;
+    uint32_t tx_head;
+    uint32_t tx_tail;
+    uint16_t tx_dma_len;
+    uint32_t tx_drop;
+}uart_port_t;
+
+uart_port_t *uart_port_register(uint8_t id, const uart_port_config_t *config);
+uart_port_t *uart_port_get(uint8_t id);
+
+void uart_port_irq(UART_HandleTypeDef *huart);
+void uart_port_rx_dma_irq(UART_HandleTypeDef *huart);
+void uart_port_tx_cplt(UART_HandleTypeDef *huart);
+
+uint16_t uart_port_write(uart_port_t *port, const uint8_t *data, uint16_t len);
+uint8_t uart_port_printf(uart_port_t *port, const char *fmt, ...);
+void uart_port_tx_kick(uart_port_t *port);
+void uart_port_tx_flush(uart_port_t *port);
+uint32_t uart_port_tx_overflow(uart_port_t *port);
+
+uint8_t *uart_port_rx_buf(uart_port_t *port);
+uint16_t uart_port_rx_len(uart_port_t *port);
+void uart_port_rx_reset(uart_port_t *port);
+void uart_port_set_rx(uart_port_t *port, p_uart_port_rx handler, void *arg);
+void uart_port_poll(uart_port_t *port);
+
+void uart_port_bind_at(uart_port_t *port, struct __at_device_t *at_dev);
+void uart_port_bind_rtu(uart_port_t *port, struct __modbus_rtu_fun_t *fun);
+
+#endif /* __UART_PORT_H__ */
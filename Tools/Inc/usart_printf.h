@@ -5,6 +5,7 @@
 
 #define PRINTF_UART USART1
 #define PRINTF_FPUTC_MODE 0//是否启用FPUTC(不使用蓝牙修改配置)
+#define PRINTF_RX_RING 0//配置串口接收是否使用DMA环形缓冲,启用时配置串口的DMA接收需配置为循环模式
 
 
 typedef struct
@@ -27,16 +28,46 @@ typedef struct
   uint8_t *uart_tx_buf; /* ATK-IDE01 UART发送缓冲 */
 } uart_tx_frame;                                /* ATK-IDE01 UART发送帧缓冲信息结构体 */
 
+/* DMA循环接收环形缓冲:DMA须配置为循环模式,空闲中断与DMA半满/满中断写入帧描述符,任务中零拷贝读取 */
+
+#define UART_RX_RING_DESC_NUM 8                       /* 帧描述符队列长度，须为2的幂 */
+
+typedef struct
+{
+  uint32_t start;                                     /* 帧起始位置(累计字节数)，缓冲下标为start % size */
+  uint16_t len;                                       /* 帧长度 */
+} uart_rx_desc;
+
+typedef struct
+{
+  uint8_t *buf;                                       /* DMA循环接收缓冲 */
+  uint16_t size;                                      /* 缓冲区大小 */
+  uint16_t dma_pos;                                   /* 上次中断时DMA写入位置，仅中断访问 */
+  volatile uint32_t rx_total;                         /* 累计接收字节数，仅中断修改 */
+  uint32_t frame_start;                               /* 当前未结束帧的起始位置，仅中断访问 */
+  volatile uint16_t head;                             /* 描述符写索引，仅中断修改 */
+  volatile uint16_t tail;                             /* 描述符读索引，仅任务修改 */
+  volatile uint16_t overflow;                         /* 溢出丢帧计数 */
+  uart_rx_desc desc[UART_RX_RING_DESC_NUM];
+} uart_rx_ring;
+
+typedef struct
+{
+  const uint8_t *data[2];                             /* 帧在环形缓冲中的位置，回绕时分为两段 */
+  uint16_t len[2];
+} uart_rx_span;
+
 #if PRINTF_FPUTC_MODE == 0
 
 #define PRINTF_RX_BUFFER_SIZE 256
-#define PRINTF_TX_BUFFER_SIZE 256 
 
-static uint8_t printf_rx_buffer[PRINTF_RX_BUFFER_SIZE];
-static uint8_t printf_tx_buffer[PRINTF_TX_BUFFER_SIZE];
+/* 日志发送环形缓冲:printf/config_pirntf/config_hex_printf写入后立即返回,DMA按最大连续段发送 */
+#define PRINTF_TX_RING_SIZE 1024//须为2的幂
+#define PRINTF_TX_DROP_NEWEST 0//缓冲满时丢弃新数据,同UART_PORT_TX_DROP_NEWEST
+#define PRINTF_TX_DROP_OLDEST 1//缓冲满时丢弃最早未发送的数据,同UART_PORT_TX_DROP_OLDEST,仅限文本日志,TRACE_LOG_ENABLE为1时不可用
+#define PRINTF_TX_DROP_POLICY PRINTF_TX_DROP_NEWEST
 
-extern uart_rx_frame printf_rx_frame;
-extern uart_tx_frame printf_tx_frame;
+#define PRINTF_PORT_ID 0//配置串口在uart_port中的端口号
 
 // typedef enum debug_out_type
 // {
@@ -44,13 +75,20 @@ extern uart_tx_frame printf_tx_frame;
 //   debug_out_set = 1,
 // };
 
+uint8_t printf_init(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdma_rx);
 void printf_irq(void);
+uint8_t printf_config_poll(void);
 uint8_t config_pirntf(char *fmt, ...);
 uint8_t config_hex_printf(uint8_t *data, uint16_t len);
 uint8_t *config_get_rx_buffer(void);
 uint16_t config_get_rx_len(void);
 void config_rx_reset(void);
 void debug_out_set(uint8_t status);
+uint8_t debug_out_get(void);
+uint16_t printf_tx_write(const uint8_t *data, uint16_t len);
+void printf_tx_cplt(void);
+void printf_tx_flush(void);
+uint32_t printf_tx_overflow(void);
 
 #endif
 
@@ -63,4 +101,13 @@ void wait_uart_tx_finish_flag(uart_tx_frame *tx_frame);
 uint8_t uart_transmit_dma(UART_HandleTypeDef *huart, uart_tx_frame *tx_frame);
 uint8_t uart_hex_printf(UART_HandleTypeDef *huart, uart_tx_frame *tx_frame, uint8_t *buf, uint16_t len, uint16_t tx_len);
 
+void uart_ring_init(uart_rx_ring *ring, uint8_t *buf, uint16_t size);
+void uart_ring_enable_dma_it(UART_HandleTypeDef *huart, uart_rx_ring *ring, uart_tx_frame *tx_frame);
+void uart_ring_irq(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdma_usart_rx, uart_rx_ring *ring);
+void uart_ring_dma_irq(DMA_HandleTypeDef *hdma_usart_rx, uart_rx_ring *ring);
+void uart_ring_rx_update(uart_rx_ring *ring, uint16_t dma_counter, uint8_t idle);
+uint8_t uart_ring_peek(uart_rx_ring *ring, uart_rx_span *span);
+void uart_ring_release(uart_rx_ring *ring);
+uint16_t uart_rx_span_copy(const uart_rx_span *span, uint8_t *dst, uint16_t size);
+
 #endif /* __USART_PRINTF_H__ */
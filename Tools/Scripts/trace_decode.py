@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+trace_log二进制日志解析工具
+
+从固件axf/elf中按地址取出格式串, 将串口中的二进制记录还原为文本, 普通printf文本原样输出.
+
+用法:
+    python trace_decode.py firmware.axf log.bin            解析保存的串口数据
+    python trace_decode.py firmware.axf COM3 -b 115200     直接读取串口(需pyserial)
+    python trace_decode.py firmware.axf --list             列出全部格式串
+
+记录格式见Tools/Inc/trace_log.h.
+"""
+import argparse
+import codecs
+import re
+import struct
+import sys
+
+TRACE_LOG_SYNC = 0xFF
+TRACE_LOG_ID_BASE = 0x08000000
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+STT_OBJECT = 1
+TRACE_FMT_SYMBOL = 'trace_fmt'  # TRACE_LOG_FMT中的静态格式串变量名
+
+
+class Elf:
+    """只读取已分配段的最小ELF解析, 支持32/64位小端"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF' or data[5] != 1:
+            raise ValueError('%s: not a little-endian ELF file' % path)
+        is64 = data[4] == 2
+        if is64:
+            shoff, = struct.unpack_from('<Q', data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x3A)
+            fmt = '<IIQQQQIIQQ'
+        else:
+            shoff, = struct.unpack_from('<I', data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x2E)
+            fmt = '<IIIIIIIIII'
+        headers = [struct.unpack_from(fmt, data, shoff + i * shentsize) for i in range(shnum)]
+        strtab = headers[shstrndx]
+        self.sections = []
+        self.symbols = []
+        for name, sh_type, flags, addr, offset, size, link in (h[:7] for h in headers):
+            pos = strtab[4] + name
+            sec_name = data[pos:data.index(b'\0', pos)].decode('ascii', 'replace')
+            if flags & SHF_ALLOC and sh_type != SHT_NOBITS and size:
+                self.sections.append((sec_name, addr, data[offset:offset + size]))
+            if sh_type == SHT_SYMTAB:
+                self.symbols += self._symbols(data, is64, offset, size, headers[link][4])
+
+    @staticmethod
+    def _symbols(data, is64, offset, size, strtab):
+        """读取符号表中的数据对象, 返回(名称, 地址)"""
+        entsize = 24 if is64 else 16
+        result = []
+        for pos in range(offset, offset + size - entsize + 1, entsize):
+            if is64:
+                name, info, _, _, value, _ = struct.unpack_from('<IBBHQQ', data, pos)
+            else:
+                name, value, _, info, _, _ = struct.unpack_from('<IIIBBH', data, pos)
+            if info & 0xF != STT_OBJECT:
+                continue
+            end = data.index(b'\0', strtab + name)
+            result.append((data[strtab + name:end].decode('ascii', 'replace'), value))
+        return result
+
+    def string_at(self, addr):
+        for _, base, blob in self.sections:
+            if base <= addr < base + len(blob):
+                end = blob.find(b'\0', addr - base)
+                if end < 0:
+                    return None
+                return blob[addr - base:end].decode('utf-8', 'replace')
+        return None
+
+    def trace_formats(self):
+        """全部格式串, 按地址排序
+
+        GCC保留.trace_fmt段, 可直接遍历段内字符串; armlink把它合并进ER_IROM1等执行域,
+        此时按符号表中的trace_fmt局部变量(GCC为trace_fmt.N)取地址, 链接时需保留局部符号.
+        """
+        found = {}
+        for name, base, blob in self.sections:
+            if name == '.trace_fmt' or name.endswith('.trace_fmt'):
+                pos = 0
+                while pos < len(blob):
+                    end = blob.find(b'\0', pos)
+                    if end < 0:
+                        break
+                    if end > pos:
+                        found[base + pos] = blob[pos:end].decode('utf-8', 'replace')
+                    pos = end + 1
+        for name, addr in self.symbols:
+            if re.split(r'[.$]', name, 1)[0] == TRACE_FMT_SYMBOL and addr not in found:
+                fmt = self.string_at(addr)
+                if fmt:
+                    found[addr] = fmt
+        return sorted(found.items())
+
+
+CONV = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXcsp%])')
+
+
+def c_format(fmt, args):
+    """按C printf规则格式化整型参数"""
+    it = iter(args)
+
+    def repl(m):
+        flags, _, conv = m.groups()
+        if conv == '%':
+            return '%'
+        try:
+            value = next(it)
+        except StopIteration:
+            return m.group(0)
+        if conv in 'ouxX':
+            value &= 0xFFFFFFFF
+        elif conv == 'c':
+            return chr(value & 0xFF)
+        elif conv in 'sp':
+            return '<0x%08X>' % (value & 0xFFFFFFFF)
+        else:
+            conv = 'd'
+        return ('%' + flags + conv) % value
+
+    return CONV.sub(repl, fmt)
+
+
+def read_varint(buf, pos, end):
+    value = 0
+    shift = 0
+    while pos < end:
+        b = buf[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        if b < 0x80:
+            return value, pos
+        shift += 7
+        if shift > 28:
+            break
+    raise ValueError('bad varint')
+
+
+class Decoder:
+    def __init__(self, elf, base, timestamps):
+        self.elf = elf
+        self.base = base
+        self.timestamps = timestamps
+        self.tick = 0
+        self.buf = bytearray()
+        self.text = bytearray()
+        self.utf8 = codecs.getincrementaldecoder('utf-8')('replace')  # 文本可能在数据块边界处截断
+
+    def _record(self, payload):
+        """解析一条记录负载, 格式串不存在时视为非记录数据"""
+        end = len(payload)
+        delta, pos = read_varint(payload, 0, end)
+        fmt_id, pos = read_varint(payload, pos, end)
+        fmt = self.elf.string_at((fmt_id + self.base) & 0xFFFFFFFF)
+        if fmt is None:
+            raise ValueError('unknown format id')
+        args = []
+        while pos < end:
+            z, pos = read_varint(payload, pos, end)
+            args.append((z >> 1) ^ -(z & 1))
+        self.tick = (self.tick + delta) & 0xFFFFFFFF
+        text = c_format(fmt, args)
+        if self.timestamps:
+            text = '[%10u] %s' % (self.tick, text)
+        return text
+
+    def _flush_text(self, out):
+        if self.text:
+            out.write(self.utf8.decode(bytes(self.text)))
+            self.text.clear()
+
+    def feed(self, data, out):
+        self.buf += data
+        i = 0
+        buf = self.buf
+        while i < len(buf):
+            if buf[i] != TRACE_LOG_SYNC:
+                self.text.append(buf[i])
+                i += 1
+                continue
+            if i + 2 > len(buf) or i + 2 + buf[i + 1] > len(buf):
+                break  # 记录不完整,等待后续数据
+            try:
+                text = self._record(bytes(buf[i + 2:i + 2 + buf[i + 1]]))
+            except ValueError:
+                self.text.append(buf[i])
+                i += 1
+                continue
+            self._flush_text(out)
+            out.write(text)
+            i += 2 + buf[i + 1]
+        del buf[:i]
+        self._flush_text(out)
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode trace_log binary records')
+    parser.add_argument('elf', help='firmware axf/elf built with trace_log')
+    parser.add_argument('input', nargs='?', default='-', help='captured log file, serial port, or - for stdin')
+    parser.add_argument('-b', '--baud', type=int, default=115200, help='serial baud rate')
+    parser.add_argument('--base', type=lambda x: int(x, 0), default=TRACE_LOG_ID_BASE,
+                        help='TRACE_LOG_ID_BASE used by the firmware (default 0x08000000)')
+    parser.add_argument('-t', '--timestamps', action='store_true', help='prefix records with HAL tick')
+    parser.add_argument('--list', action='store_true', help='list format strings and exit')
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    if args.list:
+        for addr, fmt in elf.trace_formats():
+            print('%6u  %r' % (addr - args.base, fmt))
+        return
+
+    decoder = Decoder(elf, args.base, args.timestamps)
+    out = sys.stdout
+    if args.input == '-':
+        src = sys.stdin.buffer
+    elif args.input.upper().startswith('COM') or args.input.startswith('/dev/'):
+        import serial
+        src = serial.Serial(args.input, args.baud, timeout=0.1)
+    else:
+        src = open(args.input, 'rb')
+    try:
+        while True:
+            data = src.read(4096) if not hasattr(src, 'in_waiting') else src.read(max(1, src.in_waiting))
+            if not data:
+                if hasattr(src, 'in_waiting'):
+                    continue
+                break
+            decoder.feed(data, out)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -2,10 +2,16 @@
 #include "string.h"
 #include "stdio.h"
 #include "at_cmd_tools.h"
+#include "sys_delay.h"
+#include "trace_log.h"
+#if RTOS == 1
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
 
 #define AT_CMD_TOOLS_DEBUG 1
 #if AT_CMD_TOOLS_DEBUG == 1
-#define AT_LOG(fmt, ...) printf("[AT TOOLS] " fmt "\r\n", ##__VA_ARGS__)
+#define AT_LOG(fmt, ...) TRACE_LOG_TEXT(TRACE_MOD_AT, TRACE_LEVEL_DEBUG, "[AT TOOLS] " fmt "\r\n", ##__VA_ARGS__)
 #else
 #define AT_LOG(fmt, ...)
 #endif
@@ -22,7 +28,7 @@
  */
 at_cmd_status_t at_ack_get_str_parameter(uint8_t *src, uint8_t param_num, uint16_t *param_index, uint16_t *param_len)
 {
-    uint8_t src_index = 0;
+    uint16_t src_index = 0;
     uint16_t _param_index = 0;
     uint16_t _param_len = 0;
     uint8_t param_flag = 0;
@@ -98,7 +104,7 @@ at_cmd_status_t at_ack_get_str_parameter(uint8_t *src, uint8_t param_num, uint16
  */
 at_cmd_status_t at_ack_get_normal_parameter(uint8_t *src, uint8_t param_num, uint16_t *param_index, uint16_t *param_len)
 {
-    uint8_t src_index = 0;
+    uint16_t src_index = 0;
     uint16_t _param_index = 0;
     uint16_t _param_len = 0;
     uint8_t _param_num = 0;
@@ -150,6 +156,122 @@ at_cmd_status_t at_ack_get_normal_parameter(uint8_t *src, uint8_t param_num, uin
     return AT_CMD_OK;
 }
 
+/**
+ * @brief       一次扫描把应答行拆分为参数表
+ * @param       src   : AT模块的AT响应
+ * @param       prefix: 应答前缀,如"+OK"、"+UART",从其后的第一个'='或':'开始解析;
+ *                      NULL时从src开头查找
+ * @param       fields: 输出的参数表
+ * @retval      AT_CMD_OK       : 解析成功
+ * @retval      AT_CMD_PARMINVAL: 未找到前缀或'='/':'
+ * @retval      AT_CMD_ERROR    : 参数个数超过AT_ACK_FIELD_NUM
+ * @note        参数以逗号分隔,以\r、\n或\0结束;带双引号的参数内可含逗号,
+ *              偏移和长度不含引号。前缀可跳过回显命令中的等号
+ */
+at_cmd_status_t at_ack_tokenize(const uint8_t *src, const char *prefix, at_ack_fields_t *fields)
+{
+    const uint8_t *p = src;
+    const uint8_t *start;
+    uint8_t quoted;
+
+    if(src == NULL || fields == NULL)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+    fields->src = src;
+    fields->num = 0;
+
+    if(prefix != NULL)
+    {
+        p = (const uint8_t *)strstr((const char *)src, prefix);
+        if(p == NULL)
+        {
+            return AT_CMD_PARMINVAL;
+        }
+    }
+    while(*p != '\0' && *p != '=' && *p != ':')
+    {
+        p++;
+    }
+    if(*p == '\0')
+    {
+        return AT_CMD_PARMINVAL;
+    }
+    p++;
+
+    while(1)
+    {
+        if(fields->num >= AT_ACK_FIELD_NUM)
+        {
+            return AT_CMD_ERROR;
+        }
+        quoted = (*p == '"');
+        if(quoted)
+        {
+            p++;
+        }
+        start = p;
+        if(quoted)
+        {
+            while(*p != '\0' && *p != '"')
+            {
+                p++;
+            }
+        }
+        else
+        {
+            while(*p != '\0' && *p != ',' && *p != '\r' && *p != '\n')
+            {
+                p++;
+            }
+        }
+        fields->field[fields->num].index = (uint16_t)(start - src);
+        fields->field[fields->num].len = (uint16_t)(p - start);
+        fields->num++;
+        //跳过闭合引号到分隔符
+        while(*p != '\0' && *p != ',' && *p != '\r' && *p != '\n')
+        {
+            p++;
+        }
+        if(*p != ',')
+        {
+            break;
+        }
+        p++;
+    }
+
+    return AT_CMD_OK;
+}
+
+/**
+ * @brief       复制参数表中的第param_num个参数并补\0
+ * @param       fields   : at_ack_tokenize生成的参数表
+ * @param       param_num: 参数的索引,从1开始
+ * @param       dst      : 目标缓冲区
+ * @param       size     : 目标缓冲区大小
+ * @retval      AT_CMD_OK       : 复制成功
+ * @retval      AT_CMD_PARMINVAL: 索引超出参数个数
+ * @retval      AT_CMD_ERROR    : 参数长度超出缓冲区
+ */
+at_cmd_status_t at_ack_field_copy(const at_ack_fields_t *fields, uint8_t param_num, char *dst, uint16_t size)
+{
+    uint16_t len;
+
+    if(param_num == 0 || param_num > fields->num || dst == NULL)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+    len = fields->field[param_num - 1].len;
+    if(len >= size)
+    {
+        return AT_CMD_ERROR;
+    }
+    memcpy(dst, fields->src + fields->field[param_num - 1].index, len);
+    dst[len] = '\0';
+
+    return AT_CMD_OK;
+}
+
 /**
  * @brief  Send AT command
  * @param  at_dev: AT device
@@ -275,3 +397,455 @@ char *at_cmd_pack(char *at_cmd, char *cmd_code, char *cmd_para)
         sprintf(at_cmd, "AT+%s\r\n", cmd_code);
     return at_cmd;
 }
+
+/* ------------------------------------------------------------------------- */
+/* async AT engine                                                           */
+/* ------------------------------------------------------------------------- */
+
+#define AT_ENGINE_ENTER_CRITICAL() uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define AT_ENGINE_EXIT_CRITICAL() __set_PRIMASK(primask)
+
+/**
+ * @brief  队首命令进入等待应答状态,须在临界区内调用
+ * @param  engine: 引擎实例
+ * @note   计时起点与应答缓冲须和busy同时设置,否则at_engine_poll可能按上一条命令的
+ *         start_tick判定超时,空闲中断也可能把应答追加到旧的应答缓冲
+ */
+static void at_engine_arm(at_engine_t *engine)
+{
+    engine->resp_len = 0;
+    engine->resp[0] = '\0';
+    engine->start_tick = HAL_GetTick();
+    engine->busy = 1;
+}
+
+/**
+ * @brief  发送队首命令
+ * @param  at_dev: AT device
+ * @note   调用者已在临界区内调用at_engine_arm;发送前命令可能已被超时出队,队列为空时不发送
+ */
+static void at_engine_start(at_device_t *at_dev)
+{
+    at_engine_t *engine = at_dev->engine;
+    at_engine_cmd_t *cmd = &engine->queue[engine->head];
+
+    if(engine->count == 0)
+    {
+        return;
+    }
+    at_dev->at_cmd_pprintf(cmd->sp ? AT_SP_SEND_CMD : "%s\r\n", cmd->cmd);
+}
+
+/**
+ * @brief  队首命令出队,须在临界区内调用
+ * @param  engine: 引擎实例
+ * @param  complete: 出队命令的回调
+ * @param  arg: 出队命令的透传参数
+ */
+static void at_engine_pop(at_engine_t *engine, p_at_complete *complete, void **arg)
+{
+    *complete = engine->queue[engine->head].complete;
+    *arg = engine->queue[engine->head].arg;
+    engine->head = (engine->head + 1) % AT_ENGINE_QUEUE_LEN;
+    engine->count--;
+    engine->busy = 0;
+}
+
+/**
+ * @brief  回调已出队的命令,并发出下一条命令
+ * @param  at_dev: AT device
+ * @param  status: 命令结果
+ * @param  complete: 出队命令的回调
+ * @param  arg: 出队命令的透传参数
+ */
+static void at_engine_finish(at_device_t *at_dev, at_cmd_status_t status, p_at_complete complete, void *arg)
+{
+    at_engine_t *engine = at_dev->engine;
+
+    while(1)
+    {
+        if(complete != NULL)
+        {
+            complete(status, engine->resp, arg);
+        }
+
+        AT_ENGINE_ENTER_CRITICAL();
+        if(engine->count == 0 || engine->busy)
+        {
+            AT_ENGINE_EXIT_CRITICAL();
+            return;
+        }
+        at_engine_arm(engine);
+        AT_ENGINE_EXIT_CRITICAL();
+
+        at_engine_start(at_dev);
+        //无需应答的命令发出即完成
+        if(engine->queue[engine->head].timeout != 0)
+        {
+            return;
+        }
+        {
+            AT_ENGINE_ENTER_CRITICAL();
+            at_engine_pop(engine, &complete, &arg);
+            AT_ENGINE_EXIT_CRITICAL();
+        }
+        status = AT_CMD_OK;
+    }
+}
+
+/**
+ * @brief  结束队首命令
+ * @param  at_dev: AT device
+ * @param  status: 命令结果
+ */
+static void at_engine_done(at_device_t *at_dev, at_cmd_status_t status)
+{
+    at_engine_t *engine = at_dev->engine;
+    p_at_complete complete;
+    void *arg;
+
+    AT_ENGINE_ENTER_CRITICAL();
+    if(engine->busy == 0 || engine->count == 0)
+    {
+        AT_ENGINE_EXIT_CRITICAL();
+        return;
+    }
+    at_engine_pop(engine, &complete, &arg);
+    AT_ENGINE_EXIT_CRITICAL();
+    at_engine_finish(at_dev, status, complete, arg);
+}
+
+/**
+ * @brief  当前行追加至应答缓冲,多行以\n拼接,超长部分丢弃
+ * @param  engine: AT engine
+ */
+static void at_engine_resp_append(at_engine_t *engine)
+{
+    uint16_t len = engine->line_len;
+
+    if(engine->resp_len + 2 > AT_ENGINE_RESP_LEN)
+    {
+        return;
+    }
+    if(len > AT_ENGINE_RESP_LEN - engine->resp_len - 2)
+    {
+        len = AT_ENGINE_RESP_LEN - engine->resp_len - 2;
+    }
+    memcpy(&engine->resp[engine->resp_len], engine->line, len);
+    engine->resp_len += len;
+    engine->resp[engine->resp_len++] = '\n';
+    engine->resp[engine->resp_len] = '\0';
+}
+
+/**
+ * @brief  处理一行应答: 命令应答 > 错误 > URC > 中间结果
+ * @param  at_dev: AT device
+ */
+static void at_engine_line(at_device_t *at_dev)
+{
+    at_engine_t *engine = at_dev->engine;
+    const char *line = engine->line;
+    uint8_t i;
+
+    if(engine->busy)
+    {
+        at_engine_cmd_t *cmd = &engine->queue[engine->head];
+
+        if(strncmp(line, cmd->ack, strlen(cmd->ack)) == 0)
+        {
+            //应答行同样交给回调,如"+OK=xxx"中的参数
+            at_engine_resp_append(engine);
+            at_engine_done(at_dev, AT_CMD_OK);
+            return;
+        }
+        if(strncmp(line, "ERROR", 5) == 0 || strncmp(line, "+ERR", 4) == 0)
+        {
+            at_engine_done(at_dev, AT_CMD_ERROR);
+            return;
+        }
+    }
+
+    for(i = 0; i < engine->urc_num; i++)
+    {
+        if(strncmp(line, engine->urc[i].prefix, strlen(engine->urc[i].prefix)) == 0)
+        {
+            engine->urc[i].handler(line, engine->urc[i].arg);
+            return;
+        }
+    }
+
+    if(engine->busy)
+    {
+        at_engine_resp_append(engine);
+    }
+}
+
+/**
+ * @brief  入队一条命令,引擎空闲时立即发出
+ */
+static at_cmd_status_t at_engine_submit(at_device_t *at_dev, const char *cmd, const char *ack, uint32_t timeout,
+                                        uint8_t sp, p_at_complete complete, void *arg)
+{
+    at_engine_t *engine = at_dev->engine;
+    at_engine_cmd_t *slot;
+    uint8_t start = 0;
+
+    if(engine == NULL || cmd == NULL || strlen(cmd) >= AT_ENGINE_CMD_LEN)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+
+    AT_ENGINE_ENTER_CRITICAL();
+    if(engine->count >= AT_ENGINE_QUEUE_LEN)
+    {
+        AT_ENGINE_EXIT_CRITICAL();
+        return AT_CMD_ERROR;
+    }
+    slot = &engine->queue[(engine->head + engine->count) % AT_ENGINE_QUEUE_LEN];
+    strcpy(slot->cmd, cmd);
+    slot->ack = (ack != NULL) ? ack : "OK";
+    slot->timeout = timeout;
+    slot->sp = sp;
+    slot->complete = complete;
+    slot->arg = arg;
+    engine->count++;
+    if(engine->busy == 0)
+    {
+        at_engine_arm(engine);
+        start = 1;
+    }
+    AT_ENGINE_EXIT_CRITICAL();
+
+    AT_LOG("cmd: %s", cmd);
+    if(start)
+    {
+        at_engine_start(at_dev);
+        if(timeout == 0)
+        {
+            at_engine_done(at_dev, AT_CMD_OK);
+        }
+    }
+    return AT_CMD_OK;
+}
+
+/**
+ * @brief  绑定异步AT引擎
+ * @param  at_dev: AT device
+ * @param  engine: 引擎实例,生命周期需与at_dev一致
+ * @note   绑定后模块串口的空闲中断需把数据交给at_engine_rx_input,
+ *         原有阻塞接口at_cmd_send/at_sp_cmd_send不受影响
+ */
+void at_engine_init(at_device_t *at_dev, at_engine_t *engine)
+{
+    memset(engine, 0, sizeof(at_engine_t));
+    at_dev->engine = engine;
+}
+
+/**
+ * @brief  注册URC(主动上报)处理函数
+ * @param  at_dev: AT device
+ * @param  prefix: 行前缀,需为常量字符串,如"+RECV"
+ * @param  handler: 处理函数,在at_engine_rx_input的上下文中调用
+ * @param  arg: 透传参数
+ * @retval AT_CMD_OK: 注册成功
+ * @retval AT_CMD_ERROR: URC表已满
+ * @retval AT_CMD_PARMINVAL: 参数错误
+ */
+at_cmd_status_t at_engine_urc_register(at_device_t *at_dev, const char *prefix, p_at_urc handler, void *arg)
+{
+    at_engine_t *engine = at_dev->engine;
+
+    if(engine == NULL || prefix == NULL || handler == NULL)
+    {
+        return AT_CMD_PARMINVAL;
+    }
+    if(engine->urc_num >= AT_ENGINE_URC_NUM)
+    {
+        return AT_CMD_ERROR;
+    }
+    engine->urc[engine->urc_num].prefix = prefix;
+    engine->urc[engine->urc_num].handler = handler;
+    engine->urc[engine->urc_num].arg = arg;
+    engine->urc_num++;
+    return AT_CMD_OK;
+}
+
+/**
+ * @brief  异步发送AT命令,立即返回
+ * @param  at_dev: AT device
+ * @param  cmd: AT command, 入队时复制
+ * @param  ack: 应答行前缀,NULL时为"OK"
+ * @param  timeout: 超时ms,0表示无需应答
+ * @param  complete: 完成回调,可为NULL
+ * @param  arg: 透传参数
+ * @retval AT_CMD_OK: 已入队
+ * @retval AT_CMD_ERROR: 队列已满
+ * @retval AT_CMD_PARMINVAL: 参数错误或命令过长
+ */
+at_cmd_status_t at_cmd_send_async(at_device_t *at_dev, const char *cmd, const char *ack, uint32_t timeout,
+                                  p_at_complete complete, void *arg)
+{
+    return at_engine_submit(at_dev, cmd, ack, timeout, 0, complete, arg);
+}
+
+/**
+ * @brief  异步发送不带\r\n的AT命令,参数同at_cmd_send_async
+ * @note   如"+++"的应答"a"不带换行,由at_engine_rx_input在帧尾匹配
+ */
+at_cmd_status_t at_sp_cmd_send_async(at_device_t *at_dev, const char *cmd, const char *ack, uint32_t timeout,
+                                     p_at_complete complete, void *arg)
+{
+    return at_engine_submit(at_dev, cmd, ack, timeout, 1, complete, arg);
+}
+
+typedef struct
+{
+    volatile uint8_t done;
+    at_cmd_status_t status;
+    char *resp;
+    uint16_t resp_len;
+#if RTOS == 1
+    TaskHandle_t task;
+#endif
+} at_engine_wait_t;
+
+static void at_engine_wait_complete(at_cmd_status_t status, const char *resp, void *arg)
+{
+    at_engine_wait_t *wait = (at_engine_wait_t *)arg;
+
+    if(wait->resp != NULL && wait->resp_len > 0)
+    {
+        strncpy(wait->resp, resp, wait->resp_len - 1);
+        wait->resp[wait->resp_len - 1] = '\0';
+    }
+    wait->status = status;
+    wait->done = 1;
+#if RTOS == 1
+    if(__get_IPSR() != 0)
+    {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(wait->task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    else
+    {
+        xTaskNotifyGive(wait->task);
+    }
+#endif
+}
+
+/**
+ * @brief  经异步引擎发送命令并等待结果
+ * @param  at_dev: AT device
+ * @param  cmd: AT command
+ * @param  ack: 应答行前缀,NULL时为"OK"
+ * @param  timeout: 超时ms
+ * @param  resp: 应答内容输出,可为NULL
+ * @param  resp_len: resp缓冲区大小
+ * @retval 命令结果
+ * @note   RTOS == 1时调用任务阻塞在任务通知上,不占用CPU;
+ *         否则以at_delay_ms(1)轮询,仅适合初始化阶段
+ */
+at_cmd_status_t at_cmd_send_wait(at_device_t *at_dev, const char *cmd, const char *ack, uint32_t timeout,
+                                 char *resp, uint16_t resp_len)
+{
+    at_engine_wait_t wait;
+    at_cmd_status_t ret;
+
+    wait.done = 0;
+    wait.status = AT_CMD_TIMEOUT;
+    wait.resp = resp;
+    wait.resp_len = resp_len;
+#if RTOS == 1
+    wait.task = xTaskGetCurrentTaskHandle();
+#endif
+    ret = at_engine_submit(at_dev, cmd, ack, timeout, 0, at_engine_wait_complete, &wait);
+    if(ret != AT_CMD_OK)
+    {
+        return ret;
+    }
+    while(wait.done == 0)
+    {
+#if RTOS == 1
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout));
+#else
+        at_dev->at_delay_ms(1);
+#endif
+        at_engine_poll(at_dev);
+    }
+    return wait.status;
+}
+
+/**
+ * @brief  接收数据入口,在串口空闲中断中调用
+ * @param  at_dev: AT device
+ * @param  data: 一次空闲中断收到的数据
+ * @param  len: 数据长度
+ * @note   按\r/\n分行,空行忽略;不带换行的应答(如"a")在帧尾匹配
+ */
+void at_engine_rx_input(at_device_t *at_dev, const uint8_t *data, uint16_t len)
+{
+    at_engine_t *engine = at_dev->engine;
+    uint16_t i;
+
+    if(engine == NULL)
+    {
+        return;
+    }
+    for(i = 0; i < len; i++)
+    {
+        if(data[i] == '\r' || data[i] == '\n')
+        {
+            if(engine->line_len > 0)
+            {
+                engine->line[engine->line_len] = '\0';
+                at_engine_line(at_dev);
+                engine->line_len = 0;
+            }
+        }
+        else if(engine->line_len < AT_ENGINE_LINE_LEN - 1)
+        {
+            engine->line[engine->line_len++] = (char)data[i];
+        }
+    }
+    //sp命令(如透传数据)的应答可能不带行尾,帧尾残行已匹配应答前缀则立即完成,其余留待下一帧拼接
+    if(engine->line_len > 0 && engine->busy && engine->queue[engine->head].sp)
+    {
+        const char *ack = engine->queue[engine->head].ack;
+
+        engine->line[engine->line_len] = '\0';
+        if(strncmp(engine->line, ack, strlen(ack)) == 0)
+        {
+            at_engine_line(at_dev);
+            engine->line_len = 0;
+        }
+    }
+}
+
+/**
+ * @brief  超时检查,在主循环或定时任务中调用
+ * @param  at_dev: AT device
+ */
+void at_engine_poll(at_device_t *at_dev)
+{
+    at_engine_t *engine = at_dev->engine;
+    p_at_complete complete;
+    void *arg;
+
+    if(engine == NULL)
+    {
+        return;
+    }
+    //超时判断与出队在同一临界区内,避免与空闲中断中的应答重复完成;无需应答的命令由发出者出队
+    AT_ENGINE_ENTER_CRITICAL();
+    if(engine->busy == 0 || engine->count == 0 || engine->queue[engine->head].timeout == 0 ||
+       (HAL_GetTick() - engine->start_tick) < engine->queue[engine->head].timeout)
+    {
+        AT_ENGINE_EXIT_CRITICAL();
+        return;
+    }
+    at_engine_pop(engine, &complete, &arg);
+    AT_ENGINE_EXIT_CRITICAL();
+    AT_LOG("timeout");
+    at_engine_finish(at_dev, AT_CMD_TIMEOUT, complete, arg);
+}
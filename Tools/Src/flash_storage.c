@@ -3,157 +3,611 @@
 #include "crc_tools.h"
 #include <string.h>
 
+#define STORAGE_READ_BATCH 8 // 扇区扫描时单次读取的数据块数
+
+/* 管理扇区内各表的偏移 */
+#define STORAGE_ERASE_OFFSET STORAGE_META_HEADER_SIZE
+#define STORAGE_INDEX_OFFSET(dev) (STORAGE_ERASE_OFFSET + (dev)->sector_num * sizeof(uint16_t))
+#define STORAGE_JOURNAL_OFFSET(dev) (STORAGE_INDEX_OFFSET(dev) + (dev)->sector_num * sizeof(StorageSectorSummary))
+
 /* 私有全局变量 */
 
-static FlashManager fmanager;
-static StorageDriver storage_driver;
+static FlashManager fmanager; // 默认实例
+static uint16_t fmanager_erase[STORAGE_MAX_SECTOR_NUM];
+static StorageSectorSummary fmanager_index[STORAGE_MAX_SECTOR_NUM];
+static StorageConfig storage_config = {
+    .format = STORAGE_FORMAT_FIXED,
+    .sector_erase = fmanager_erase,
+    .sector_index = fmanager_index,
+    .table_num = STORAGE_MAX_SECTOR_NUM,
+};
+static FlashManager* storage_dev_list; // 已注册实例链表
+static uint8_t storage_page_pool[STORAGE_PAGE_POOL_NUM][STORAGE_PAGE_SIZE];
+static FlashManager* storage_page_owner[STORAGE_PAGE_POOL_NUM];
 
 /* 私有函数声明 */
 
 static uint8_t	validate_block(StorageBlock* block);// 校验数据块
-static void format_storage_area(void);// 格式化存储区域
-static void update_sector_usage(void);// 更新扇区使用计数
-static void recycle_oldest_sector(void);// 回收最旧扇区
-static uint32_t find_oldest_sector(void);// 查找最旧扇区
+static void format_storage_area(FlashManager* dev);// 格式化存储区域
+static void update_sector_summary(FlashManager* dev, uint32_t timestamp, uint32_t size);// 更新扇区摘要索引
+static void recycle_oldest_sector(FlashManager* dev);// 回收最旧扇区
+static uint32_t sector_base_addr(FlashManager* dev, uint32_t sector);// 数据扇区起始地址
+static uint32_t sector_data_addr(FlashManager* dev, uint32_t sector);// 数据扇区数据区起始地址
+static uint32_t sector_logic_to_phys(FlashManager* dev, uint32_t logic);// 环形逻辑序号转数据扇区序号
+static uint32_t sector_read_seq(FlashManager* dev, uint32_t sector);// 读取扇区头序列号
+static void stage_sector_header(FlashManager* dev);// 写入当前扇区头
+static uint32_t recover_head_sector(FlashManager* dev);// 二分查找写入扇区
+static void recover_head_data(FlashManager* dev);// 恢复写入扇区的写入位置与摘要
+static uint8_t region_erased(FlashManager* dev, uint32_t addr, uint32_t len);// 判断区域是否为擦除状态
+static uint32_t sector_search_time(FlashManager* dev, uint32_t start_time);// 二分查找时间所在扇区
+static void sector_time_check(FlashManager* dev);// 检查扇区时间戳是否有序
+static uint32_t sector_scan_time(FlashManager* dev, uint32_t sector, uint32_t start_time, uint32_t end_time);// 扫描单扇区
+static uint8_t storage_read(FlashManager* dev, uint32_t addr, uint8_t* buf, uint32_t len);// 读取(含暂存页数据)
+static uint8_t storage_program(FlashManager* dev, uint32_t addr, uint8_t* buf, uint32_t len);// 写入Flash并统计
+static uint8_t storage_erase_sector(FlashManager* dev, uint32_t addr);// 擦除扇区并统计
+static uint8_t stage_write(FlashManager* dev, uint8_t* buf, uint32_t len);// 写入暂存页
+static uint8_t stage_flush_page(FlashManager* dev);// 暂存页写入Flash
+static void mark_meta_dirty(FlashManager* dev, uint32_t sector);// 标记索引表项待回写
+static void persist_meta(FlashManager* dev);// 回写索引表
+static uint32_t meta_base_addr(FlashManager* dev, uint32_t meta);// 管理扇区起始地址
+static uint8_t meta_load(FlashManager* dev);// 读取较新的管理扇区
+static void meta_compact(FlashManager* dev);// 完整表格写入另一管理扇区
+static void sector_erase_count(FlashManager* dev, uint32_t sector);// 擦除数据扇区并计数
+static void storage_set_range(FlashManager* dev, uint32_t start, uint32_t end);// 设置存储范围并计算数据扇区数
+static uint8_t* page_pool_acquire(FlashManager* dev);// 从缓冲池获取暂存页
+static void page_pool_release(FlashManager* dev);// 归还暂存页
+static void storage_dev_unlink(FlashManager* dev);// 从实例链表移除
+static uint8_t cursor_load_sector(StorageCursor* cursor);// 游标定位至下一个有效扇区
+static const StorageBlock* cursor_fetch(StorageCursor* cursor, uint32_t addr);// 从窗口获取数据块
+static uint32_t cursor_window(StorageCursor* cursor, uint32_t addr);// 读取addr起始的窗口
+static uint8_t cursor_match(const StorageFilter* filter, uint16_t type, uint32_t id, uint32_t timestamp);// 过滤条件匹配
+static uint8_t varint_encode(uint8_t* buf, uint32_t value);// varint编码
+static uint8_t varint_decode(const uint8_t* buf, uint32_t len, uint32_t* value);// varint解码
+static uint32_t record_encode(uint8_t* buf, uint16_t type, uint32_t id, int32_t delta, const uint8_t* data, uint16_t length);// 变长记录编码
+static uint32_t record_parse(const uint8_t* buf, uint32_t len, uint32_t base_time, StorageRecord* out);// 变长记录解析
 
 /**
- * @brief 驱动注册
+ * @brief 注册并初始化存储实例
+ * @note 同一实例可重复调用以重新初始化,各实例的存储范围不能重叠
  * 
- * @param driver 驱动接口结构体
- * @return void
- * @todo 考虑修改成设备注册模式
+ * @param dev 实例,由调用者分配
+ * @param config 实例配置
+ * @return 1 :成功
+ * @return 0 :失败
  */
-void storage_driver_register(StorageDriver* driver) {
-    memcpy(&storage_driver, driver, sizeof(StorageDriver));
+uint8_t storage_dev_open(FlashManager* dev, const StorageConfig* config) {
+    if(dev == NULL || config == NULL) return 0;
+    if(!config->driver.read || !config->driver.write || !config->driver.erase_sector) return 0;
+    if(config->sector_erase == NULL || config->sector_index == NULL || config->sector_size == 0) return 0;
+
+    /* 重新初始化时先释放暂存页并移出链表 */
+    page_pool_release(dev);
+    storage_dev_unlink(dev);
+
+    memset(dev, 0, sizeof(FlashManager));
+    memcpy(&dev->driver, &config->driver, sizeof(StorageDriver));
+    dev->sector_size = config->sector_size;
+    dev->format = config->format;
+    dev->sector_erase = config->sector_erase;
+    dev->sector_index = config->sector_index;
+    dev->table_num = config->table_num;
+    dev->page_addr = STORAGE_INVALID_ADDR;
+    storage_set_range(dev, config->start_addr, config->end_addr);
+    if(dev->sector_num == 0) return 0;
+    memset(dev->sector_erase, 0, dev->sector_num * sizeof(uint16_t));
+    memset(dev->sector_index, 0, dev->sector_num * sizeof(StorageSectorSummary));
+
+    dev->next = storage_dev_list;
+    storage_dev_list = dev;
+
+    /* 全新初始化或格式不一致,保留已有的擦除计数 */
+    if(!meta_load(dev)) {
+        format_storage_area(dev);
+        return 1;
+    }
+
+    /* 按扇区头序列号查找写入扇区,并恢复掉电前未回写索引的数据 */
+    dev->head_sector = recover_head_sector(dev);
+    if(dev->head_sector == STORAGE_INVALID_ADDR) {
+        format_storage_area(dev);
+        return 1;
+    }
+    recover_head_data(dev);
+    dev->oldest_sector = sector_base_addr(dev, sector_logic_to_phys(dev, 0));
+    sector_time_check(dev);
+    return 1;
 }
 
 /**
- * @brief 存储初始化
+ * @brief 写入暂存数据并注销实例
  * 
- * @param user_start 用户指定起始地址
- * @param user_end 用户指定结束地址
- * @return 1
+ * @param dev 实例
  */
-uint8_t storage_init(uint32_t user_start, uint32_t user_end) {
-    if(!storage_driver.read || !storage_driver.write) return 0;
-
-    memset(&fmanager, 0, sizeof(FlashManager));
-    set_storage_range(user_start, user_end);
-
-    /* 扫描现有数据 */
-    uint32_t addr = fmanager.start_addr;
-    while(addr < fmanager.end_addr) {
-        uint8_t header[2];
-        storage_driver.read(addr, header, 2);
-        
-        if(header[0] == 0xA5 && header[1] == 0x5A) {
-            fmanager.current_addr = addr;
-            storage_driver.read(addr + 2, (uint8_t*)&fmanager.sector_usage, 
-                              sizeof(fmanager.sector_usage));
-            break;
-        }
-        addr += W25QXX_SECTOR_SIZE;
-    }
+void storage_dev_close(FlashManager* dev) {
+    if(dev == NULL) return;
 
-    /* 全新初始化 */
-    if(addr >= fmanager.end_addr) {
-        format_storage_area();
-    }
-    return 1;
+    storage_dev_flush(dev);
+    page_pool_release(dev);
+    storage_dev_unlink(dev);
 }
 
 /**
- * @brief 
+ * @brief 写入数据块
+ * @note 数据块先进入暂存页,页满、超时(storage_flush_poll)或调用storage_dev_flush时写入Flash
+ * @note 索引表仅在切换扇区和调用storage_dev_flush时回写
  * 
+ * @param dev 实例
  * @param block 
- * @return 0 :成功
- * @return 1 :失败
+ * @return 1 :成功
+ * @return 0 :失败
  */
-uint8_t write_data_block(StorageBlock* block) {
+uint8_t storage_dev_write_block(FlashManager* dev, StorageBlock* block) {
+    if(dev->format != STORAGE_FORMAT_FIXED) return 0;
+
     /* 计算校验值 */
     block->crc = crc8((uint8_t*)block, sizeof(StorageBlock)-1);
-    
-    /* 空间检查 */
-    if(fmanager.current_addr + sizeof(StorageBlock) > fmanager.end_addr) {
-        recycle_oldest_sector();
-    }
-    
-    /* 执行写入 */
-    if(!storage_driver.write(fmanager.current_addr, 
-                           (uint8_t*)block, 
-                           sizeof(StorageBlock))) {
+
+    /* 空间检查,数据块不跨扇区 */
+    uint32_t sector_end = sector_base_addr(dev, dev->head_sector) + dev->sector_size;
+    if(dev->current_addr + sizeof(StorageBlock) > sector_end) {
+        recycle_oldest_sector(dev);
+    }
+
+    /* 写入暂存页,同时更新地址指针 */
+    if(!stage_write(dev, (uint8_t*)block, sizeof(StorageBlock))) {
         return 0;
     }
-    
-    /* 更新地址指针 */
-    fmanager.current_addr += sizeof(StorageBlock);
-    update_sector_usage();
+
+    dev->stats.logical_bytes += sizeof(StorageBlock);
+    dev->stats.records++;
+    dev->last_write_tick = HAL_GetTick();
+    update_sector_summary(dev, block->timestamp, sizeof(StorageBlock));
+    return 1;
+}
+
+/**
+ * @brief 写入变长记录,仅STORAGE_FORMAT_VAR格式可用
+ * @note 与storage_dev_write_block相同,经暂存页写入Flash
+ * 
+ * @param dev 实例
+ * @param type 数据类型
+ * @param id 数据标识
+ * @param timestamp Unix时间戳
+ * @param data 数据内容
+ * @param length 数据长度,不超过STORAGE_RECORD_MAX_DATA_SIZE
+ * @return 1 :成功
+ * @return 0 :失败
+ */
+uint8_t storage_dev_write_record(FlashManager* dev, uint16_t type,uint32_t id, uint32_t timestamp, const uint8_t* data, uint16_t length) {
+    uint8_t buf[STORAGE_RECORD_MAX_SIZE];
+
+    if(dev->format != STORAGE_FORMAT_VAR) return 0;
+    if(length > STORAGE_RECORD_MAX_DATA_SIZE || (data == NULL && length != 0)) return 0;
+
+    /* 扇区首条记录需先写入基准时间戳 */
+    uint8_t first = (dev->current_addr == sector_base_addr(dev, dev->head_sector) + STORAGE_SECTOR_HEADER_SIZE);
+    uint32_t base_time = first ? timestamp : dev->head_base_time;
+    uint32_t size = record_encode(buf, type, id, (int32_t)(timestamp - base_time), data, length);
+
+    /* 空间检查,记录不跨扇区 */
+    uint32_t sector_end = sector_base_addr(dev, dev->head_sector) + dev->sector_size;
+    if(dev->current_addr + size + (first ? sizeof(uint32_t) : 0) > sector_end) {
+        recycle_oldest_sector(dev);
+        first = 1;
+        size = record_encode(buf, type, id, 0, data, length);
+    }
+
+    if(first) {
+        dev->head_base_time = timestamp;
+        if(!stage_write(dev, (uint8_t*)&dev->head_base_time, sizeof(uint32_t))) {
+            return 0;
+        }
+    }
+    if(!stage_write(dev, buf, size)) {
+        return 0;
+    }
+
+    dev->stats.logical_bytes += size;
+    dev->stats.records++;
+    dev->last_write_tick = HAL_GetTick();
+    update_sector_summary(dev, timestamp, size);
     return 1;
 }
 
 /**
  * @brief 读取指定地址数据
  * 
+ * @param dev 实例
  * @param addr 地址
  * @param out 
  * @return uint8_t 
  */
-uint8_t read_by_address(uint32_t addr, StorageBlock* out) {
-    if(addr < fmanager.start_addr || addr >= fmanager.end_addr) {
+uint8_t storage_dev_read_block(FlashManager* dev, uint32_t addr, StorageBlock* out) {
+    if(dev->format != STORAGE_FORMAT_FIXED) return 0;
+    if(addr < dev->start_addr || addr >= dev->end_addr) {
         return 0;
     }
-    
-    storage_driver.read(addr, (uint8_t*)out, sizeof(StorageBlock));
+
+    storage_read(dev, addr, (uint8_t*)out, sizeof(StorageBlock));
     return validate_block(out);
 }
 
+/**
+ * @brief 读取指定地址的变长记录
+ * 
+ * @param dev 实例
+ * @param addr 记录地址
+ * @param out 解析结果,out->data指向buf内
+ * @param buf 读取缓冲,长度不小于STORAGE_RECORD_MAX_SIZE
+ * @return uint8_t 1:成功 0:失败
+ */
+uint8_t storage_dev_read_record(FlashManager* dev, uint32_t addr,StorageRecord* out, uint8_t* buf) {
+    if(dev->format != STORAGE_FORMAT_VAR || out == NULL || buf == NULL) return 0;
+
+    uint32_t data_start = sector_base_addr(dev, 0) + STORAGE_VAR_SECTOR_HEADER_SIZE;
+    if(addr < data_start || addr >= dev->end_addr) return 0;
+
+    uint32_t sector = (addr - sector_base_addr(dev, 0)) / dev->sector_size;
+    if(sector >= dev->sector_num || addr < sector_data_addr(dev, sector)) return 0;
+
+    uint32_t data_end = sector_data_addr(dev, sector) + dev->sector_index[sector].used;
+    if(addr >= data_end) return 0;
+
+    uint32_t base_time;
+    uint32_t len = (data_end - addr < STORAGE_RECORD_MAX_SIZE) ? data_end - addr : STORAGE_RECORD_MAX_SIZE;
+    storage_read(dev, sector_base_addr(dev, sector) + STORAGE_SECTOR_HEADER_SIZE, (uint8_t*)&base_time, sizeof(uint32_t));
+    storage_read(dev, addr, buf, len);
+    return record_parse(buf, len, base_time, out) != 0;
+}
+
 /**
  * @brief 批量读取最新数据
+ * @note 大量数据请使用storage_dev_cursor_open以避免复制
  * 
+ * @param dev 实例
  * @param num 读取数量
  * @param out 读取数据存储区,数组长度应不小于num
  * @return uint8_t 
  */
-uint8_t read_by_new_num(uint8_t num, StorageBlock* out)
+uint8_t storage_dev_read_newest(FlashManager* dev, uint8_t num, StorageBlock* out)
 {
-    uint32_t addr = fmanager.current_addr;
+    StorageCursor cursor;
+    const StorageBlock* block;
     uint8_t count = 0;
-    while(count < num && addr > fmanager.start_addr) {
-        StorageBlock block;
-        storage_driver.read(addr, (uint8_t*)&block, sizeof(block));
-        
-        if(validate_block(&block)) {
-            memcpy(&out[count], &block, sizeof(StorageBlock));
-            count++;
-        }
-        
-        addr -= sizeof(StorageBlock);
+
+    if(!storage_dev_cursor_open(dev, &cursor, STORAGE_CURSOR_REVERSE, NULL)) return 0;
+    while(count < num && (block = storage_cursor_next(&cursor)) != NULL) {
+        memcpy(&out[count], block, sizeof(StorageBlock));
+        count++;
     }
+    storage_cursor_close(&cursor);
     return count;
 }
 
 /**
  * @brief 发现指定时间范围内的数据
+ * @note 先按扇区摘要二分查找起始扇区,再仅扫描时间范围有交集的扇区
  * 
+ * @param dev 实例
  * @param start_time 
  * @param end_time 
- * @return uint32_t 
+ * @return uint32_t 第一个满足条件的数据块地址,未找到返回STORAGE_INVALID_ADDR
  */
-uint32_t find_by_time_range(uint32_t start_time, uint32_t end_time) {
-    uint32_t addr = fmanager.start_addr;
-    while(addr < fmanager.current_addr) {
-        StorageBlock block;
-        storage_driver.read(addr, (uint8_t*)&block, sizeof(block));
-        
-        if(block.timestamp >= start_time && 
-           block.timestamp <= end_time &&
-           validate_block(&block)) {
+uint32_t storage_dev_find_by_time(FlashManager* dev, uint32_t start_time, uint32_t end_time) {
+    if(start_time > end_time) return STORAGE_INVALID_ADDR;
+
+    /* 变长记录需顺序解析,经游标扫描 */
+    if(dev->format == STORAGE_FORMAT_VAR) {
+        StorageCursor cursor;
+        StorageFilter filter = {STORAGE_FILTER_TIME, 0, 0, start_time, end_time};
+        uint32_t addr = STORAGE_INVALID_ADDR;
+
+        if(storage_dev_cursor_open(dev, &cursor, STORAGE_CURSOR_FORWARD, &filter) &&
+           storage_cursor_next_record(&cursor) != NULL) {
+            addr = cursor.record_addr;
+        }
+        storage_cursor_close(&cursor);
+        return addr;
+    }
+
+    for(uint32_t logic = sector_search_time(dev, start_time); logic < dev->sector_num; logic++) {
+        uint32_t sector = sector_logic_to_phys(dev, logic);
+        StorageSectorSummary* summary = &dev->sector_index[sector];
+
+        if(summary->count == 0) continue;
+        if(summary->min_time > end_time) {
+            if(dev->time_ordered) break;
+            continue;
+        }
+        if(summary->max_time < start_time) continue;
+
+        uint32_t addr = sector_scan_time(dev, sector, start_time, end_time);
+        if(addr != STORAGE_INVALID_ADDR) {
             return addr;
         }
-        
-        addr += sizeof(StorageBlock);
     }
-    return 0xFFFFFFFF;
+    return STORAGE_INVALID_ADDR;
+}
+
+/**
+ * @brief 获取当前写入位置
+ * 
+ * @param dev 实例
+ * @return uint32_t 
+ */
+uint32_t storage_dev_get_position(FlashManager* dev) {
+    return dev->current_addr;
+}
+
+/**
+ * @brief 获取数据扇区摘要索引
+ * 
+ * @param dev 实例
+ * @param sector 数据扇区序号
+ * @return const StorageSectorSummary* 超出范围返回NULL
+ */
+const StorageSectorSummary* storage_dev_get_sector_summary(FlashManager* dev, uint32_t sector) {
+    if(sector >= dev->sector_num) return NULL;
+    return &dev->sector_index[sector];
+}
+
+/**
+ * @brief 将暂存页与待回写的索引表写入Flash
+ * 
+ * @param dev 实例
+ * @return uint8_t 1:成功 0:失败
+ */
+uint8_t storage_dev_flush(FlashManager* dev) {
+    if(!stage_flush_page(dev)) return 0;
+    persist_meta(dev);
+    return 1;
+}
+
+/**
+ * @brief 暂存页超时写入
+ * @note 仅写入暂存页,索引表仍在切换扇区或storage_dev_flush时回写
+ * 
+ * @param dev 实例
+ */
+void storage_dev_flush_poll(FlashManager* dev) {
+    if(dev->page_fill == dev->page_flushed) return;
+
+    if(HAL_GetTick() - dev->last_write_tick >= STORAGE_FLUSH_TIMEOUT_MS) {
+        stage_flush_page(dev);
+    }
+}
+
+/**
+ * @brief 获取写入统计
+ * 
+ * @param dev 实例
+ * @param stats 统计输出
+ */
+void storage_dev_get_write_stats(FlashManager* dev, StorageWriteStats* stats) {
+    memcpy(stats, &dev->stats, sizeof(StorageWriteStats));
+}
+
+/**
+ * @brief 清零写入统计
+ * 
+ * @param dev 实例
+ */
+void storage_dev_reset_write_stats(FlashManager* dev) {
+    memset(&dev->stats, 0, sizeof(StorageWriteStats));
+}
+
+/**
+ * @brief 获取磨损统计
+ * @note max_erase - min_erase反映擦除次数分布的离散程度
+ * 
+ * @param dev 实例
+ * @param stats 统计输出
+ */
+void storage_dev_get_wear_stats(FlashManager* dev, StorageWearStats* stats) {
+    uint32_t total = 0;
+
+    memset(stats, 0, sizeof(StorageWearStats));
+    stats->min_erase = STORAGE_ERASE_COUNT_MAX;
+    for(uint32_t i = 0; i < dev->sector_num; i++) {
+        uint16_t erase = dev->sector_erase[i];
+        if(erase < stats->min_erase) {
+            stats->min_erase = erase;
+            stats->min_sector = i;
+        }
+        if(erase > stats->max_erase) {
+            stats->max_erase = erase;
+            stats->max_sector = i;
+        }
+        total += erase;
+    }
+    stats->avg_erase = (dev->sector_num > 0) ? total / dev->sector_num : 0;
+    stats->meta_generation = dev->meta_gen;
+}
+
+/**
+ * @brief 打开数据块游标
+ * @note 环形存储区已回卷时按写入顺序跨越end_addr继续遍历
+ * 
+ * @param dev 实例
+ * @param cursor 游标
+ * @param dir 遍历方向
+ * @param filter 过滤条件,不过滤传NULL
+ * @return uint8_t 1:成功 0:失败
+ */
+uint8_t storage_dev_cursor_open(FlashManager* dev, StorageCursor* cursor, StorageCursorDir dir, const StorageFilter* filter) {
+    if(dev == NULL || cursor == NULL || dev->sector_num == 0) return 0;
+
+    memset(cursor, 0, sizeof(StorageCursor));
+    cursor->dev = dev;
+    cursor->dir = dir;
+    if(filter != NULL) {
+        memcpy(&cursor->filter, filter, sizeof(StorageFilter));
+    }
+
+    /* 正向遍历可按时间直接定位起始扇区 */
+    if(dir == STORAGE_CURSOR_FORWARD) {
+        cursor->logic = (cursor->filter.flags & STORAGE_FILTER_TIME) ?
+                        sector_search_time(dev, cursor->filter.start_time) : 0;
+    } else {
+        cursor->logic = dev->sector_num - 1;
+    }
+    cursor->win_addr = STORAGE_INVALID_ADDR;
+    cursor->opened = cursor_load_sector(cursor);
+    return 1;
+}
+
+/**
+ * @brief 获取下一个满足条件的数据块
+ * 
+ * @param cursor 游标
+ * @return const StorageBlock* 指向窗口缓冲的数据块,遍历结束返回NULL
+ */
+const StorageBlock* storage_cursor_next(StorageCursor* cursor) {
+    const StorageBlock* block;
+
+    if(cursor == NULL || cursor->dev == NULL || cursor->dev->format != STORAGE_FORMAT_FIXED) return NULL;
+
+    while(cursor != NULL && cursor->opened) {
+        if(cursor->dir == STORAGE_CURSOR_FORWARD) {
+            if(cursor->addr + sizeof(StorageBlock) > cursor->sector_end) {
+                cursor->logic++;
+                cursor->opened = cursor_load_sector(cursor);
+                continue;
+            }
+            cursor->record_addr = cursor->addr;
+            block = cursor_fetch(cursor, cursor->addr);
+            cursor->addr += sizeof(StorageBlock);
+        } else {
+            if(cursor->addr < cursor->sector_start + sizeof(StorageBlock)) {
+                if(cursor->logic == 0) {
+                    cursor->opened = 0;
+                    break;
+                }
+                cursor->logic--;
+                cursor->opened = cursor_load_sector(cursor);
+                continue;
+            }
+            cursor->addr -= sizeof(StorageBlock);
+            cursor->record_addr = cursor->addr;
+            block = cursor_fetch(cursor, cursor->addr);
+        }
+
+        if(validate_block((StorageBlock*)block) &&
+           cursor_match(&cursor->filter, block->type, block->id, block->timestamp)) {
+            return block;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 获取下一条满足条件的变长记录,仅支持正向遍历
+ * @note 记录校验失败(如掉电写入不完整)时逐字节查找下一个同步字节
+ * 
+ * @param cursor 游标
+ * @return const StorageRecord* 记录数据指向窗口缓冲,遍历结束返回NULL
+ */
+const StorageRecord* storage_cursor_next_record(StorageCursor* cursor) {
+    if(cursor == NULL || cursor->dev == NULL || cursor->dev->format != STORAGE_FORMAT_VAR) return NULL;
+
+    while(cursor != NULL && cursor->opened) {
+        if(cursor->dir != STORAGE_CURSOR_FORWARD) {
+            cursor->opened = 0;
+            break;
+        }
+        if(cursor->addr >= cursor->sector_end) {
+            cursor->logic++;
+            cursor->opened = cursor_load_sector(cursor);
+            continue;
+        }
+
+        uint32_t len = cursor_window(cursor, cursor->addr);
+        uint32_t size = record_parse(&cursor->window[cursor->addr - cursor->win_addr], len,
+                                     cursor->base_time, &cursor->record);
+        if(size == 0) {
+            cursor->addr++;
+            continue;
+        }
+
+        cursor->record_addr = cursor->addr;
+        cursor->addr += size;
+        if(cursor_match(&cursor->filter, cursor->record.type, cursor->record.id, cursor->record.timestamp)) {
+            return &cursor->record;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 关闭游标
+ * 
+ * @param cursor 游标
+ */
+void storage_cursor_close(StorageCursor* cursor) {
+    if(cursor == NULL) return;
+    cursor->opened = 0;
+    cursor->win_addr = STORAGE_INVALID_ADDR;
+    cursor->win_len = 0;
+}
+
+/* 默认实例接口 */
+
+/**
+ * @brief 驱动注册
+ * 
+ * @param driver 驱动接口结构体
+ * @return void
+ */
+void storage_driver_register(StorageDriver* driver) {
+    memcpy(&storage_config.driver, driver, sizeof(StorageDriver));
+}
+
+/**
+ * @brief 设置数据块格式,需在storage_init前调用
+ * @note 与Flash中已有数据格式不一致时storage_init将重新格式化存储区
+ * 
+ * @param format 数据块格式
+ */
+void storage_set_format(StorageFormat format) {
+    storage_config.format = format;
+}
+
+/**
+ * @brief 存储初始化
+ * 
+ * @param user_start 用户指定起始地址
+ * @param user_end 用户指定结束地址
+ * @return 1
+ */
+uint8_t storage_init(uint32_t user_start, uint32_t user_end) {
+    storage_config.start_addr = user_start;
+    storage_config.end_addr = user_end;
+    storage_config.sector_size = W25QXX_SECTOR_SIZE;
+    return storage_dev_open(&fmanager, &storage_config);
+}
+
+uint8_t write_data_block(StorageBlock* block) {
+    return storage_dev_write_block(&fmanager, block);
+}
+
+uint8_t write_record(uint16_t type, uint32_t id, uint32_t timestamp, const uint8_t* data, uint16_t length) {
+    return storage_dev_write_record(&fmanager, type, id, timestamp, data, length);
+}
+
+uint8_t read_record_by_address(uint32_t addr, StorageRecord* out, uint8_t* buf) {
+    return storage_dev_read_record(&fmanager, addr, out, buf);
+}
+
+uint8_t read_by_address(uint32_t addr, StorageBlock* out) {
+    return storage_dev_read_block(&fmanager, addr, out);
+}
+
+uint8_t read_by_new_num(uint8_t num, StorageBlock* out) {
+    return storage_dev_read_newest(&fmanager, num, out);
+}
+
+uint32_t find_by_time_range(uint32_t start_time, uint32_t end_time) {
+    return storage_dev_find_by_time(&fmanager, start_time, end_time);
 }
 
 /**
@@ -163,83 +617,891 @@ uint32_t find_by_time_range(uint32_t start_time, uint32_t end_time) {
  * @param end 
  */
 void set_storage_range(uint32_t start, uint32_t end) {
-    // 地址对齐校验
-    // assert((start % W25QXX_SECTOR_SIZE) == 0);
-    // assert((end - start) >= (2 * W25QXX_SECTOR_SIZE));
-    
-    fmanager.start_addr = start;
-    fmanager.end_addr = end;
-    fmanager.current_addr = start;
+    storage_set_range(&fmanager, start, end);
+}
+
+uint32_t get_current_position(void) {
+    return storage_dev_get_position(&fmanager);
+}
+
+const StorageSectorSummary* storage_get_sector_summary(uint32_t sector) {
+    return storage_dev_get_sector_summary(&fmanager, sector);
+}
+
+uint8_t storage_flush(void) {
+    return storage_dev_flush(&fmanager);
 }
 
 /**
- * @brief 获取当前写入位置
- * 
- * @return uint32_t 
+ * @brief 全部已注册实例的暂存页超时写入,需在主循环中周期调用
  */
-uint32_t get_current_position(void) {
-    return fmanager.current_addr;
+void storage_flush_poll(void) {
+    for(FlashManager* dev = storage_dev_list; dev != NULL; dev = dev->next) {
+        storage_dev_flush_poll(dev);
+    }
+}
+
+void storage_get_write_stats(StorageWriteStats* stats) {
+    storage_dev_get_write_stats(&fmanager, stats);
+}
+
+void storage_reset_write_stats(void) {
+    storage_dev_reset_write_stats(&fmanager);
+}
+
+void storage_get_wear_stats(StorageWearStats* stats) {
+    storage_dev_get_wear_stats(&fmanager, stats);
+}
+
+uint8_t storage_cursor_open(StorageCursor* cursor, StorageCursorDir dir, const StorageFilter* filter) {
+    return storage_dev_cursor_open(&fmanager, cursor, dir, filter);
 }
 
 /* 私有函数实现 */
 
-static void format_storage_area(void) {
-    /* 擦除起始扇区 */
-    storage_driver.erase_sector(fmanager.start_addr);
-    
-    /* 写入初始标记 */
-    uint8_t header[2] = {0xA5, 0x5A};
-    storage_driver.write(fmanager.start_addr, header, 2);
-    
-    fmanager.current_addr = fmanager.start_addr + 2;
-    fmanager.oldest_sector = fmanager.start_addr;
-}
-
-static void update_sector_usage(void) {
-    uint32_t sector = fmanager.current_addr / W25QXX_SECTOR_SIZE;
-    fmanager.sector_usage[sector]++;
-    
-    if(fmanager.sector_usage[sector] >= 0xFF) {
-        recycle_oldest_sector();
-    }
-    
-    storage_driver.write(fmanager.start_addr + 2, 
-                       (uint8_t*)&fmanager.sector_usage, 
-                       sizeof(fmanager.sector_usage));
-}
-
-static void recycle_oldest_sector(void) {
-    uint32_t oldest = find_oldest_sector();
-    
+static void format_storage_area(FlashManager* dev) {
+    /* 环形起点选择擦除次数最少的扇区 */
+    uint32_t start = 0;
+    for(uint32_t i = 1; i < dev->sector_num; i++) {
+        if(dev->sector_erase[i] < dev->sector_erase[start]) {
+            start = i;
+        }
+    }
+
+    /* 其余扇区不擦除,序列号接续残留扇区头的最大值,使残留扇区头均小于新的基准 */
+    uint32_t seq_max = dev->head_seq;
+    dev->seq_base = 0;
+    for(uint32_t i = 0; i < dev->sector_num; i++) {
+        uint32_t seq = sector_read_seq(dev, i);
+        if(seq != STORAGE_SEQ_INVALID && (int32_t)(seq - seq_max) > 0) {
+            seq_max = seq;
+        }
+    }
+
+    memset(dev->sector_index, 0, dev->sector_num * sizeof(StorageSectorSummary));
+    dev->ring_start = start;
+    dev->head_sector = start;
+    dev->head_seq = seq_max + 1;
+    dev->seq_base = dev->head_seq;
+    dev->current_addr = sector_base_addr(dev, start);
+    dev->oldest_sector = sector_base_addr(dev, sector_logic_to_phys(dev, 0));
+
+    sector_time_check(dev);
+
+    /* 擦除首个数据扇区后写入完整索引表 */
+    sector_erase_count(dev, start);
+    meta_compact(dev);
+    stage_sector_header(dev);
+}
+
+static void update_sector_summary(FlashManager* dev, uint32_t timestamp, uint32_t size) {
+    uint32_t sector = dev->head_sector;
+    StorageSectorSummary* summary = &dev->sector_index[sector];
+
+    if(summary->count == 0 || timestamp < summary->min_time) {
+        summary->min_time = timestamp;
+    }
+    if(summary->count == 0 || timestamp > summary->max_time) {
+        summary->max_time = timestamp;
+    }
+    summary->count++;
+    summary->used += size;
+
+    /* 时间戳倒退(如RTC回拨)后摘要不再有序,时间查询改为逐扇区扫描 */
+    if(timestamp < dev->last_time) {
+        dev->time_ordered = 0;
+    } else {
+        dev->last_time = timestamp;
+    }
+
+    /* 延迟至切换扇区或storage_flush时回写 */
+    mark_meta_dirty(dev, sector);
+}
+
+static void recycle_oldest_sector(FlashManager* dev) {
+    /* 环形切换至下一扇区,即最旧扇区 */
+    uint32_t oldest = sector_logic_to_phys(dev, 0);
+    uint32_t addr = sector_base_addr(dev, oldest);
+
+    /* 写完当前扇区剩余暂存数据 */
+    stage_flush_page(dev);
+
     /* 擦除旧扇区 */
-    storage_driver.erase_sector(oldest);
-    
+    sector_erase_count(dev, oldest);
+
     /* 更新管理信息 */
-    fmanager.oldest_sector = find_oldest_sector();
-    fmanager.current_addr = oldest;
-    
+    dev->head_sector = oldest;
+    dev->head_seq++;
+    dev->current_addr = addr;
+    dev->oldest_sector = sector_base_addr(dev, sector_logic_to_phys(dev, 0));
+    memset(&dev->sector_index[oldest], 0, sizeof(StorageSectorSummary));
+    mark_meta_dirty(dev, oldest);
+    persist_meta(dev);
+    if(!dev->time_ordered) {
+        sector_time_check(dev);//倒退的数据被回收后恢复二分查找
+    }
+
     /* 写入新扇区标记 */
-    uint8_t header[2] = {0xA5, 0x5A};
-    storage_driver.write(oldest, header, 2);
+    stage_sector_header(dev);
 }
 
 static uint8_t validate_block(StorageBlock* block) {
     uint8_t calc_crc = crc8((uint8_t*)block, sizeof(StorageBlock)-1);
-    return (block->crc == calc_crc) && 
-           (block->timestamp > 1600000000);
+    return (block->crc == calc_crc) &&
+           (block->timestamp > 1600000000) &&
+           (block->timestamp < 0xFF000000);//掉电时时间戳未写完(高字节仍为0xFF)而crc恰为0xFF
+}
+
+static uint32_t sector_base_addr(FlashManager* dev, uint32_t sector) {
+    return dev->start_addr + (sector + STORAGE_META_SECTOR_NUM) * dev->sector_size;
+}
+
+static uint32_t sector_data_addr(FlashManager* dev, uint32_t sector) {
+    return sector_base_addr(dev, sector) + ((dev->format == STORAGE_FORMAT_VAR) ?
+           STORAGE_VAR_SECTOR_HEADER_SIZE : STORAGE_SECTOR_HEADER_SIZE);
+}
+
+/**
+ * @brief 环形逻辑序号转数据扇区序号
+ * @note 逻辑序号0为写入扇区的下一扇区(最旧),sector_num-1为写入扇区(最新)
+ */
+static uint32_t sector_logic_to_phys(FlashManager* dev, uint32_t logic) {
+    return (dev->head_sector + 1 + logic) % dev->sector_num;
+}
+
+static uint32_t sector_read_seq(FlashManager* dev, uint32_t sector) {
+    uint8_t header[STORAGE_SECTOR_HEADER_SIZE];
+    uint32_t seq;
+
+    dev->driver.read(sector_base_addr(dev, sector), header, STORAGE_SECTOR_HEADER_SIZE);
+    if(header[0] != 0xA5 || header[1] != 0x5A) return STORAGE_SEQ_INVALID;
+    memcpy(&seq, &header[2], sizeof(uint32_t));
+    if(seq == STORAGE_SEQ_INVALID || (int32_t)(seq - dev->seq_base) < 0) return STORAGE_SEQ_INVALID;//格式化前的残留
+    return seq;
+}
+
+static void stage_sector_header(FlashManager* dev) {
+    uint8_t header[STORAGE_SECTOR_HEADER_SIZE] = {0xA5, 0x5A};
+    memcpy(&header[2], &dev->head_seq, sizeof(uint32_t));
+    stage_write(dev, header, STORAGE_SECTOR_HEADER_SIZE);
+}
+
+/**
+ * @brief 二分查找序列号最大的扇区
+ * @note 环形写入使环形起点起序列号不小于起点扇区的扇区连续排列,其后为旧数据或擦除扇区,
+ *       读取O(log sector_num)个扇区头即可定位
+ * @return uint32_t 写入扇区序号,无有效扇区返回STORAGE_INVALID_ADDR
+ */
+static uint32_t recover_head_sector(FlashManager* dev) {
+    uint32_t num = dev->sector_num;
+    uint32_t start = dev->ring_start % num;
+    uint32_t last = num - 1;
+    uint32_t seq0 = sector_read_seq(dev, start);
+
+    if(seq0 == STORAGE_SEQ_INVALID) {
+        /* 起点扇区在回收时擦除后掉电,此时写入扇区为起点前一个扇区 */
+        seq0 = (last > 0) ? sector_read_seq(dev, (start + last) % num) : STORAGE_SEQ_INVALID;
+        if(seq0 == STORAGE_SEQ_INVALID) return STORAGE_INVALID_ADDR;
+        dev->head_seq = seq0;
+        return (start + last) % num;
+    }
+
+    uint32_t low = 0;
+    uint32_t high = last;
+    dev->head_seq = seq0;
+    while(low < high) {
+        uint32_t mid = low + (high - low + 1) / 2;
+        uint32_t seq = sector_read_seq(dev, (start + mid) % num);
+        if(seq != STORAGE_SEQ_INVALID && (int32_t)(seq - seq0) >= 0) {
+            low = mid;
+            dev->head_seq = seq;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return (start + low) % num;
+}
+
+/**
+ * @brief 恢复写入扇区状态
+ * @note 索引表可能落后于Flash内容,以索引记录的位置为下界二分查找擦除区,
+ *       只重新解析下界之后的数据更新摘要
+ */
+static void recover_head_data(FlashManager* dev) {
+    uint32_t head = dev->head_sector;
+    StorageSectorSummary* summary = &dev->sector_index[head];
+    uint32_t data_addr = sector_data_addr(dev, head);
+    uint32_t capacity = sector_base_addr(dev, head) + dev->sector_size - data_addr;
+
+    /* 回收下一扇区时擦除后掉电,其索引项未及清除 */
+    uint32_t next = sector_logic_to_phys(dev, 0);
+    if(next != head && sector_read_seq(dev, next) == STORAGE_SEQ_INVALID) {
+        memset(&dev->sector_index[next], 0, sizeof(StorageSectorSummary));
+        mark_meta_dirty(dev, next);
+    }
+
+    if(summary->used > capacity) {
+        memset(summary, 0, sizeof(StorageSectorSummary));
+    }
+    uint32_t scan_start = summary->used;
+
+    if(dev->format == STORAGE_FORMAT_FIXED) {
+        /* 以数据块为单位二分查找第一个擦除块 */
+        uint32_t low = summary->used / sizeof(StorageBlock);
+        uint32_t high = capacity / sizeof(StorageBlock);
+        while(low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if(region_erased(dev, data_addr + mid * sizeof(StorageBlock), sizeof(StorageBlock))) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+        }
+
+        /* 掉电时未写完的数据块同样计入已用空间,遍历时由校验跳过 */
+        for(uint32_t i = scan_start / sizeof(StorageBlock); i < low; i++) {
+            StorageBlock block;
+            dev->driver.read(data_addr + i * sizeof(StorageBlock), (uint8_t*)&block, sizeof(StorageBlock));
+            if(validate_block(&block)) {
+                update_sector_summary(dev, block.timestamp, sizeof(StorageBlock));
+            } else {
+                summary->used += sizeof(StorageBlock);
+                mark_meta_dirty(dev, head);
+            }
+        }
+        dev->current_addr = data_addr + summary->used;
+        return;
+    }
+
+    /* 变长格式: 基准时间戳未写入时扇区内无记录 */
+    uint32_t base_time;
+    dev->driver.read(sector_base_addr(dev, head) + STORAGE_SECTOR_HEADER_SIZE, (uint8_t*)&base_time, sizeof(uint32_t));
+    if(base_time == 0xFFFFFFFF) {
+        memset(summary, 0, sizeof(StorageSectorSummary));
+        dev->current_addr = sector_base_addr(dev, head) + STORAGE_SECTOR_HEADER_SIZE;
+        return;
+    }
+    dev->head_base_time = base_time;
+
+    /* 以探测长度为单位二分查找擦除区 */
+    uint32_t low = scan_start / STORAGE_RECOVER_PROBE;
+    uint32_t high = capacity / STORAGE_RECOVER_PROBE;
+    while(low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if(region_erased(dev, data_addr + mid * STORAGE_RECOVER_PROBE, STORAGE_RECOVER_PROBE)) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    uint32_t erased = low * STORAGE_RECOVER_PROBE;
+
+    /* 沿记录链解析,数据中连续0xFF可能使二分结果偏前,以解析结果为准 */
+    uint8_t buf[STORAGE_RECORD_MAX_SIZE];
+    uint32_t pos = scan_start;
+    while(pos < capacity) {
+        StorageRecord record;
+        uint32_t len = (capacity - pos < STORAGE_RECORD_MAX_SIZE) ? capacity - pos : STORAGE_RECORD_MAX_SIZE;
+        dev->driver.read(data_addr + pos, buf, len);
+        uint32_t size = record_parse(buf, len, base_time, &record);
+        if(size == 0) {
+            /* 未写完的记录已写入长度字节时跳过其完整长度,避免新记录落入其范围后被误当作其数据通过校验 */
+            if(len >= 2 && buf[0] == STORAGE_RECORD_SYNC && buf[1] != 0xFF && pos + buf[1] + 2 <= capacity && erased < pos + buf[1] + 2) {
+                erased = pos + buf[1] + 2;
+            }
+            break;
+        }
+        update_sector_summary(dev, record.timestamp, size);
+        pos += size;
+    }
+
+    /* 跳过掉电时未写完的记录 */
+    if(erased < pos) erased = pos;
+    while(erased < capacity) {
+        uint32_t len = (capacity - erased < STORAGE_RECOVER_PROBE) ? capacity - erased : STORAGE_RECOVER_PROBE;
+        if(region_erased(dev, data_addr + erased, len)) break;
+        erased += len;
+    }
+    if(erased > summary->used) {
+        summary->used = erased;
+        mark_meta_dirty(dev, head);
+    }
+    dev->current_addr = data_addr + summary->used;
+}
+
+static uint8_t region_erased(FlashManager* dev, uint32_t addr, uint32_t len) {
+    uint8_t buf[STORAGE_RECOVER_PROBE];
+
+    while(len > 0) {
+        uint32_t chunk = (len < sizeof(buf)) ? len : sizeof(buf);
+        dev->driver.read(addr, buf, chunk);
+        for(uint32_t i = 0; i < chunk; i++) {
+            if(buf[i] != 0xFF) return 0;
+        }
+        addr += chunk;
+        len -= chunk;
+    }
+    return 1;
+}
+
+/**
+ * @brief 检查各扇区摘要是否按环形顺序时间不减,并更新已写入数据的最大时间戳
+ */
+static void sector_time_check(FlashManager* dev) {
+    dev->time_ordered = 1;
+    dev->last_time = 0;
+    for(uint32_t logic = 0; logic < dev->sector_num; logic++) {
+        StorageSectorSummary* summary = &dev->sector_index[sector_logic_to_phys(dev, logic)];
+
+        if(summary->count == 0) continue;
+        if(summary->min_time < dev->last_time) {
+            dev->time_ordered = 0;
+        }
+        if(summary->max_time > dev->last_time) {
+            dev->last_time = summary->max_time;
+        }
+    }
+}
+
+/**
+ * @brief 按环形顺序二分查找第一个最大时间戳不小于start_time的扇区
+ * @note 空扇区不仅位于环形顺序的开头,写入扇区刚切换或掉电后只剩未写完的数据块时也为空,
+ *       空扇区按其后第一个非空扇区判断,其后均为空时视为不早于start_time
+ * @note 时间戳曾倒退时返回0,由调用者逐扇区扫描
+ * @return uint32_t 逻辑序号,全部早于start_time时返回sector_num
+ */
+static uint32_t sector_search_time(FlashManager* dev, uint32_t start_time) {
+    uint32_t low = 0;
+    uint32_t high = dev->sector_num;
+
+    if(!dev->time_ordered) return 0;
+    while(low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        uint32_t probe = mid;
+        while(probe < high && dev->sector_index[sector_logic_to_phys(dev, probe)].count == 0) {
+            probe++;
+        }
+        if(probe == high) {
+            high = mid;
+        } else if(dev->sector_index[sector_logic_to_phys(dev, probe)].max_time < start_time) {
+            low = probe + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief 扫描单个数据扇区,查找时间范围内的第一个数据块
+ */
+static uint32_t sector_scan_time(FlashManager* dev, uint32_t sector, uint32_t start_time, uint32_t end_time) {
+    StorageBlock blocks[STORAGE_READ_BATCH];
+    uint32_t addr = sector_data_addr(dev, sector);
+    uint32_t remain = dev->sector_index[sector].used / sizeof(StorageBlock);
+
+    while(remain > 0) {
+        uint32_t num = (remain > STORAGE_READ_BATCH) ? STORAGE_READ_BATCH : remain;
+        storage_read(dev, addr, (uint8_t*)blocks, num * sizeof(StorageBlock));
+        for(uint32_t i = 0; i < num; i++) {
+            if(blocks[i].timestamp >= start_time &&
+               blocks[i].timestamp <= end_time &&
+               validate_block(&blocks[i])) {
+                return addr + i * sizeof(StorageBlock);
+            }
+        }
+        addr += num * sizeof(StorageBlock);
+        remain -= num;
+    }
+    return STORAGE_INVALID_ADDR;
+}
+
+static uint8_t storage_read(FlashManager* dev, uint32_t addr, uint8_t* buf, uint32_t len) {
+    uint8_t ret = dev->driver.read(addr, buf, len);
+
+    /* 覆盖尚未写入Flash的暂存数据 */
+    if(dev->page_fill > dev->page_flushed) {
+        uint32_t stage_start = dev->page_addr + dev->page_flushed;
+        uint32_t stage_end = dev->page_addr + dev->page_fill;
+        uint32_t start = (addr > stage_start) ? addr : stage_start;
+        uint32_t end = (addr + len < stage_end) ? addr + len : stage_end;
+        if(start < end) {
+            memcpy(buf + (start - addr), &dev->page_buf[start - dev->page_addr], end - start);
+        }
+    }
+    return ret;
+}
+
+static uint8_t storage_program(FlashManager* dev, uint32_t addr, uint8_t* buf, uint32_t len) {
+    dev->stats.flash_bytes += len;
+    dev->stats.page_writes++;
+    return dev->driver.write(addr, buf, len);
+}
+
+static uint8_t storage_erase_sector(FlashManager* dev, uint32_t addr) {
+    dev->stats.sector_erases++;
+    return dev->driver.erase_sector(addr);
+}
+
+/**
+ * @brief 将数据写入暂存页,并推进current_addr
+ * @note 暂存页写满后立即写入Flash,数据可跨页但不跨扇区
+ */
+static uint8_t stage_write(FlashManager* dev, uint8_t* buf, uint32_t len) {
+    while(len > 0) {
+        uint32_t page_addr = dev->current_addr & ~(uint32_t)(STORAGE_PAGE_SIZE - 1);
+        if(page_addr != dev->page_addr) {
+            if(!stage_flush_page(dev)) return 0;
+            dev->page_addr = page_addr;
+            dev->page_fill = dev->current_addr - page_addr;
+            dev->page_flushed = dev->page_fill;
+        }
+
+        if(dev->page_buf == NULL) {
+            dev->page_buf = page_pool_acquire(dev);
+        }
+
+        uint32_t num = STORAGE_PAGE_SIZE - dev->page_fill;
+        if(num > len) num = len;
+        memcpy(&dev->page_buf[dev->page_fill], buf, num);
+        dev->page_fill += num;
+        dev->current_addr += num;
+        buf += num;
+        len -= num;
+
+        if(dev->page_fill == STORAGE_PAGE_SIZE && !stage_flush_page(dev)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 将暂存页中未写入的部分写入Flash,页已写满时释放暂存页
+ */
+static uint8_t stage_flush_page(FlashManager* dev) {
+    if(dev->page_fill > dev->page_flushed) {
+        if(!storage_program(dev, dev->page_addr + dev->page_flushed,
+                            &dev->page_buf[dev->page_flushed],
+                            dev->page_fill - dev->page_flushed)) {
+            return 0;
+        }
+        dev->page_flushed = dev->page_fill;
+    }
+
+    if(dev->page_fill == STORAGE_PAGE_SIZE) {
+        dev->page_addr = STORAGE_INVALID_ADDR;
+        dev->page_fill = 0;
+        dev->page_flushed = 0;
+        page_pool_release(dev);
+    }
+    return 1;
+}
+
+static void mark_meta_dirty(FlashManager* dev, uint32_t sector) {
+    dev->meta_dirty[sector / 32] |= (1UL << (sector % 32));
+}
+
+/**
+ * @brief 被标记的擦除计数与摘要索引表项以日志追加写入
+ * @note 仅写入擦除状态的空间,管理扇区只在日志写满时擦除
+ */
+static void persist_meta(FlashManager* dev) {
+    for(uint32_t i = 0; i < STORAGE_MAX_SECTOR_NUM / 32; i++) {
+        while(dev->meta_dirty[i]) {
+            uint32_t bit = 0;
+            while(!(dev->meta_dirty[i] & (1UL << bit))) bit++;
+
+            /* 日志写满,完整表格写入另一管理扇区,同时清除全部标记 */
+            uint32_t meta_end = meta_base_addr(dev, dev->meta_sector) + dev->sector_size;
+            if(dev->journal_addr + sizeof(StorageMetaEntry) > meta_end) {
+                meta_compact(dev);
+                return;
+            }
+            dev->meta_dirty[i] &= ~(1UL << bit);
+
+            StorageMetaEntry entry;
+            uint32_t sector = i * 32 + bit;
+            entry.tag = STORAGE_META_JOURNAL_TAG;
+            entry.sector = (uint8_t)sector;
+            entry.erase_count = dev->sector_erase[sector];
+            memcpy(&entry.summary, &dev->sector_index[sector], sizeof(StorageSectorSummary));
+            entry.crc = crc8((uint8_t*)&entry, sizeof(StorageMetaEntry) - 1);
+            storage_program(dev, dev->journal_addr, (uint8_t*)&entry, sizeof(StorageMetaEntry));
+            dev->journal_addr += sizeof(StorageMetaEntry);
+        }
+    }
+}
+
+static uint32_t meta_base_addr(FlashManager* dev, uint32_t meta) {
+    return dev->start_addr + meta * dev->sector_size;
+}
+
+/**
+ * @brief 读取代数较新的有效管理扇区并重放索引日志
+ * @return uint8_t 1:成功 0:无有效管理扇区或格式不一致,需格式化
+ */
+static uint8_t meta_load(FlashManager* dev) {
+    uint8_t header[STORAGE_META_HEADER_SIZE];
+    uint8_t found = 0;
+    uint8_t format = 0;
+    uint16_t ring_start = 0;
+    uint16_t sector_num = 0;
+    uint32_t seq_base = 0;
+
+    for(uint32_t i = 0; i < STORAGE_META_SECTOR_NUM; i++) {
+        uint32_t gen;
+        dev->driver.read(meta_base_addr(dev, i), header, STORAGE_META_HEADER_SIZE);
+        if(header[0] != 0xA5 || header[1] != 0x5A) continue;
+
+        memcpy(&gen, &header[5], sizeof(uint32_t));
+        if(!found || (int32_t)(gen - dev->meta_gen) > 0) {
+            found = 1;
+            format = header[2];
+            memcpy(&ring_start, &header[3], sizeof(uint16_t));
+            memcpy(&sector_num, &header[9], sizeof(uint16_t));
+            memcpy(&seq_base, &header[11], sizeof(uint32_t));
+            dev->meta_sector = i;
+            dev->meta_gen = gen;
+        }
+    }
+    if(!found) return 0;
+
+    /* 扇区数变化时保留重叠部分的擦除计数 */
+    uint32_t base = meta_base_addr(dev, dev->meta_sector);
+    uint32_t erase_num = (sector_num < dev->sector_num) ? sector_num : dev->sector_num;
+    dev->driver.read(base + STORAGE_ERASE_OFFSET, (uint8_t*)dev->sector_erase, erase_num * sizeof(uint16_t));
+    for(uint32_t i = 0; i < erase_num; i++) {
+        if(dev->sector_erase[i] > STORAGE_ERASE_COUNT_MAX) {
+            dev->sector_erase[i] = 0;
+        }
+    }
+    if(format != dev->format || sector_num != dev->sector_num) return 0;
+
+    dev->ring_start = ring_start;
+    dev->seq_base = seq_base;
+    dev->driver.read(base + STORAGE_INDEX_OFFSET(dev),
+                     (uint8_t*)dev->sector_index, dev->sector_num * sizeof(StorageSectorSummary));
+
+    /* 重放日志,掉电写坏的日志项由校验跳过 */
+    uint32_t addr = base + STORAGE_JOURNAL_OFFSET(dev);
+    while(addr + sizeof(StorageMetaEntry) <= base + dev->sector_size) {
+        StorageMetaEntry entry;
+        dev->driver.read(addr, (uint8_t*)&entry, sizeof(StorageMetaEntry));
+        if(entry.tag == 0xFF) break;
+
+        addr += sizeof(StorageMetaEntry);
+        if(entry.tag != STORAGE_META_JOURNAL_TAG ||
+           entry.crc != crc8((uint8_t*)&entry, sizeof(StorageMetaEntry) - 1) ||
+           entry.sector >= dev->sector_num) {
+            continue;
+        }
+        dev->sector_erase[entry.sector] = entry.erase_count;
+        memcpy(&dev->sector_index[entry.sector], &entry.summary, sizeof(StorageSectorSummary));
+    }
+    dev->journal_addr = addr;
+
+    for(uint32_t i = 0; i < dev->sector_num; i++) {
+        StorageSectorSummary* summary = &dev->sector_index[i];
+        if(summary->count == 0xFFFF) {
+            memset(summary, 0, sizeof(StorageSectorSummary));
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 完整表格写入另一管理扇区,扇区头最后写入,写入中途掉电时仍使用原管理扇区
+ */
+static void meta_compact(FlashManager* dev) {
+    uint32_t target = dev->meta_sector ^ 1;
+    uint32_t base = meta_base_addr(dev, target);
+    uint8_t header[STORAGE_META_HEADER_SIZE] = {0xA5, 0x5A, (uint8_t)dev->format};
+    uint16_t ring_start = (uint16_t)dev->ring_start;
+    uint16_t sector_num = (uint16_t)dev->sector_num;
+
+    dev->meta_gen++;
+    memcpy(&header[3], &ring_start, sizeof(uint16_t));
+    memcpy(&header[5], &dev->meta_gen, sizeof(uint32_t));
+    memcpy(&header[9], &sector_num, sizeof(uint16_t));
+    memcpy(&header[11], &dev->seq_base, sizeof(uint32_t));
+
+    storage_erase_sector(dev, base);
+    storage_program(dev, base + STORAGE_ERASE_OFFSET,
+                    (uint8_t*)dev->sector_erase, dev->sector_num * sizeof(uint16_t));
+    storage_program(dev, base + STORAGE_INDEX_OFFSET(dev),
+                    (uint8_t*)dev->sector_index, dev->sector_num * sizeof(StorageSectorSummary));
+    storage_program(dev, base, header, STORAGE_META_HEADER_SIZE);
+
+    dev->meta_sector = target;
+    dev->journal_addr = base + STORAGE_JOURNAL_OFFSET(dev);
+    memset(dev->meta_dirty, 0, sizeof(dev->meta_dirty));
 }
 
-static uint32_t find_oldest_sector(void) {
-    uint32_t oldest = fmanager.start_addr;
-    for(uint32_t i = 0; i < 256; i++) {
-        if(fmanager.sector_usage[i] == 0) {
-            oldest = fmanager.start_addr + i * W25QXX_SECTOR_SIZE;
+/**
+ * @brief 设置存储范围,计算数据扇区数量
+ * 
+ * @param start 
+ * @param end 
+ */
+static void storage_set_range(FlashManager* dev, uint32_t start, uint32_t end) {
+    // 地址对齐校验
+    // assert((start % dev->sector_size) == 0);
+    // assert((end - start) >= (2 * dev->sector_size));
+
+    dev->start_addr = start;
+    dev->end_addr = end;
+    dev->current_addr = start;
+
+    /* 前两个扇区为管理扇区,其余为数据扇区 */
+    uint32_t sector_num = (end > start && dev->sector_size > 0) ? (end - start) / dev->sector_size : 0;
+    sector_num = (sector_num > STORAGE_META_SECTOR_NUM) ? sector_num - STORAGE_META_SECTOR_NUM : 0;
+    if(sector_num > STORAGE_MAX_SECTOR_NUM) {
+        sector_num = STORAGE_MAX_SECTOR_NUM;
+    }
+    if(sector_num > dev->table_num) {
+        sector_num = dev->table_num;
+    }
+
+    /* 管理扇区需容纳两张表及最少日志项 */
+    uint32_t meta_max = (dev->sector_size > STORAGE_META_HEADER_SIZE + STORAGE_META_JOURNAL_MIN * sizeof(StorageMetaEntry)) ?
+                        (dev->sector_size - STORAGE_META_HEADER_SIZE - STORAGE_META_JOURNAL_MIN * sizeof(StorageMetaEntry)) /
+                        (sizeof(uint16_t) + sizeof(StorageSectorSummary)) : 0;
+    if(sector_num > meta_max) {
+        sector_num = meta_max;
+    }
+    dev->sector_num = sector_num;
+}
+
+static uint8_t* page_pool_acquire(FlashManager* dev) {
+    uint32_t victim = 0;
+
+    for(uint32_t i = 0; i < STORAGE_PAGE_POOL_NUM; i++) {
+        if(storage_page_owner[i] == NULL) {
+            storage_page_owner[i] = dev;
+            return storage_page_pool[i];
+        }
+        if(storage_page_owner[i]->last_write_tick < storage_page_owner[victim]->last_write_tick) {
+            victim = i;
+        }
+    }
+
+    /* 缓冲池已满,写出最久未写入实例的暂存数据后接管其暂存页 */
+    FlashManager* owner = storage_page_owner[victim];
+    stage_flush_page(owner);
+    owner->page_buf = NULL;
+    storage_page_owner[victim] = dev;
+    return storage_page_pool[victim];
+}
+
+static void page_pool_release(FlashManager* dev) {
+    for(uint32_t i = 0; i < STORAGE_PAGE_POOL_NUM; i++) {
+        if(storage_page_owner[i] == dev) {
+            storage_page_owner[i] = NULL;
+        }
+    }
+    dev->page_buf = NULL;
+}
+
+static void storage_dev_unlink(FlashManager* dev) {
+    FlashManager** node = &storage_dev_list;
+
+    while(*node != NULL) {
+        if(*node == dev) {
+            *node = dev->next;
             break;
         }
-        
-        if(fmanager.sector_usage[i] < fmanager.sector_usage[oldest]) {
-            oldest = fmanager.start_addr + i * W25QXX_SECTOR_SIZE;
+        node = &(*node)->next;
+    }
+}
+
+static void sector_erase_count(FlashManager* dev, uint32_t sector) {
+    storage_erase_sector(dev, sector_base_addr(dev, sector));
+    if(dev->sector_erase[sector] < STORAGE_ERASE_COUNT_MAX) {
+        dev->sector_erase[sector]++;
+    }
+    mark_meta_dirty(dev, sector);
+}
+
+/**
+ * @brief 从cursor->logic开始按遍历方向查找第一个可能含有匹配数据的扇区
+ * @return uint8_t 1:找到 0:遍历结束
+ */
+static uint8_t cursor_load_sector(StorageCursor* cursor) {
+    FlashManager* dev = cursor->dev;
+    uint8_t time_filter = cursor->filter.flags & STORAGE_FILTER_TIME;
+
+    while(cursor->logic < dev->sector_num) {
+        uint32_t sector = sector_logic_to_phys(dev, cursor->logic);
+        StorageSectorSummary* summary = &dev->sector_index[sector];
+
+        if(summary->count != 0) {
+            if(!time_filter ||
+               (summary->max_time >= cursor->filter.start_time &&
+                summary->min_time <= cursor->filter.end_time)) {
+                cursor->sector_start = sector_data_addr(dev, sector);
+                cursor->sector_end = cursor->sector_start + summary->used;
+                cursor->addr = (cursor->dir == STORAGE_CURSOR_FORWARD) ?
+                               cursor->sector_start : cursor->sector_end;
+                if(dev->format == STORAGE_FORMAT_VAR) {
+                    storage_read(dev, sector_base_addr(dev, sector) + STORAGE_SECTOR_HEADER_SIZE,
+                                 (uint8_t*)&cursor->base_time, sizeof(uint32_t));
+                }
+                return 1;
+            }
+
+            /* 时间随写入顺序不减,越过查询范围后无需继续 */
+            if(time_filter && dev->time_ordered && cursor->dir == STORAGE_CURSOR_FORWARD &&
+               summary->min_time > cursor->filter.end_time) {
+                return 0;
+            }
+            if(time_filter && dev->time_ordered && cursor->dir == STORAGE_CURSOR_REVERSE &&
+               summary->max_time < cursor->filter.start_time) {
+                return 0;
+            }
+        }
+
+        if(cursor->dir == STORAGE_CURSOR_FORWARD) {
+            cursor->logic++;
+        } else {
+            if(cursor->logic == 0) break;
+            cursor->logic--;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 返回addr处数据块在窗口中的位置,不在窗口内时按遍历方向整窗读取
+ */
+static const StorageBlock* cursor_fetch(StorageCursor* cursor, uint32_t addr) {
+    FlashManager* dev = cursor->dev;
+    if(cursor->win_addr == STORAGE_INVALID_ADDR ||
+       addr < cursor->win_addr ||
+       addr + sizeof(StorageBlock) > cursor->win_addr + cursor->win_len) {
+        uint32_t win_size = (STORAGE_CURSOR_WINDOW_SIZE / sizeof(StorageBlock)) * sizeof(StorageBlock);
+
+        if(cursor->dir == STORAGE_CURSOR_FORWARD) {
+            cursor->win_addr = addr;
+            cursor->win_len = (cursor->sector_end - addr < win_size) ? cursor->sector_end - addr : win_size;
+        } else {
+            uint32_t end = addr + sizeof(StorageBlock);
+            cursor->win_addr = (end - cursor->sector_start < win_size) ? cursor->sector_start : end - win_size;
+            cursor->win_len = end - cursor->win_addr;
+        }
+        storage_read(dev, cursor->win_addr, cursor->window, cursor->win_len);
+    }
+    return (const StorageBlock*)&cursor->window[addr - cursor->win_addr];
+}
+
+/**
+ * @brief 确保窗口覆盖addr起始的一条最长记录,返回窗口内addr之后的有效长度
+ */
+static uint32_t cursor_window(StorageCursor* cursor, uint32_t addr) {
+    FlashManager* dev = cursor->dev;
+    uint32_t remain = cursor->sector_end - addr;
+    uint32_t need = (remain < STORAGE_RECORD_MAX_SIZE) ? remain : STORAGE_RECORD_MAX_SIZE;
+
+    if(cursor->win_addr == STORAGE_INVALID_ADDR ||
+       addr < cursor->win_addr ||
+       addr + need > cursor->win_addr + cursor->win_len) {
+        cursor->win_addr = addr;
+        cursor->win_len = (remain < STORAGE_CURSOR_WINDOW_SIZE) ? remain : STORAGE_CURSOR_WINDOW_SIZE;
+        storage_read(dev, cursor->win_addr, cursor->window, cursor->win_len);
+    }
+    return cursor->win_addr + cursor->win_len - addr;
+}
+
+static uint8_t cursor_match(const StorageFilter* filter, uint16_t type, uint32_t id, uint32_t timestamp) {
+    if((filter->flags & STORAGE_FILTER_TIME) &&
+       (timestamp < filter->start_time || timestamp > filter->end_time)) {
+        return 0;
+    }
+    if((filter->flags & STORAGE_FILTER_TYPE) && type != filter->type) {
+        return 0;
+    }
+    if((filter->flags & STORAGE_FILTER_ID) && id != filter->id) {
+        return 0;
+    }
+    return 1;
+}
+
+static uint8_t varint_encode(uint8_t* buf, uint32_t value) {
+    uint8_t len = 0;
+    while(value >= 0x80) {
+        buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[len++] = (uint8_t)value;
+    return len;
+}
+
+/**
+ * @return uint8_t 已解析字节数,数据不完整或超过5字节返回0
+ */
+static uint8_t varint_decode(const uint8_t* buf, uint32_t len, uint32_t* value) {
+    uint32_t result = 0;
+    for(uint8_t i = 0; i < 5 && i < len; i++) {
+        result |= (uint32_t)(buf[i] & 0x7F) << (7 * i);
+        if(!(buf[i] & 0x80)) {
+            *value = result;
+            return i + 1;
         }
     }
-    return oldest;
+    return 0;
+}
+
+/**
+ * @brief 编码变长记录,返回记录总长度
+ */
+static uint32_t record_encode(uint8_t* buf, uint16_t type, uint32_t id, int32_t delta, const uint8_t* data, uint16_t length) {
+    uint32_t pos = 2;
+
+    pos += varint_encode(&buf[pos], type);
+    pos += varint_encode(&buf[pos], id);
+    pos += varint_encode(&buf[pos], ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    if(length > 0) {
+        memcpy(&buf[pos], data, length);
+        pos += length;
+    }
+
+    buf[0] = STORAGE_RECORD_SYNC;
+    buf[1] = (uint8_t)(pos + 1 - 2);
+    buf[pos] = crc8(buf, pos);
+    return pos + 1;
+}
+
+/**
+ * @brief 解析并校验变长记录,out->data指向buf内
+ * @return uint32_t 记录总长度,不是有效记录返回0
+ */
+static uint32_t record_parse(const uint8_t* buf, uint32_t len, uint32_t base_time, StorageRecord* out) {
+    uint32_t value;
+    uint32_t pos = 2;
+    uint8_t num;
+
+    if(len < 2 || buf[0] != STORAGE_RECORD_SYNC) return 0;
+
+    uint32_t size = buf[1] + 2;
+    if(size < 6 || size > len) return 0;
+    if(crc8((uint8_t*)buf, size - 1) != buf[size - 1]) return 0;
+
+    num = varint_decode(&buf[pos], size - 1 - pos, &value);
+    if(num == 0 || value > 0xFFFF) return 0;
+    out->type = (uint16_t)value;
+    pos += num;
+
+    num = varint_decode(&buf[pos], size - 1 - pos, &out->id);
+    if(num == 0) return 0;
+    pos += num;
+
+    num = varint_decode(&buf[pos], size - 1 - pos, &value);
+    if(num == 0) return 0;
+    out->timestamp = base_time + (uint32_t)((value >> 1) ^ (0 - (value & 1)));
+    pos += num;
+
+    out->data = &buf[pos];
+    out->length = size - 1 - pos;
+    out->size = size;
+    return size;
 }
@@ -15,6 +15,7 @@
 #include "string.h"
 #include "usart.h"
 #include "mcu_timingtask.h"
+#include "trace_log.h"
 
 #if TIMINGTASK_STORAGE_IN_MCUFLASH == 1
 #include "mcu_flash.h"
@@ -23,9 +24,11 @@
 #endif
 
 #if MCU_TIMINGTASK_DEBUG == 1
-#define MCU_TIMINGTASK_LOG(fmt, ...) printf("[MCU_TIMINGTASK] " fmt, ##__VA_ARGS__)
+#define MCU_TIMINGTASK_LOG(fmt, ...) TRACE_LOG_OUT(TRACE_MOD_TIMINGTASK, TRACE_LEVEL_DEBUG, "[MCU_TIMINGTASK] " fmt, ##__VA_ARGS__)
+#define MCU_TIMINGTASK_LOG_ERR(fmt, ...) TRACE_LOG_OUT(TRACE_MOD_TIMINGTASK, TRACE_LEVEL_ERROR, "[MCU_TIMINGTASK] " fmt, ##__VA_ARGS__)
 #else
 #define MCU_TIMINGTASK_LOG(...)
+#define MCU_TIMINGTASK_LOG_ERR(...)
 #endif
 
 // 全局变量定义
@@ -68,7 +71,7 @@ static void mcu_timingtask_read(uint32_t addr, MCU_TIMINGTASK_T *data, uint32_t
         memcpy(data, data32, len);
         vPortFree(data32);
     } else {
-        MCU_TIMINGTASK_LOG("Memory allocation failed in mcu_timingtask_read\n");
+        MCU_TIMINGTASK_LOG_ERR("Memory allocation failed in mcu_timingtask_read\n");
     }
     #else
     // 计算需要的uint32_t数组大小，并向上取整
@@ -90,7 +93,7 @@ static void mcu_timingtask_nocheck_write(uint32_t addr, MCU_TIMINGTASK_T *data,
         mcu_flash_nocheck_write(addr, data32, word_count);
         vPortFree(data32);
     } else {
-        MCU_TIMINGTASK_LOG("Memory allocation failed in mcu_timingtask_nocheck_write\n");
+        MCU_TIMINGTASK_LOG_ERR("Memory allocation failed in mcu_timingtask_nocheck_write\n");
     }
     #else
     // 计算需要的uint32_t数组大小，并向上取整
@@ -105,7 +108,7 @@ static void mcu_timingtask_nocheck_write(uint32_t addr, MCU_TIMINGTASK_T *data,
 static void mcu_timingtask_read(uint32_t addr, MCU_TIMINGTASK_T *data, uint32_t len)
 {
     if (data == NULL) {
-        MCU_TIMINGTASK_LOG("Invalid data pointer in mcu_timingtask_read\n");
+        MCU_TIMINGTASK_LOG_ERR("Invalid data pointer in mcu_timingtask_read\n");
         return;
     }
 
@@ -116,7 +119,7 @@ static void mcu_timingtask_read(uint32_t addr, MCU_TIMINGTASK_T *data, uint32_t
         memcpy(data, data8, len);
         vPortFree(data8);
     } else {
-        MCU_TIMINGTASK_LOG("Memory allocation failed in mcu_timingtask_read\n");
+        MCU_TIMINGTASK_LOG_ERR("Memory allocation failed in mcu_timingtask_read\n");
     }
     #else
     // 使用静态缓冲区，确保安全使用
@@ -125,7 +128,7 @@ static void mcu_timingtask_read(uint32_t addr, MCU_TIMINGTASK_T *data, uint32_t
         W25QXX_ReadBuffer(data8, addr, MCU_TIMINGTASK_T_SIZE);
         memcpy(data, data8, MCU_TIMINGTASK_T_SIZE);
     } else {
-        MCU_TIMINGTASK_LOG("Data too large in mcu_timingtask_read: %d > %d\n", 
+        MCU_TIMINGTASK_LOG_ERR("Data too large in mcu_timingtask_read: %d > %d\n", 
                          len, MCU_TIMINGTASK_T_SIZE);
     }
     #endif
@@ -134,7 +137,7 @@ static void mcu_timingtask_read(uint32_t addr, MCU_TIMINGTASK_T *data, uint32_t
 static void mcu_timingtask_nocheck_write(uint32_t addr, MCU_TIMINGTASK_T *data, uint32_t size)
 {
     if (data == NULL) {
-        MCU_TIMINGTASK_LOG("Invalid data pointer in mcu_timingtask_nocheck_write\n");
+        MCU_TIMINGTASK_LOG_ERR("Invalid data pointer in mcu_timingtask_nocheck_write\n");
         return;
     }
     
@@ -145,7 +148,7 @@ static void mcu_timingtask_nocheck_write(uint32_t addr, MCU_TIMINGTASK_T *data,
         W25QXX_WriteNoErase(data8, addr, size);
         vPortFree(data8);
     } else {
-        MCU_TIMINGTASK_LOG("Memory allocation failed in mcu_timingtask_nocheck_write\n");
+        MCU_TIMINGTASK_LOG_ERR("Memory allocation failed in mcu_timingtask_nocheck_write\n");
     }
     #else
     // 使用静态缓冲区，确保安全使用
@@ -155,7 +158,7 @@ static void mcu_timingtask_nocheck_write(uint32_t addr, MCU_TIMINGTASK_T *data,
         W25QXX_WriteNoErase(data8, addr, MCU_TIMINGTASK_T_SIZE);
         
     } else {
-        MCU_TIMINGTASK_LOG("Data too large in mcu_timingtask_nocheck_write: %d > %d\n", 
+        MCU_TIMINGTASK_LOG_ERR("Data too large in mcu_timingtask_nocheck_write: %d > %d\n", 
                          size, MCU_TIMINGTASK_T_SIZE);
     }
     #endif
@@ -224,7 +227,7 @@ uint8_t mcu_timingtask_add(MCU_TIMINGTASK_T *timingtask)
     
     if(check_task_validity(timingtask) == 0)
     {
-        MCU_TIMINGTASK_LOG("Task validity check failed\n");
+        MCU_TIMINGTASK_LOG_ERR("Task validity check failed\n");
         return 0;
     }
     
@@ -247,14 +250,14 @@ uint8_t mcu_timingtask_add(MCU_TIMINGTASK_T *timingtask)
            timingtask->timingtask_id != 0xFFFFFFFF)
         {
             // 已存在相同ID的任务
-            MCU_TIMINGTASK_LOG("Task ID %x already exists\n", timingtask->timingtask_id);
+            MCU_TIMINGTASK_LOG_ERR("Task ID %x already exists\n", timingtask->timingtask_id);
             return 0;
         }
     }
     
     if(empty_index == 0xFF)
     {
-        MCU_TIMINGTASK_LOG("No empty slot available\n");
+        MCU_TIMINGTASK_LOG_ERR("No empty slot available\n");
         return 0;
     }
     
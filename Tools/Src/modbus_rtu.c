@@ -2,12 +2,15 @@
 #include "modbus_rtu.h"
 #include "string.h"
 #include "crc_tools.h"
+#include "trace_log.h"
 
 #define MODBUS_RTU_DEBUG 1
 #if MODBUS_RTU_DEBUG == 1
-#define MODBUS_RTU_LOG(fmt, ...) printf("[MODBUS_RTU] " fmt "\r\n", ##__VA_ARGS__)
+#define MODBUS_RTU_LOG(fmt, ...) TRACE_LOG_OUT(TRACE_MOD_MODBUS_RTU, TRACE_LEVEL_DEBUG, "[MODBUS_RTU] " fmt "\r\n", ##__VA_ARGS__)
+#define MODBUS_RTU_LOG_ERR(fmt, ...) TRACE_LOG_OUT(TRACE_MOD_MODBUS_RTU, TRACE_LEVEL_ERROR, "[MODBUS_RTU] " fmt "\r\n", ##__VA_ARGS__)
 #else
 #define MODBUS_RTU_LOG(fmt, ...)
+#define MODBUS_RTU_LOG_ERR(fmt, ...)
 #endif
 
 // /**
@@ -29,25 +32,49 @@
 /* read */
 
 /**
- * @brief   modbus rtu read function
+ * @brief   modbus rtu send frame, append crc
+ * @param   buf: frame buffer, 2 bytes left for crc
+ * @param   len: frame length without crc
+*/
+static uint8_t modbus_rtu_send(modbus_rtu_fun_t *fun, uint8_t *buf, uint16_t len)
+{
+    uint16_t crc = modbus_rtu_crc16(buf, len);
+    buf[len] = crc >> 8;
+    buf[len + 1] = crc & 0xFF;
+    return fun->rtu_hex_printf(buf, len + 2);
+}
+
+/**
+ * @brief   modbus rtu read frame pack
+ * @param   buf: frame buffer
  * @param   slave_addr: slave address
  * @param   function_code: function code
  * @param   reg_addr: register address or coil address
  * @param   reg_num: register number(word of number) or coil number
+ * @return  frame length without crc
 */
-static uint8_t modbus_rtu_read(modbus_rtu_fun_t *fun, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num)
+static uint16_t modbus_rtu_read_pack(uint8_t *buf, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num)
 {
-    uint8_t buf[MODBUS_RTU_SEND_BUF_LEN] = {0};
     buf[0] = slave_addr;
     buf[1] = function_code;
     buf[2] = reg_addr >> 8;
     buf[3] = reg_addr;
     buf[4] = reg_num >> 8;
     buf[5] = reg_num;
-    uint16_t crc = modbus_rtu_crc16(buf, 6);
-    buf[6] = crc >> 8;
-    buf[7] = crc & 0xFF;
-    return fun->rtu_hex_printf(buf, 8);
+    return 6;
+}
+
+/**
+ * @brief   modbus rtu read function
+ * @param   slave_addr: slave address
+ * @param   function_code: function code
+ * @param   reg_addr: register address or coil address
+ * @param   reg_num: register number(word of number) or coil number
+*/
+static uint8_t modbus_rtu_read(modbus_rtu_fun_t *fun, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num)
+{
+    uint8_t buf[MODBUS_RTU_SEND_BUF_LEN] = {0};
+    return modbus_rtu_send(fun, buf, modbus_rtu_read_pack(buf, slave_addr, function_code, reg_addr, reg_num));
 }
 
 /**
@@ -113,17 +140,18 @@ uint8_t modbus_rtu_read_input_registers(modbus_rtu_fun_t *fun, uint8_t slave_add
 /* write */
 
 /**
- * @brief   modbus rtu write function
+ * @brief   modbus rtu write frame pack
+ * @param   buf: frame buffer
  * @param   slave_addr: slave address
  * @param   function_code: function code
  * @param   reg_addr: register address or coil address
  * @param   reg_num: register number or coil number
  * @param   data: data buffer
  * @param   data_count: data byte count
+ * @return  frame length without crc
 */
-static uint8_t modbus_rtu_write(modbus_rtu_fun_t *fun, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num, uint8_t *data, uint8_t data_count)
+static uint16_t modbus_rtu_write_pack(uint8_t *buf, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num, uint8_t *data, uint8_t data_count)
 {
-    uint8_t buf[MODBUS_RTU_SEND_BUF_LEN] = {0};
     buf[0] = slave_addr;
     buf[1] = function_code;
     buf[2] = reg_addr >> 8;
@@ -134,10 +162,7 @@ static uint8_t modbus_rtu_write(modbus_rtu_fun_t *fun, uint8_t slave_addr, uint8
         {
             buf[4 + i] = data[i];
         }
-        uint16_t crc = modbus_rtu_crc16(buf, 4 + data_count);
-        buf[4 + data_count] = crc >> 8;
-        buf[5 + data_count] = crc & 0xFF;
-        return fun->rtu_hex_printf(buf, 6 + data_count);
+        return 4 + data_count;
     }
     else
     {
@@ -148,13 +173,25 @@ static uint8_t modbus_rtu_write(modbus_rtu_fun_t *fun, uint8_t slave_addr, uint8
         {
             buf[7 + i] = data[i];
         }
-        uint16_t crc = modbus_rtu_crc16(buf, 7 + data_count);
-        buf[7 + data_count] = crc >> 8;
-        buf[8 + data_count] = crc & 0xFF;
-        return fun->rtu_hex_printf(buf, 9 + data_count);
+        return 7 + data_count;
     }
 }
 
+/**
+ * @brief   modbus rtu write function
+ * @param   slave_addr: slave address
+ * @param   function_code: function code
+ * @param   reg_addr: register address or coil address
+ * @param   reg_num: register number or coil number
+ * @param   data: data buffer
+ * @param   data_count: data byte count
+*/
+static uint8_t modbus_rtu_write(modbus_rtu_fun_t *fun, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num, uint8_t *data, uint8_t data_count)
+{
+    uint8_t buf[MODBUS_RTU_SEND_BUF_LEN] = {0};
+    return modbus_rtu_send(fun, buf, modbus_rtu_write_pack(buf, slave_addr, function_code, reg_addr, reg_num, data, data_count));
+}
+
 /**
  * @brief   write multiple coils,function code 0x05
  * @param   slave_addr: slave address
@@ -435,12 +472,40 @@ uint8_t modbus_rtu_recv_msg_analysis(modbus_rtu_msg_t *msg)
         modbus_rtu_write_and_read_registers_recv_msg_analysis(msg);
         break;
     default:
-        MODBUS_RTU_LOG("modbus_rtu_recv_msg_analysis: function code error\r\n");
+        MODBUS_RTU_LOG_ERR("modbus_rtu_recv_msg_analysis: function code error\r\n");
         return MODBUS_STATUS_PARMINVAL;
     }
     return MODBUS_STATUS_OK;
 }
 
+/**
+ * @brief   rebuild the reply pdu from an analysed msg
+ * @param   msg: modbus rtu msg after modbus_rtu_recv_msg_analysis
+ * @param   exception: 1 if msg is an exception reply
+ * @param   pdu: output, function code + data, at least msg->data_len + 2 bytes
+ * @return  pdu length
+*/
+uint16_t modbus_rtu_msg_pdu_pack(modbus_rtu_msg_t *msg, uint8_t exception, uint8_t *pdu)
+{
+    uint16_t len = 0;
+    pdu[len++] = exception ? msg->function_code | 0x80 : msg->function_code;
+    switch (exception ? 0 : msg->function_code)
+    {
+    case MODBUS_RTU_FUNCTION_CODE_READ_COILS:
+    case MODBUS_RTU_FUNCTION_CODE_READ_DISCRETE_INPUTS:
+    case MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS:
+    case MODBUS_RTU_FUNCTION_CODE_READ_INPUT_REGISTERS:
+    case MODBUS_RTU_FUNCTION_CODE_WRITE_AND_READ_REGISTERS:
+        /* analysis stripped the byte count */
+        pdu[len++] = msg->data_len;
+        break;
+    default:
+        break;
+    }
+    memcpy(pdu + len, msg->data, msg->data_len);
+    return len + msg->data_len;
+}
+
 /**
  * @brief   modbus rtu recv msg pack
  * @param   msg: modbus rtu msg
@@ -451,7 +516,7 @@ uint8_t modbus_rtu_recv_msg_pack(modbus_rtu_fun_t *fun, modbus_rtu_msg_t *msg)
     uint16_t len = fun->rtu_rx_get_len();
     if((len < 6 && buf != NULL))
     {
-        MODBUS_RTU_LOG("modbus recv len error: %d\r\n", len);
+        MODBUS_RTU_LOG_ERR("modbus recv len error: %d\r\n", len);
         fun->rtu_rx_reset();
         return MODBUS_STATUS_ERROR;
     }
@@ -462,7 +527,7 @@ uint8_t modbus_rtu_recv_msg_pack(modbus_rtu_fun_t *fun, modbus_rtu_msg_t *msg)
     uint16_t crc = modbus_rtu_crc16(buf, len - 2);
     if(crc != (buf[len - 2] << 8 | buf[len - 1]))
     {
-        MODBUS_RTU_LOG("modbus crc error\r\n");
+        MODBUS_RTU_LOG_ERR("modbus crc error\r\n");
         fun->rtu_rx_reset();
         return MODBUS_STATUS_ERROR;
     }
@@ -477,168 +542,1129 @@ uint8_t modbus_rtu_recv_msg_pack(modbus_rtu_fun_t *fun, modbus_rtu_msg_t *msg)
 
 /* modbus recv end */
 
-#endif
+/* modbus async master start */
 
-#if MODBUS_RTU_SLAVE_MODE == 1
+#define MODBUS_RTU_ENTER_CRITICAL() uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define MODBUS_RTU_EXIT_CRITICAL() __set_PRIMASK(primask)
+
+/* transmit and callback collected in the critical section, run after leaving it */
+typedef struct
+{
+    modbus_rtu_req_t *send;
+    p_rtu_complete complete;
+    void *arg;
+    uint8_t status;
+    modbus_rtu_msg_t *msg;
+    uint8_t drained;//a queue slot was freed
+}modbus_rtu_master_defer_t;
 
-uint16_t *modbus_rtu_reg;//reg0:slave addr
-uint16_t modbus_rtu_reg_len;
+static void modbus_rtu_plan_submit(modbus_rtu_plan_t *plan);
 
-void modbus_rtu_slave_reg_init(uint16_t *reg, uint16_t reg_len)
+/**
+ * @brief   send the request at queue head and wait for the reply
+ * @param   master: modbus rtu master
+ * @param   defer: the frame is transmitted by modbus_rtu_master_defer_run
+*/
+static void modbus_rtu_master_send(modbus_rtu_master_t *master, modbus_rtu_master_defer_t *defer)
+{
+    modbus_rtu_req_t *req = &master->queue[master->head];
+    master->fun->rtu_rx_reset();
+    master->state = MODBUS_RTU_MASTER_WAIT;
+    /* timeout counts from the end of transmission */
+    master->timer_start(req->len * master->char_us + req->timeout_ms * 1000);
+    defer->send = req;
+}
+
+/**
+ * @brief   finish the request at queue head, then wait for the inter-frame gap
+ * @param   master: modbus rtu master
+ * @param   status: MODBUS_STATUS_CODE
+ * @param   msg: reply msg, NULL if none
+ * @param   defer: the callback is called by modbus_rtu_master_defer_run
+*/
+static void modbus_rtu_master_finish(modbus_rtu_master_t *master, uint8_t status, modbus_rtu_msg_t *msg, modbus_rtu_master_defer_t *defer)
 {
-    modbus_rtu_reg = reg;
-    modbus_rtu_reg_len = reg_len;
+    modbus_rtu_req_t *req = &master->queue[master->head];
+    defer->complete = req->complete;
+    defer->arg = req->arg;
+    defer->status = status;
+    defer->msg = msg;
+    defer->drained = 1;
+    master->head = (master->head + 1) % MODBUS_RTU_QUEUE_LEN;
+    master->count--;
+    master->state = MODBUS_RTU_MASTER_GAP;
+    master->timer_start(master->gap_us);
 }
 
-uint8_t modbus_rtu_slave_reg_ack(modbus_rtu_slave_msg_t *msg)
+/**
+ * @brief   resume plans that stopped on a full queue
+ * @note    a plan only resubmits from its own frame completions, if other requests
+ *          took the freed slots it would have no frame in flight and never resume
+ * @param   master: modbus rtu master
+*/
+static void modbus_rtu_master_drain(modbus_rtu_master_t *master)
 {
-    uint8_t buf[MODBUS_RTU_SEND_BUF_LEN] = {0};
-    buf[0] = modbus_rtu_reg[0];
-    buf[1] = msg->function_code;
-    if(msg->reg_num != 0)
+    while(1)
     {
-        buf[2] = msg->reg_num >> 8;
-        buf[3] = msg->reg_num & 0xFF;
-        uint16_t crc = modbus_rtu_crc16(buf, 4);
-        buf[4] = crc >> 8;
-        buf[5] = crc & 0xFF;
-        return modbus_rtu_slave_send(buf, 6);
-    }
-    else if(msg->data_len != 0)
-    {
-        for(int i = 0; i < msg->data_len; i++)
+        modbus_rtu_plan_t *plan;
+        {
+            MODBUS_RTU_ENTER_CRITICAL();
+            plan = master->wait;
+            if(plan == NULL || master->count >= MODBUS_RTU_QUEUE_LEN)
+            {
+                MODBUS_RTU_EXIT_CRITICAL();
+                return;
+            }
+            master->wait = plan->wait_next;
+            plan->wait_next = NULL;
+            plan->waiting = 0;
+            MODBUS_RTU_EXIT_CRITICAL();
+        }
+        modbus_rtu_plan_submit(plan);
+        if(plan->waiting)
         {
-            buf[2 + i] = msg->data[i];
+            return;//queue full again, plan is back in the list
         }
-        uint16_t crc = modbus_rtu_crc16(buf, 2 + msg->data_len);
-        buf[2 + msg->data_len] = crc >> 8;
-        buf[3 + msg->data_len] = crc & 0xFF;
-        return modbus_rtu_slave_send(buf, 4 + msg->data_len);
     }
-    
 }
 
-uint8_t modbus_rtu_slave_read_holding_registers_ack(modbus_rtu_slave_msg_t *msg)
+/**
+ * @brief   transmit and call back outside the critical section
+ * @note    the queue slot is not reused before the reply or timeout, so req->buf stays valid
+ * @param   master: modbus rtu master
+ * @param   defer: filled by modbus_rtu_master_send/finish
+*/
+static void modbus_rtu_master_defer_run(modbus_rtu_master_t *master, modbus_rtu_master_defer_t *defer)
 {
-    msg->reg_num = msg->data[0] << 8 | msg->data[1];
-    if(msg->reg_addr + msg->reg_num > modbus_rtu_reg_len)
+    if(defer->send != NULL)
     {
-        return MODBUS_STATUS_PARMINVAL;
+        master->fun->rtu_hex_printf(defer->send->buf, defer->send->len);
     }
-    msg->buf[0] = msg->reg_num * 2;
-    for(int i = 0; i < msg->reg_num; i++)
+    if(defer->complete != NULL)
     {
-        msg->buf[1 + i * 2] = modbus_rtu_reg[msg->reg_addr + i] >> 8;
-        msg->buf[2 + i * 2] = modbus_rtu_reg[msg->reg_addr + i] & 0xFF;
+        defer->complete(defer->status, defer->msg, defer->arg);
+    }
+    if(defer->drained && master->wait != NULL)
+    {
+        modbus_rtu_master_drain(master);
     }
-    msg->reg_num = 0;
-    return modbus_rtu_slave_reg_ack(msg);
 }
 
-uint8_t modbus_rtu_slave_read_input_registers_ack(modbus_rtu_slave_msg_t *msg)
+/**
+ * @brief   retry the request at queue head after the gap, or finish it
+ * @param   master: modbus rtu master
+ * @param   status: status if no retry left
+ * @param   defer: see modbus_rtu_master_finish
+*/
+static void modbus_rtu_master_retry(modbus_rtu_master_t *master, uint8_t status, modbus_rtu_master_defer_t *defer)
+{
+    modbus_rtu_req_t *req = &master->queue[master->head];
+    if(req->retry == 0)
+    {
+        modbus_rtu_master_finish(master, status, NULL, defer);
+        return;
+    }
+    req->retry--;
+    master->state = MODBUS_RTU_MASTER_GAP;
+    master->timer_start(master->gap_us);
+}
+
+/**
+ * @brief   modbus rtu async master init
+ * @param   master: modbus rtu master
+ * @param   fun: function pointer, rtu_hex_printf must not block
+ * @param   timer_start: one-shot timer, call modbus_rtu_master_timer_irq on expiry
+ * @param   baudrate: bus baudrate, used for the 3.5 char gap
+*/
+void modbus_rtu_master_init(modbus_rtu_master_t *master, modbus_rtu_fun_t *fun, p_rtu_timer_start timer_start, uint32_t baudrate)
+{
+    memset(master, 0, sizeof(modbus_rtu_master_t));
+    master->fun = fun;
+    master->timer_start = timer_start;
+    master->char_us = (11 * 1000000UL + baudrate - 1) / baudrate;
+    /* fixed 1750us above 19200bps */
+    master->gap_us = baudrate > 19200 ? 1750 : (master->char_us * 7 + 1) / 2;
+    master->timeout_ms = MODBUS_RTU_TIMEOUT_MS;
+    master->retry = MODBUS_RTU_RETRY;
+    master->state = MODBUS_RTU_MASTER_IDLE;
+}
+
+/**
+ * @brief   queue a request frame
+ * @param   master: modbus rtu master
+ * @param   buf: frame without crc
+ * @param   len: frame length without crc
+ * @param   timeout_ms: reply timeout, turnaround delay for broadcast
+ * @param   retry: retry times on timeout or crc error
+ * @param   complete: completion callback, called in interrupt context
+ * @param   arg: callback argument
+ * @note    may be called from task or from a completion callback
+*/
+uint8_t modbus_rtu_master_submit(modbus_rtu_master_t *master, uint8_t *buf, uint16_t len, uint16_t timeout_ms, uint8_t retry, p_rtu_complete complete, void *arg)
 {
-    msg->reg_num = msg->data[0] << 8 | msg->data[1];
-    if(msg->reg_addr + msg->reg_num > modbus_rtu_reg_len)
+    if(len < 2 || len + 2 > MODBUS_RTU_SEND_BUF_LEN)
     {
         return MODBUS_STATUS_PARMINVAL;
     }
-    msg->buf[0] = msg->reg_num * 2;
-    for(int i = 0; i < msg->reg_num; i++)
+    modbus_rtu_master_defer_t defer = {0};
+    MODBUS_RTU_ENTER_CRITICAL();
+    if(master->count >= MODBUS_RTU_QUEUE_LEN)
+    {
+        MODBUS_RTU_EXIT_CRITICAL();
+        return MODBUS_STATUS_ERROR;
+    }
+    modbus_rtu_req_t *req = &master->queue[(master->head + master->count) % MODBUS_RTU_QUEUE_LEN];
+    memcpy(req->buf, buf, len);
+    uint16_t crc = modbus_rtu_crc16(req->buf, len);
+    req->buf[len] = crc >> 8;
+    req->buf[len + 1] = crc & 0xFF;
+    req->len = len + 2;
+    req->timeout_ms = timeout_ms;
+    req->retry = retry;
+    req->complete = complete;
+    req->arg = arg;
+    master->count++;
+    if(master->state == MODBUS_RTU_MASTER_IDLE)
     {
-        msg->buf[1 + i * 2] = modbus_rtu_reg[msg->reg_addr + i] >> 8;
-        msg->buf[2 + i * 2] = modbus_rtu_reg[msg->reg_addr + i] & 0xFF;
+        modbus_rtu_master_send(master, &defer);
     }
-    msg->reg_num = 0;
-    return modbus_rtu_slave_reg_ack(msg);
+    MODBUS_RTU_EXIT_CRITICAL();
+    modbus_rtu_master_defer_run(master, &defer);
+    return MODBUS_STATUS_OK;
 }
 
-uint8_t modbus_rtu_slave_write_single_register_ack(modbus_rtu_slave_msg_t *msg)
+/**
+ * @brief   queue a read request, function code 0x01-0x04
+ * @param   master: modbus rtu master
+ * @param   slave_addr: slave address
+ * @param   function_code: function code
+ * @param   reg_addr: register address or coil address
+ * @param   reg_num: register number or coil number
+ * @param   complete: completion callback
+ * @param   arg: callback argument
+*/
+uint8_t modbus_rtu_master_read(modbus_rtu_master_t *master, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num, p_rtu_complete complete, void *arg)
 {
-    if(msg->reg_addr >= modbus_rtu_reg_len)
+    uint8_t buf[MODBUS_RTU_SEND_BUF_LEN];
+    if(function_code < MODBUS_RTU_FUNCTION_CODE_READ_COILS || function_code > MODBUS_RTU_FUNCTION_CODE_READ_INPUT_REGISTERS)
     {
         return MODBUS_STATUS_PARMINVAL;
     }
-    modbus_rtu_reg[msg->reg_addr] = msg->data[0] << 8 | msg->data[1];
-    return modbus_rtu_slave_reg_ack(msg);
+    if(reg_num > (function_code <= MODBUS_RTU_FUNCTION_CODE_READ_DISCRETE_INPUTS ? 2000 : 125))
+    {
+        return MODBUS_STATUS_PARMINVAL;
+    }
+    uint16_t len = modbus_rtu_read_pack(buf, slave_addr, function_code, reg_addr, reg_num);
+    return modbus_rtu_master_submit(master, buf, len, master->timeout_ms, master->retry, complete, arg);
 }
 
-uint8_t modbus_rtu_slave_write_multiple_registers_ack(modbus_rtu_slave_msg_t *msg)
+/**
+ * @brief   queue a write request, function code 0x05/0x06/0x0F/0x10
+ * @param   master: modbus rtu master
+ * @param   slave_addr: slave address
+ * @param   function_code: function code
+ * @param   reg_addr: register address or coil address
+ * @param   reg_num: register number or coil number, 1 for 0x05/0x06
+ * @param   data: data buffer
+ * @param   data_count: data byte count
+ * @param   complete: completion callback
+ * @param   arg: callback argument
+*/
+uint8_t modbus_rtu_master_write(modbus_rtu_master_t *master, uint8_t slave_addr, uint8_t function_code, uint16_t reg_addr, uint16_t reg_num, uint8_t *data, uint8_t data_count, p_rtu_complete complete, void *arg)
 {
-    msg->reg_num = msg->data[0] << 8 | msg->data[1];
-    msd->data_len = msg->data[2];
-    msg->data = msg->data + 3;
-    if(msg->reg_addr + msg->reg_num > modbus_rtu_reg_len)
+    uint8_t buf[MODBUS_RTU_SEND_BUF_LEN];
+    if(data_count + 9 > MODBUS_RTU_SEND_BUF_LEN)
     {
         return MODBUS_STATUS_PARMINVAL;
     }
-    for(int i = 0; i < msg->reg_num; i++)
+    uint16_t len = modbus_rtu_write_pack(buf, slave_addr, function_code, reg_addr, reg_num, data, data_count);
+    return modbus_rtu_master_submit(master, buf, len, master->timeout_ms, master->retry, complete, arg);
+}
+
+/**
+ * @brief   call in the uart idle interrupt after a frame is received
+ * @param   master: modbus rtu master
+*/
+void modbus_rtu_master_rx_irq(modbus_rtu_master_t *master)
+{
+    modbus_rtu_fun_t *fun = master->fun;
+    uint8_t *buf = fun->rtu_rx_get_buf();
+    uint16_t len = fun->rtu_rx_get_len();
+    modbus_rtu_master_defer_t defer = {0};
+    MODBUS_RTU_ENTER_CRITICAL();
+    if(buf == NULL || master->state != MODBUS_RTU_MASTER_WAIT)
+    {
+        fun->rtu_rx_reset();
+        MODBUS_RTU_EXIT_CRITICAL();
+        return;
+    }
+    modbus_rtu_req_t *req = &master->queue[master->head];
+    if(len < 5 || len - 4 > MODBUS_RTU_RECV_BUF_LEN || modbus_rtu_crc16_update(MODBUS_CRC16_INIT, buf, len) != 0)
+    {
+        MODBUS_RTU_LOG_ERR("modbus crc error\r\n");
+        fun->rtu_rx_reset();
+        modbus_rtu_master_retry(master, MODBUS_STATUS_ERROR, &defer);
+        MODBUS_RTU_EXIT_CRITICAL();
+        modbus_rtu_master_defer_run(master, &defer);
+        return;
+    }
+    if(buf[0] != req->buf[0] || (buf[1] & 0x7F) != req->buf[1])
+    {
+        /* not the reply we wait for, keep waiting */
+        fun->rtu_rx_reset();
+        MODBUS_RTU_EXIT_CRITICAL();
+        return;
+    }
+    if(((buf[1] >= MODBUS_RTU_FUNCTION_CODE_READ_COILS && buf[1] <= MODBUS_RTU_FUNCTION_CODE_READ_INPUT_REGISTERS) ||
+        buf[1] == MODBUS_RTU_FUNCTION_CODE_WRITE_AND_READ_REGISTERS) && buf[2] != len - 5)
+    {
+        /* byte count must match the frame, analysis trusts it */
+        MODBUS_RTU_LOG_ERR("modbus byte count error: %d\r\n", buf[2]);
+        fun->rtu_rx_reset();
+        modbus_rtu_master_finish(master, MODBUS_STATUS_ERROR, NULL, &defer);
+        MODBUS_RTU_EXIT_CRITICAL();
+        modbus_rtu_master_defer_run(master, &defer);
+        return;
+    }
+    modbus_rtu_msg_t *msg = &master->msg;
+    uint8_t status = MODBUS_STATUS_OK;
+    msg->slave_addr = buf[0];
+    msg->function_code = buf[1] & 0x7F;
+    memcpy(msg->data, buf + 2, len - 4);
+    msg->data_len = len - 4;
+    fun->rtu_rx_reset();
+    if(buf[1] & 0x80)
+    {
+        status = MODBUS_STATUS_EXCEPTION;//data[0]:exception code
+    }
+    else
     {
-        modbus_rtu_reg[msg->reg_addr + i] = msg->data[i * 2] << 8 | msg->data[i * 2 + 1];
+        modbus_rtu_recv_msg_analysis(msg);
     }
-    return modbus_rtu_slave_reg_ack(msg);
+    modbus_rtu_master_finish(master, status, msg, &defer);
+    MODBUS_RTU_EXIT_CRITICAL();
+    modbus_rtu_master_defer_run(master, &defer);
 }
 
-uint8_t modbus_rtu_slave_msg_anlaysis(modbus_rtu_slave_msg_t *msg)
+/**
+ * @brief   call when the timer started by timer_start expires
+ * @param   master: modbus rtu master
+*/
+void modbus_rtu_master_timer_irq(modbus_rtu_master_t *master)
 {
-    switch (msg->function_code)
+    modbus_rtu_master_defer_t defer = {0};
+    MODBUS_RTU_ENTER_CRITICAL();
+    switch (master->state)
     {
-    case MODBUS_RTU_FUNCTION_CODE_READ_COILS:
-        break;
-    case MODBUS_RTU_FUNCTION_CODE_READ_DISCRETE_INPUTS:
-        break;
-    case MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS:
-        modbus_rtu_slave_read_holding_registers_ack(msg);
-        break;
-    case MODBUS_RTU_FUNCTION_CODE_READ_INPUT_REGISTERS:
-        modbus_rtu_slave_read_input_registers_ack(msg);
-        break;
-    case MODBUS_RTU_FUNCTION_CODE_WRITE_SINGLE_COIL:
-        break;
-    case MODBUS_RTU_FUNCTION_CODE_WRITE_SINGLE_REGISTER:
-        modbus_rtu_slave_write_single_register_ack(msg);
-        break;
-    case MODBUS_RTU_FUNCTION_CODE_WRITE_MULTIPLE_COILS:
+    case MODBUS_RTU_MASTER_WAIT:
+        if(master->queue[master->head].buf[0] == 0)
+        {
+            /* broadcast has no reply, turnaround delay elapsed */
+            modbus_rtu_master_finish(master, MODBUS_STATUS_OK, NULL, &defer);
+        }
+        else
+        {
+            modbus_rtu_master_retry(master, MODBUS_STATUS_TIMEOUT, &defer);
+        }
         break;
-    case MODBUS_RTU_FUNCTION_CODE_WRITE_MULTIPLE_REGISTERS:
-        modbus_rtu_slave_write_multiple_registers_ack(msg);
+    case MODBUS_RTU_MASTER_GAP:
+        if(master->count != 0)
+        {
+            modbus_rtu_master_send(master, &defer);
+        }
+        else
+        {
+            master->state = MODBUS_RTU_MASTER_IDLE;
+        }
         break;
-    case MODBUS_RTU_FUNCTION_CODE_WRITE_MASK_REGISTER:
+    default:
         break;
-    case MODBUS_RTU_FUNCTION_CODE_WRITE_AND_READ_REGISTERS:
+    }
+    MODBUS_RTU_EXIT_CRITICAL();
+    modbus_rtu_master_defer_run(master, &defer);
+}
+
+/**
+ * @brief   number of queued requests, including the one in flight
+ * @param   master: modbus rtu master
+*/
+uint8_t modbus_rtu_master_pending(modbus_rtu_master_t *master)
+{
+    return master->count;
+}
+
+/* modbus async master end */
+
+/* modbus poll plan start */
+
+/**
+ * @brief   max registers or bits of one read frame
+ * @param   function_code: function code 0x01-0x04
+*/
+static uint16_t modbus_rtu_plan_limit(uint8_t function_code)
+{
+    /* reply data: byte count + values, must fit in modbus_rtu_msg_t */
+    if(function_code <= MODBUS_RTU_FUNCTION_CODE_READ_DISCRETE_INPUTS)
+    {
+        return (MODBUS_RTU_RECV_BUF_LEN - 1) * 8 < 2000 ? (MODBUS_RTU_RECV_BUF_LEN - 1) * 8 : 2000;
+    }
+    return (MODBUS_RTU_RECV_BUF_LEN - 1) / 2 < 125 ? (MODBUS_RTU_RECV_BUF_LEN - 1) / 2 : 125;
+}
+
+/**
+ * @brief   point sort key compare
+ * @return  1: a after b
+*/
+static uint8_t modbus_rtu_point_after(modbus_rtu_point_t *a, modbus_rtu_point_t *b)
+{
+    if(a->slave_addr != b->slave_addr)
+    {
+        return a->slave_addr > b->slave_addr;
+    }
+    if(a->function_code != b->function_code)
+    {
+        return a->function_code > b->function_code;
+    }
+    return a->reg_addr > b->reg_addr;
+}
+
+/**
+ * @brief   merge points into the fewest read frames
+ * @param   plan: poll plan
+ * @param   point: point list, sorted in place by slave/function/address
+ * @param   point_num: point number
+ * @param   gap: max unused registers (or bits) read to join two points
+*/
+uint8_t modbus_rtu_plan_build(modbus_rtu_plan_t *plan, modbus_rtu_point_t *point, uint16_t point_num, uint16_t gap)
+{
+    memset(plan, 0, sizeof(modbus_rtu_plan_t));
+    plan->point = point;
+    plan->point_num = point_num;
+    /* insertion sort, point lists are short and mostly ordered */
+    for(int i = 1; i < point_num; i++)
+    {
+        modbus_rtu_point_t tmp = point[i];
+        int j = i - 1;
+        while(j >= 0 && modbus_rtu_point_after(&point[j], &tmp))
+        {
+            point[j + 1] = point[j];
+            j--;
+        }
+        point[j + 1] = tmp;
+    }
+    modbus_rtu_plan_frame_t *frame = NULL;
+    for(int i = 0; i < point_num; i++)
+    {
+        modbus_rtu_point_t *p = &point[i];
+        if(p->function_code < MODBUS_RTU_FUNCTION_CODE_READ_COILS || p->function_code > MODBUS_RTU_FUNCTION_CODE_READ_INPUT_REGISTERS
+            || p->reg_num == 0 || p->reg_num > modbus_rtu_plan_limit(p->function_code))
+        {
+            return MODBUS_STATUS_PARMINVAL;
+        }
+        uint32_t end = (uint32_t)p->reg_addr + p->reg_num;
+        if(frame != NULL && frame->slave_addr == p->slave_addr && frame->function_code == p->function_code
+            && p->reg_addr <= (uint32_t)frame->reg_addr + frame->reg_num + gap
+            && end - frame->reg_addr <= modbus_rtu_plan_limit(p->function_code))
+        {
+            if(end > (uint32_t)frame->reg_addr + frame->reg_num)
+            {
+                frame->reg_num = end - frame->reg_addr;
+            }
+        }
+        else
+        {
+            if(plan->frame_num >= MODBUS_RTU_PLAN_FRAME_NUM)
+            {
+                return MODBUS_STATUS_ERROR;
+            }
+            frame = &plan->frame[plan->frame_num++];
+            frame->plan = plan;
+            frame->slave_addr = p->slave_addr;
+            frame->function_code = p->function_code;
+            frame->reg_addr = p->reg_addr;
+            frame->reg_num = p->reg_num;
+        }
+        p->frame = plan->frame_num - 1;
+    }
+    return MODBUS_STATUS_OK;
+}
+
+/**
+ * @brief   scatter a frame reply into its points
+ * @param   plan: poll plan
+ * @param   index: frame index
+ * @param   msg: reply msg after modbus_rtu_recv_msg_analysis
+*/
+uint8_t modbus_rtu_plan_scatter(modbus_rtu_plan_t *plan, uint8_t index, modbus_rtu_msg_t *msg)
+{
+    modbus_rtu_plan_frame_t *frame = &plan->frame[index];
+    uint8_t bits = frame->function_code <= MODBUS_RTU_FUNCTION_CODE_READ_DISCRETE_INPUTS;
+    uint16_t need = bits ? (frame->reg_num + 7) / 8 : frame->reg_num * 2;
+    if(msg->slave_addr != frame->slave_addr || msg->function_code != frame->function_code || msg->data_len < need)
+    {
+        return MODBUS_STATUS_ERROR;
+    }
+    for(int i = 0; i < plan->point_num; i++)
+    {
+        modbus_rtu_point_t *p = &plan->point[i];
+        if(p->frame != index)
+        {
+            continue;
+        }
+        uint16_t offset = p->reg_addr - frame->reg_addr;
+        for(int j = 0; j < p->reg_num; j++)
+        {
+            if(bits)
+            {
+                p->value[j] = (msg->data[(offset + j) / 8] >> ((offset + j) % 8)) & 0x01;
+            }
+            else
+            {
+                p->value[j] = msg->data[(offset + j) * 2] << 8 | msg->data[(offset + j) * 2 + 1];
+            }
+        }
+    }
+    return MODBUS_STATUS_OK;
+}
+
+static void modbus_rtu_plan_complete(uint8_t status, modbus_rtu_msg_t *msg, void *arg);
+
+/**
+ * @brief   submit plan frames until the master queue is full
+ * @note    on a full queue the plan waits in master->wait and resumes when a request finishes
+ * @param   plan: poll plan
+*/
+static void modbus_rtu_plan_submit(modbus_rtu_plan_t *plan)
+{
+    modbus_rtu_master_t *master = plan->master;
+    while(plan->next < plan->frame_num)
+    {
+        modbus_rtu_plan_frame_t *frame = &plan->frame[plan->next];
+        if(modbus_rtu_master_read(master, frame->slave_addr, frame->function_code, frame->reg_addr, frame->reg_num,
+                                  modbus_rtu_plan_complete, frame) == MODBUS_STATUS_OK)
+        {
+            plan->next++;
+            continue;
+        }
+        MODBUS_RTU_ENTER_CRITICAL();
+        if(master->count < MODBUS_RTU_QUEUE_LEN)
+        {
+            /* a slot was freed meanwhile, try again */
+            MODBUS_RTU_EXIT_CRITICAL();
+            continue;
+        }
+        if(!plan->waiting)
+        {
+            modbus_rtu_plan_t **tail = &master->wait;
+            while(*tail != NULL)
+            {
+                tail = &(*tail)->wait_next;
+            }
+            plan->wait_next = NULL;
+            *tail = plan;
+            plan->waiting = 1;
+        }
+        MODBUS_RTU_EXIT_CRITICAL();
         break;
-    default:
+    }
+}
+
+/**
+ * @brief   frame completion, scatter and keep the queue filled
+*/
+static void modbus_rtu_plan_complete(uint8_t status, modbus_rtu_msg_t *msg, void *arg)
+{
+    modbus_rtu_plan_frame_t *frame = (modbus_rtu_plan_frame_t *)arg;
+    modbus_rtu_plan_t *plan = frame->plan;
+    if(status == MODBUS_STATUS_OK)
+    {
+        status = modbus_rtu_plan_scatter(plan, frame - plan->frame, msg);
+    }
+    frame->status = status;
+    plan->done++;
+    modbus_rtu_plan_submit(plan);
+    if(plan->done == plan->frame_num && plan->complete != NULL)
+    {
+        plan->complete(plan);
+    }
+}
+
+/**
+ * @brief   start one scan of the plan on an async master
+ * @param   plan: poll plan
+ * @param   master: modbus rtu master
+ * @param   complete: called when every frame has finished, may be NULL
+ * @note    frames that do not fit in the queue are submitted as requests finish,
+ *          an empty plan calls complete before returning
+*/
+uint8_t modbus_rtu_plan_scan(modbus_rtu_plan_t *plan, modbus_rtu_master_t *master, p_rtu_plan_complete complete)
+{
+    if(plan->next != plan->done || plan->waiting)
+    {
+        return MODBUS_STATUS_ERROR;//last scan not finished
+    }
+    plan->master = master;
+    plan->complete = complete;
+    plan->next = 0;
+    plan->done = 0;
+    if(plan->frame_num == 0)
+    {
+        /* no frame will complete to report the scan */
+        if(complete != NULL)
+        {
+            complete(plan);
+        }
+        return MODBUS_STATUS_OK;
+    }
+    modbus_rtu_plan_submit(plan);
+    return MODBUS_STATUS_OK;
+}
+
+/* modbus poll plan end */
+
+#endif
+
+#if MODBUS_RTU_SLAVE_MODE == 1
+
+/**
+ * @brief   find the region holding addr
+ * @param   table: MODBUS_RTU_TABLE
+ * @param   addr: data address
+*/
+static modbus_rtu_region_t *modbus_rtu_slave_region(modbus_rtu_slave_t *slave, uint8_t table, uint16_t addr)
+{
+    for(modbus_rtu_region_t *region = slave->region; region != NULL; region = region->next)
+    {
+        if(region->table == table && addr >= region->start && addr - region->start < region->num)
+        {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief   check that [addr, addr+num) is mapped, so a write is never applied partially
+ * @param   write: 1 check writable
+ * @return  0 or exception code
+*/
+static uint8_t modbus_rtu_slave_check(modbus_rtu_slave_t *slave, uint8_t table, uint16_t addr, uint16_t num, uint8_t write)
+{
+    uint32_t cur = addr;
+    if(cur + num > 0x10000)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+    while(cur < (uint32_t)addr + num)
+    {
+        modbus_rtu_region_t *region = modbus_rtu_slave_region(slave, table, cur);
+        if(region == NULL || (write && region->value == NULL && region->write == NULL)
+            || (!write && region->value == NULL && region->read == NULL))
+        {
+            return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+        }
+        cur = (uint32_t)region->start + region->num;
+    }
+    return 0;
+}
+
+/**
+ * @brief   read or write num items, may span regions
+ * @param   value: num items, num <= MODBUS_RTU_SLAVE_CHUNK
+ * @return  0 or exception code
+*/
+static uint8_t modbus_rtu_slave_access(modbus_rtu_slave_t *slave, uint8_t table, uint16_t addr, uint16_t num, uint16_t *value, uint8_t write)
+{
+    while(num != 0)
+    {
+        modbus_rtu_region_t *region = modbus_rtu_slave_region(slave, table, addr);
+        if(region == NULL)
+        {
+            return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+        }
+        uint16_t n = region->start + region->num - addr;
+        if(n > num)
+        {
+            n = num;
+        }
+        uint8_t ex = 0;
+        if(region->value != NULL)
+        {
+            uint16_t *p = region->value + (addr - region->start);
+            for(int i = 0; i < n; i++)
+            {
+                if(write)
+                {
+                    p[i] = value[i];
+                }
+                else
+                {
+                    value[i] = p[i];
+                }
+            }
+        }
+        else
+        {
+            ex = write ? region->write(addr, n, value) : region->read(addr, n, value);
+        }
+        if(ex != 0)
+        {
+            return ex;
+        }
+        addr += n;
+        value += n;
+        num -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief   read bits into packed response bytes
+ * @param   out: response data, (num + 7) / 8 bytes
+*/
+static uint8_t modbus_rtu_slave_read_bits(modbus_rtu_slave_t *slave, uint8_t table, uint16_t addr, uint16_t num, uint8_t *out)
+{
+    uint16_t tmp[MODBUS_RTU_SLAVE_CHUNK];
+    memset(out, 0, (num + 7) / 8);
+    for(uint16_t off = 0; off < num; off += MODBUS_RTU_SLAVE_CHUNK)
+    {
+        uint16_t n = num - off < MODBUS_RTU_SLAVE_CHUNK ? num - off : MODBUS_RTU_SLAVE_CHUNK;
+        uint8_t ex = modbus_rtu_slave_access(slave, table, addr + off, n, tmp, 0);
+        if(ex != 0)
+        {
+            return ex;
+        }
+        for(int i = 0; i < n; i++)
+        {
+            if(tmp[i])
+            {
+                out[(off + i) / 8] |= 1 << ((off + i) % 8);
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief   read registers into big-endian response bytes
+ * @param   out: response data, num * 2 bytes
+*/
+static uint8_t modbus_rtu_slave_read_regs(modbus_rtu_slave_t *slave, uint8_t table, uint16_t addr, uint16_t num, uint8_t *out)
+{
+    uint16_t tmp[MODBUS_RTU_SLAVE_CHUNK];
+    for(uint16_t off = 0; off < num; off += MODBUS_RTU_SLAVE_CHUNK)
+    {
+        uint16_t n = num - off < MODBUS_RTU_SLAVE_CHUNK ? num - off : MODBUS_RTU_SLAVE_CHUNK;
+        uint8_t ex = modbus_rtu_slave_access(slave, table, addr + off, n, tmp, 0);
+        if(ex != 0)
+        {
+            return ex;
+        }
+        for(int i = 0; i < n; i++)
+        {
+            out[(off + i) * 2] = tmp[i] >> 8;
+            out[(off + i) * 2 + 1] = tmp[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief   write packed request bits
+ * @param   in: request data, (num + 7) / 8 bytes
+*/
+static uint8_t modbus_rtu_slave_write_bits(modbus_rtu_slave_t *slave, uint16_t addr, uint16_t num, const uint8_t *in)
+{
+    uint16_t tmp[MODBUS_RTU_SLAVE_CHUNK];
+    for(uint16_t off = 0; off < num; off += MODBUS_RTU_SLAVE_CHUNK)
+    {
+        uint16_t n = num - off < MODBUS_RTU_SLAVE_CHUNK ? num - off : MODBUS_RTU_SLAVE_CHUNK;
+        for(int i = 0; i < n; i++)
+        {
+            tmp[i] = (in[(off + i) / 8] >> ((off + i) % 8)) & 0x01;
+        }
+        uint8_t ex = modbus_rtu_slave_access(slave, MODBUS_RTU_TABLE_COIL, addr + off, n, tmp, 1);
+        if(ex != 0)
+        {
+            return ex;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief   write big-endian request registers
+ * @param   in: request data, num * 2 bytes
+*/
+static uint8_t modbus_rtu_slave_write_regs(modbus_rtu_slave_t *slave, uint16_t addr, uint16_t num, const uint8_t *in)
+{
+    uint16_t tmp[MODBUS_RTU_SLAVE_CHUNK];
+    for(uint16_t off = 0; off < num; off += MODBUS_RTU_SLAVE_CHUNK)
+    {
+        uint16_t n = num - off < MODBUS_RTU_SLAVE_CHUNK ? num - off : MODBUS_RTU_SLAVE_CHUNK;
+        for(int i = 0; i < n; i++)
+        {
+            tmp[i] = in[(off + i) * 2] << 8 | in[(off + i) * 2 + 1];
+        }
+        uint8_t ex = modbus_rtu_slave_access(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, addr + off, n, tmp, 1);
+        if(ex != 0)
+        {
+            return ex;
+        }
+    }
+    return 0;
+}
+
+/*
+ * function code handlers
+ * req: request pdu from the function code, len: pdu length
+ * rsp: response pdu after the function code, room: free bytes in rsp
+ * return 0 and set *rsp_len, or exception code
+ */
+typedef uint8_t (*p_rtu_slave_handler)(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len);
+
+/**
+ * @brief   read coils / discrete inputs, function code 0x01/0x02
+*/
+static uint8_t modbus_rtu_slave_fc_read_bits(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len)
+{
+    uint16_t addr = req[1] << 8 | req[2];
+    uint16_t num = req[3] << 8 | req[4];
+    uint8_t table = req[0] == MODBUS_RTU_FUNCTION_CODE_READ_COILS ? MODBUS_RTU_TABLE_COIL : MODBUS_RTU_TABLE_DISCRETE_INPUT;
+    if(len != 5 || num == 0 || num > 2000 || 1 + (num + 7) / 8 > room)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t ex = modbus_rtu_slave_check(slave, table, addr, num, 0);
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_read_bits(slave, table, addr, num, rsp + 1);
+    }
+    rsp[0] = (num + 7) / 8;
+    *rsp_len = 1 + rsp[0];
+    return ex;
+}
+
+/**
+ * @brief   read holding / input registers, function code 0x03/0x04
+*/
+static uint8_t modbus_rtu_slave_fc_read_regs(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len)
+{
+    uint16_t addr = req[1] << 8 | req[2];
+    uint16_t num = req[3] << 8 | req[4];
+    uint8_t table = req[0] == MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS ? MODBUS_RTU_TABLE_HOLDING_REGISTER : MODBUS_RTU_TABLE_INPUT_REGISTER;
+    if(len != 5 || num == 0 || num > 125 || 1 + num * 2 > room)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t ex = modbus_rtu_slave_check(slave, table, addr, num, 0);
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_read_regs(slave, table, addr, num, rsp + 1);
+    }
+    rsp[0] = num * 2;
+    *rsp_len = 1 + rsp[0];
+    return ex;
+}
+
+/**
+ * @brief   write single coil, function code 0x05
+*/
+static uint8_t modbus_rtu_slave_fc_write_single_coil(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len)
+{
+    uint16_t addr = req[1] << 8 | req[2];
+    uint16_t value = req[3] << 8 | req[4];
+    if(len != 5 || (value != 0xFF00 && value != 0x0000) || room < 4)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t ex = modbus_rtu_slave_check(slave, MODBUS_RTU_TABLE_COIL, addr, 1, 1);
+    if(ex == 0)
+    {
+        value = value ? 1 : 0;
+        ex = modbus_rtu_slave_access(slave, MODBUS_RTU_TABLE_COIL, addr, 1, &value, 1);
+    }
+    memcpy(rsp, req + 1, 4);
+    *rsp_len = 4;
+    return ex;
+}
+
+/**
+ * @brief   write single register, function code 0x06
+*/
+static uint8_t modbus_rtu_slave_fc_write_single_register(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len)
+{
+    uint16_t addr = req[1] << 8 | req[2];
+    if(len != 5 || room < 4)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t ex = modbus_rtu_slave_check(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, addr, 1, 1);
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_write_regs(slave, addr, 1, req + 3);
+    }
+    memcpy(rsp, req + 1, 4);
+    *rsp_len = 4;
+    return ex;
+}
+
+/**
+ * @brief   write multiple coils, function code 0x0F
+*/
+static uint8_t modbus_rtu_slave_fc_write_multiple_coils(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len)
+{
+    uint16_t addr = req[1] << 8 | req[2];
+    uint16_t num = req[3] << 8 | req[4];
+    if(len < 6 || num == 0 || num > 0x7B0 || req[5] != (num + 7) / 8 || len != 6 + req[5] || room < 4)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t ex = modbus_rtu_slave_check(slave, MODBUS_RTU_TABLE_COIL, addr, num, 1);
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_write_bits(slave, addr, num, req + 6);
+    }
+    memcpy(rsp, req + 1, 4);
+    *rsp_len = 4;
+    return ex;
+}
+
+/**
+ * @brief   write multiple registers, function code 0x10
+*/
+static uint8_t modbus_rtu_slave_fc_write_multiple_registers(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len)
+{
+    uint16_t addr = req[1] << 8 | req[2];
+    uint16_t num = req[3] << 8 | req[4];
+    if(len < 6 || num == 0 || num > 123 || req[5] != num * 2 || len != 6 + req[5] || room < 4)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t ex = modbus_rtu_slave_check(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, addr, num, 1);
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_write_regs(slave, addr, num, req + 6);
+    }
+    memcpy(rsp, req + 1, 4);
+    *rsp_len = 4;
+    return ex;
+}
+
+/**
+ * @brief   mask write register, function code 0x16
+*/
+static uint8_t modbus_rtu_slave_fc_write_mask_register(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len)
+{
+    uint16_t addr = req[1] << 8 | req[2];
+    uint16_t and_mask = req[3] << 8 | req[4];
+    uint16_t or_mask = req[5] << 8 | req[6];
+    uint16_t value;
+    if(len != 7 || room < 6)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t ex = modbus_rtu_slave_check(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, addr, 1, 1);
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_access(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, addr, 1, &value, 0);
+    }
+    if(ex == 0)
+    {
+        value = (value & and_mask) | (or_mask & ~and_mask);
+        ex = modbus_rtu_slave_access(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, addr, 1, &value, 1);
+    }
+    memcpy(rsp, req + 1, 6);
+    *rsp_len = 6;
+    return ex;
+}
+
+/**
+ * @brief   read/write multiple registers, function code 0x17, write before read
+*/
+static uint8_t modbus_rtu_slave_fc_write_and_read_registers(modbus_rtu_slave_t *slave, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t room, uint16_t *rsp_len)
+{
+    if(len < 10)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint16_t read_addr = req[1] << 8 | req[2];
+    uint16_t read_num = req[3] << 8 | req[4];
+    uint16_t write_addr = req[5] << 8 | req[6];
+    uint16_t write_num = req[7] << 8 | req[8];
+    if(read_num == 0 || read_num > 125 || write_num == 0 || write_num > 121
+        || req[9] != write_num * 2 || len != 10 + req[9] || 1 + read_num * 2 > room)
+    {
+        return MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t ex = modbus_rtu_slave_check(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, write_addr, write_num, 1);
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_check(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, read_addr, read_num, 0);
+    }
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_write_regs(slave, write_addr, write_num, req + 10);
+    }
+    if(ex == 0)
+    {
+        ex = modbus_rtu_slave_read_regs(slave, MODBUS_RTU_TABLE_HOLDING_REGISTER, read_addr, read_num, rsp + 1);
+    }
+    rsp[0] = read_num * 2;
+    *rsp_len = 1 + rsp[0];
+    return ex;
+}
+
+/* dispatch table, indexed by function code */
+static const p_rtu_slave_handler modbus_rtu_slave_handler[] =
+{
+    [MODBUS_RTU_FUNCTION_CODE_READ_COILS] = modbus_rtu_slave_fc_read_bits,
+    [MODBUS_RTU_FUNCTION_CODE_READ_DISCRETE_INPUTS] = modbus_rtu_slave_fc_read_bits,
+    [MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS] = modbus_rtu_slave_fc_read_regs,
+    [MODBUS_RTU_FUNCTION_CODE_READ_INPUT_REGISTERS] = modbus_rtu_slave_fc_read_regs,
+    [MODBUS_RTU_FUNCTION_CODE_WRITE_SINGLE_COIL] = modbus_rtu_slave_fc_write_single_coil,
+    [MODBUS_RTU_FUNCTION_CODE_WRITE_SINGLE_REGISTER] = modbus_rtu_slave_fc_write_single_register,
+    [MODBUS_RTU_FUNCTION_CODE_WRITE_MULTIPLE_COILS] = modbus_rtu_slave_fc_write_multiple_coils,
+    [MODBUS_RTU_FUNCTION_CODE_WRITE_MULTIPLE_REGISTERS] = modbus_rtu_slave_fc_write_multiple_registers,
+    [MODBUS_RTU_FUNCTION_CODE_WRITE_MASK_REGISTER] = modbus_rtu_slave_fc_write_mask_register,
+    [MODBUS_RTU_FUNCTION_CODE_WRITE_AND_READ_REGISTERS] = modbus_rtu_slave_fc_write_and_read_registers,
+};
+
+/**
+ * @brief   modbus rtu slave init
+ * @param   slave: modbus rtu slave
+ * @param   fun: function pointer, rx side
+ * @param   slave_addr: slave address
+ * @param   tx_get_buf: get the tx dma buffer, NULL to send by fun->rtu_hex_printf
+ * @param   tx_start: start tx dma
+ * @param   tx_len: tx buffer length, at least 5 bytes for an exception reply
+*/
+uint8_t modbus_rtu_slave_init(modbus_rtu_slave_t *slave, modbus_rtu_fun_t *fun, uint8_t slave_addr, p_rtu_tx_get_buf tx_get_buf, p_rtu_tx_start tx_start, uint16_t tx_len)
+{
+    if(tx_len < 5)
+    {
         return MODBUS_STATUS_PARMINVAL;
     }
+    memset(slave, 0, sizeof(modbus_rtu_slave_t));
+    slave->fun = fun;
+    slave->slave_addr = slave_addr;
+    slave->tx_get_buf = tx_get_buf;
+    slave->tx_start = tx_start;
+    slave->tx_len = tx_len;
     return MODBUS_STATUS_OK;
 }
 
-uint8_t modbus_rtu_slave_recv(modbus_rtu_fun_t *fun)
+/**
+ * @brief   map a region, regions of one table must not overlap
+ * @param   slave: modbus rtu slave
+ * @param   region: region, must stay valid
+*/
+void modbus_rtu_slave_region_add(modbus_rtu_slave_t *slave, modbus_rtu_region_t *region)
 {
+    region->next = slave->region;
+    slave->region = region;
+}
+
+/**
+ * @brief   handle a received frame, call in the uart idle interrupt or task
+ * @param   slave: modbus rtu slave
+ * @note    if tx_get_buf returns NULL the frame is kept and MODBUS_STATUS_ERROR returned
+*/
+uint8_t modbus_rtu_slave_poll(modbus_rtu_slave_t *slave)
+{
+    modbus_rtu_fun_t *fun = slave->fun;
     uint8_t *buf = fun->rtu_rx_get_buf();
     uint16_t len = fun->rtu_rx_get_len();
-    if(len < 4)
+    uint8_t addr = slave->addr_reg != NULL ? *slave->addr_reg : slave->slave_addr;
+    if(buf == NULL)
     {
-        fun->rtu_rx_reset();
         return MODBUS_STATUS_ERROR;
     }
-    uint16_t crc = modbus_rtu_crc16(buf, len - 2);
-    if(crc != (buf[len - 2] << 8 | buf[len - 1]))
+    if(len < 4 || modbus_rtu_crc16_update(MODBUS_CRC16_INIT, buf, len) != 0 || (buf[0] != addr && buf[0] != 0))
     {
         fun->rtu_rx_reset();
         return MODBUS_STATUS_ERROR;
     }
-    if(buf[0] != modbus_rtu_reg[0])
+    uint8_t *tx = slave->tx_get_buf != NULL ? slave->tx_get_buf() : slave->tx_buf;
+    if(tx == NULL)
     {
-        fun->rtu_rx_reset();
+        /* tx buffer busy, keep the frame and poll again */
         return MODBUS_STATUS_ERROR;
     }
-    modbus_rtu_slave_msg_t msg;
-    msg.function_code = buf[1];
-    msg.reg_addr = buf[2] << 8 | buf[3];
-    msg.reg_num = 0;
-    msg.data_len = len - 6;
-    memcpy(msg.data, buf + 4, msg.data_len);
-    modbus_rtu_slave_msg_anlaysis(&msg);
+    uint8_t function_code = buf[1];
+    uint16_t rsp_len = 0;
+    uint8_t ex = MODBUS_RTU_EXCEPTION_ILLEGAL_FUNCTION;
+    if(function_code < sizeof(modbus_rtu_slave_handler) / sizeof(modbus_rtu_slave_handler[0])
+        && modbus_rtu_slave_handler[function_code] != NULL)
+    {
+        /* pdu: function code .. last data byte, at least function code + 4 bytes */
+        ex = len < 8 ? MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_VALUE
+                     : modbus_rtu_slave_handler[function_code](slave, buf + 1, len - 3, tx + 2, slave->tx_len - 4, &rsp_len);
+    }
+    uint8_t broadcast = buf[0] == 0;
+    fun->rtu_rx_reset();
+    if(broadcast)
+    {
+        return ex == 0 ? MODBUS_STATUS_OK : MODBUS_STATUS_EXCEPTION;
+    }
+    tx[0] = addr;
+    if(ex == 0)
+    {
+        tx[1] = function_code;
+        rsp_len += 2;
+    }
+    else
+    {
+        tx[1] = function_code | 0x80;
+        tx[2] = ex;
+        rsp_len = 3;
+    }
+    uint16_t crc = modbus_rtu_crc16(tx, rsp_len);
+    tx[rsp_len] = crc >> 8;
+    tx[rsp_len + 1] = crc & 0xFF;
+    if(slave->tx_get_buf != NULL)
+    {
+        slave->tx_start(rsp_len + 2);
+    }
+    else
+    {
+        fun->rtu_hex_printf(tx, rsp_len + 2);
+    }
+    return ex == 0 ? MODBUS_STATUS_OK : MODBUS_STATUS_EXCEPTION;
+}
+
+static modbus_rtu_slave_t modbus_rtu_slave;
+static modbus_rtu_region_t modbus_rtu_slave_reg_region[2];
+static uint8_t modbus_rtu_slave_tx_buf[MODBUS_RTU_SEND_BUF_LEN];
+
+/**
+ * @brief   map holding and input registers onto one array
+ * @param   reg: registers, reg[0] is the slave address
+ * @param   reg_len: register number
+*/
+void modbus_rtu_slave_reg_init(uint16_t *reg, uint16_t reg_len)
+{
+    modbus_rtu_slave_init(&modbus_rtu_slave, NULL, 0, NULL, NULL, MODBUS_RTU_SEND_BUF_LEN);
+    modbus_rtu_slave.tx_buf = modbus_rtu_slave_tx_buf;
+    modbus_rtu_slave.addr_reg = &reg[0];
+    for(int i = 0; i < 2; i++)
+    {
+        memset(&modbus_rtu_slave_reg_region[i], 0, sizeof(modbus_rtu_region_t));
+        modbus_rtu_slave_reg_region[i].table = i == 0 ? MODBUS_RTU_TABLE_HOLDING_REGISTER : MODBUS_RTU_TABLE_INPUT_REGISTER;
+        modbus_rtu_slave_reg_region[i].num = reg_len;
+        modbus_rtu_slave_reg_region[i].value = reg;
+        modbus_rtu_slave_region_add(&modbus_rtu_slave, &modbus_rtu_slave_reg_region[i]);
+    }
+}
+
+/**
+ * @brief   handle a received frame with the registers set by modbus_rtu_slave_reg_init
+ * @param   fun: function pointer
+*/
+uint8_t modbus_rtu_slave_recv(modbus_rtu_fun_t *fun)
+{
+    modbus_rtu_slave.fun = fun;
+    return modbus_rtu_slave_poll(&modbus_rtu_slave);
 }
 
 #endif
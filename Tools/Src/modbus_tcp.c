@@ -0,0 +1,218 @@
+#include "modbus_tcp.h"
+#include "string.h"
+#include "trace_log.h"
+
+#define MODBUS_TCP_DEBUG 1
+#if MODBUS_TCP_DEBUG == 1
+#define MODBUS_TCP_LOG(fmt, ...) TRACE_LOG_TEXT(TRACE_MOD_MODBUS_TCP, TRACE_LEVEL_DEBUG, "[MODBUS_TCP] " fmt "\r\n", ##__VA_ARGS__)
+#else
+#define MODBUS_TCP_LOG(fmt, ...)
+#endif
+
+#if MODBUS_RTU_MASTER_MODE == 1
+
+/**
+ * @brief   send a mbap frame to the tcp side
+ * @param   gw: modbus tcp gateway
+ * @param   buf: frame buffer, pdu already placed after the mbap header
+ * @param   transaction_id: transaction id from the request
+ * @param   unit_id: unit id from the request
+ * @param   pdu_len: pdu length
+*/
+static void modbus_tcp_send(modbus_tcp_gateway_t *gw, uint8_t *buf, uint16_t transaction_id, uint8_t unit_id, uint16_t pdu_len)
+{
+    buf[0] = transaction_id >> 8;
+    buf[1] = transaction_id;
+    buf[2] = 0;
+    buf[3] = 0;
+    buf[4] = (pdu_len + 1) >> 8;
+    buf[5] = pdu_len + 1;
+    buf[6] = unit_id;
+    gw->net->rtu_hex_printf(buf, MODBUS_TCP_MBAP_LEN + pdu_len);
+}
+
+/**
+ * @brief   send an exception reply
+ * @param   gw: modbus tcp gateway
+ * @param   buf: frame buffer, at least MODBUS_TCP_MBAP_LEN + 2 bytes
+ * @param   exception: exception code
+*/
+static void modbus_tcp_send_exception(modbus_tcp_gateway_t *gw, uint8_t *buf, uint16_t transaction_id, uint8_t unit_id, uint8_t function_code, uint8_t exception)
+{
+    buf[MODBUS_TCP_MBAP_LEN] = function_code | 0x80;
+    buf[MODBUS_TCP_MBAP_LEN + 1] = exception;
+    modbus_tcp_send(gw, buf, transaction_id, unit_id, 2);
+}
+
+/**
+ * @brief   downstream rtu reply, called by the rtu master in interrupt context
+*/
+static void modbus_tcp_complete(uint8_t status, modbus_rtu_msg_t *msg, void *arg)
+{
+    modbus_tcp_txn_t *txn = (modbus_tcp_txn_t *)arg;
+    modbus_tcp_gateway_t *gw = txn->gw;
+    uint8_t *buf = gw->tx_buf;
+    if(txn->unit_id == 0)
+    {
+        /* broadcast, no reply */
+    }
+    else if(status == MODBUS_STATUS_OK || status == MODBUS_STATUS_EXCEPTION)
+    {
+        uint16_t pdu_len = modbus_rtu_msg_pdu_pack(msg, status == MODBUS_STATUS_EXCEPTION, buf + MODBUS_TCP_MBAP_LEN);
+        modbus_tcp_send(gw, buf, txn->transaction_id, txn->unit_id, pdu_len);
+    }
+    else
+    {
+        modbus_tcp_send_exception(gw, buf, txn->transaction_id, txn->unit_id, txn->function_code, MODBUS_TCP_EXCEPTION_GATEWAY_TARGET);
+    }
+    txn->used = 0;
+}
+
+/**
+ * @brief   forward one mbap frame downstream
+ * @param   gw: modbus tcp gateway
+ * @param   frame: mbap header + pdu
+ * @param   pdu_len: pdu length
+*/
+static void modbus_tcp_forward(modbus_tcp_gateway_t *gw, const uint8_t *frame, uint16_t pdu_len)
+{
+    uint16_t transaction_id = frame[0] << 8 | frame[1];
+    uint8_t unit_id = frame[6];
+    uint8_t function_code = frame[7];
+    uint8_t buf[MODBUS_TCP_MBAP_LEN + 2];
+    if(pdu_len > MODBUS_TCP_PDU_MAX_LEN)
+    {
+        modbus_tcp_send_exception(gw, buf, transaction_id, unit_id, function_code, MODBUS_TCP_EXCEPTION_ILLEGAL_DATA_VALUE);
+        return;
+    }
+    modbus_tcp_txn_t *txn = NULL;
+    for(int i = 0; i < MODBUS_TCP_TXN_NUM; i++)
+    {
+        if(!gw->txn[i].used)
+        {
+            txn = &gw->txn[i];
+            break;
+        }
+    }
+    if(txn == NULL)
+    {
+        modbus_tcp_send_exception(gw, buf, transaction_id, unit_id, function_code, MODBUS_TCP_EXCEPTION_BUSY);
+        return;
+    }
+    txn->transaction_id = transaction_id;
+    txn->unit_id = unit_id;
+    txn->function_code = function_code;
+    txn->used = 1;
+    /* rtu frame: unit id as slave address + pdu */
+    uint8_t status = modbus_rtu_master_submit(gw->master, (uint8_t *)frame + 6, pdu_len + 1, gw->master->timeout_ms,
+                                              gw->master->retry, modbus_tcp_complete, txn);
+    if(status != MODBUS_STATUS_OK)
+    {
+        txn->used = 0;
+        modbus_tcp_send_exception(gw, buf, transaction_id, unit_id, function_code, MODBUS_TCP_EXCEPTION_BUSY);
+        return;
+    }
+    gw->frame_count++;
+}
+
+/**
+ * @brief   modbus tcp gateway init
+ * @param   gw: modbus tcp gateway
+ * @param   master: downstream rtu master, see modbus_rtu_master_init
+ * @param   net: upstream transparent link, e.g. the USR-TCP232 uart
+*/
+void modbus_tcp_gateway_init(modbus_tcp_gateway_t *gw, modbus_rtu_master_t *master, modbus_rtu_fun_t *net)
+{
+    memset(gw, 0, sizeof(modbus_tcp_gateway_t));
+    gw->master = master;
+    gw->net = net;
+    for(int i = 0; i < MODBUS_TCP_TXN_NUM; i++)
+    {
+        gw->txn[i].gw = gw;
+    }
+}
+
+/**
+ * @brief   feed bytes received from the tcp stream
+ * @param   gw: modbus tcp gateway
+ * @param   data: received bytes, frames may be split or merged
+ * @param   len: byte number
+ * @return  number of frames forwarded
+*/
+uint8_t modbus_tcp_gateway_input(modbus_tcp_gateway_t *gw, const uint8_t *data, uint16_t len)
+{
+    uint8_t count = 0;
+    while(len != 0)
+    {
+        if(gw->rx_skip != 0)
+        {
+            uint16_t skip = gw->rx_skip < len ? gw->rx_skip : len;
+            gw->rx_skip -= skip;
+            data += skip;
+            len -= skip;
+            continue;
+        }
+        uint16_t n = MODBUS_TCP_RX_BUF_LEN - gw->rx_len;
+        if(n > len)
+        {
+            n = len;
+        }
+        memcpy(gw->rx_buf + gw->rx_len, data, n);
+        gw->rx_len += n;
+        data += n;
+        len -= n;
+        while(gw->rx_len >= MODBUS_TCP_MBAP_LEN)
+        {
+            uint8_t *frame = gw->rx_buf;
+            uint16_t protocol_id = frame[2] << 8 | frame[3];
+            uint16_t length = frame[4] << 8 | frame[5];
+            if(protocol_id != 0 || length < 2 || length > 254)
+            {
+                /* not a mbap header, resync on the next byte */
+                gw->drop_count++;
+                memmove(gw->rx_buf, gw->rx_buf + 1, --gw->rx_len);
+                continue;
+            }
+            if(length - 1 > MODBUS_TCP_PDU_MAX_LEN)
+            {
+                /* too long to buffer, reject and skip the rest of the frame */
+                if(gw->rx_len <= MODBUS_TCP_MBAP_LEN)
+                {
+                    break;//wait for the function code
+                }
+                modbus_tcp_forward(gw, frame, length - 1);
+                gw->rx_skip = 6 + length - gw->rx_len;
+                gw->rx_len = 0;
+                break;
+            }
+            if(gw->rx_len < 6 + length)
+            {
+                break;
+            }
+            modbus_tcp_forward(gw, frame, length - 1);
+            count++;
+            gw->rx_len -= 6 + length;
+            memmove(gw->rx_buf, gw->rx_buf + 6 + length, gw->rx_len);
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief   read the upstream link and forward complete frames
+ * @param   gw: modbus tcp gateway
+ * @return  number of frames forwarded
+*/
+uint8_t modbus_tcp_gateway_poll(modbus_tcp_gateway_t *gw)
+{
+    uint8_t *buf = gw->net->rtu_rx_get_buf();
+    if(buf == NULL)
+    {
+        return 0;
+    }
+    uint8_t count = modbus_tcp_gateway_input(gw, buf, gw->net->rtu_rx_get_len());
+    gw->net->rtu_rx_reset();
+    return count;
+}
+
+#endif /* MODBUS_RTU_MASTER_MODE */
@@ -1,4 +1,5 @@
 #include "rtc_utx.h"
+#include "trace_log.h"
 #include "rtc.h"
 #include <time.h>
 #if EXTERNAL_RTC == 1
@@ -6,9 +7,11 @@
 #endif
 
 #if RTC_UTX_DEBUG == 1
-#define RTC_UTX_LOG(fmt, ...) printf("[RTC UTX] " fmt "\r\n", ##__VA_ARGS__)
+#define RTC_UTX_LOG(fmt, ...) TRACE_LOG_OUT(TRACE_MOD_RTC, TRACE_LEVEL_DEBUG, "[RTC UTX] " fmt "\r\n", ##__VA_ARGS__)
+#define RTC_UTX_LOG_ERR(fmt, ...) TRACE_LOG_OUT(TRACE_MOD_RTC, TRACE_LEVEL_ERROR, "[RTC UTX] " fmt "\r\n", ##__VA_ARGS__)
 #else
 #define RTC_UTX_LOG(fmt, ...)
+#define RTC_UTX_LOG_ERR(fmt, ...)
 #endif
 
 static HAL_StatusTypeDef sync_pcf8563_to_rtc(Times *time_c);
@@ -200,14 +203,14 @@ time_t get_uts(void)
   
   if(PCF8563_GetTime(&pcf_time) != PCF8563_OK) {
     // PCF8563读取失败，尝试使用内部RTC
-    RTC_UTX_LOG("PCF8563 Get Time Error\r\n");
+    RTC_UTX_LOG_ERR("PCF8563 Get Time Error\r\n");
   }
   
   // 检查电压低标志
   if(PCF8563_CheckVL())
   {
     // 电压低，时间不可靠，使用内部RTC
-    RTC_UTX_LOG("PCF8563 Voltage Low\r\n");
+    RTC_UTX_LOG_ERR("PCF8563 Voltage Low\r\n");
   }
   
   // if(vl_flag) {
@@ -0,0 +1,218 @@
+#include "main.h"
+#include "trace_log.h"
+#include "usart_printf.h"
+#include "string.h"
+
+#define TRACE_LOG_ENTER_CRITICAL() uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define TRACE_LOG_EXIT_CRITICAL() __set_PRIMASK(primask)
+
+#if PRINTF_FPUTC_MODE == 0
+#define TRACE_LOG_OUTPUT(buf, len) printf_tx_write(buf, len)//非阻塞发送缓冲
+#define TRACE_LOG_OUT_ENABLE() debug_out_get()
+#else
+static uint16_t trace_log_fputc(const uint8_t *buf, uint16_t len)
+{
+    for(uint16_t i = 0; i < len; i++)
+    {
+        fputc(buf[i], stdout);
+    }
+    return len;
+}
+#define TRACE_LOG_OUTPUT(buf, len) trace_log_fputc(buf, len)
+#define TRACE_LOG_OUT_ENABLE() 1
+#endif
+
+/* 同步字节+长度+时间差(最多5字节)+ID(最多5字节)+参数(每个最多5字节) */
+#define TRACE_LOG_RECORD_MAX (2 + 5 + 5 + TRACE_LOG_ARG_MAX * 5)
+
+static uint32_t trace_log_last_tick = 0;
+static uint32_t trace_log_drop = 0;
+
+#define TRACE_MOD_MASK_ALL ((1UL << TRACE_MOD_NUM) - 1)
+
+volatile uint32_t trace_log_mask[TRACE_LEVEL_NUM] =
+{
+    0,//TRACE_LEVEL_OFF不输出
+    (TRACE_LOG_DEFAULT_LEVEL >= TRACE_LEVEL_ERROR) ? TRACE_MOD_MASK_ALL : 0,
+    (TRACE_LOG_DEFAULT_LEVEL >= TRACE_LEVEL_WARN) ? TRACE_MOD_MASK_ALL : 0,
+    (TRACE_LOG_DEFAULT_LEVEL >= TRACE_LEVEL_INFO) ? TRACE_MOD_MASK_ALL : 0,
+    (TRACE_LOG_DEFAULT_LEVEL >= TRACE_LEVEL_DEBUG) ? TRACE_MOD_MASK_ALL : 0,
+};
+
+/**
+ * @brief  模块名称表,序号与trace_module_t一致,用于配置命令
+ */
+static const char *trace_log_module_name[TRACE_MOD_NUM] =
+{
+    "SYS", "RTC", "TIMINGTASK", "MODBUS_RTU", "MODBUS_TCP", "AT",
+};
+
+/**
+ * @brief  写入无符号变长数,每字节低7位有效,最高位为1表示后续还有字节
+ * @retval 写入字节数
+ */
+static uint8_t trace_log_put_varint(uint8_t *buf, uint32_t value)
+{
+    uint8_t len = 0;
+
+    while(value >= 0x80)
+    {
+        buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[len++] = (uint8_t)value;
+    return len;
+}
+
+/**
+ * @brief  输出一条二进制日志,由TRACE_LOG调用
+ * @param  fmt: 格式串地址,作为ID
+ * @param  arg: 参数
+ * @param  num: 参数个数,超过TRACE_LOG_ARG_MAX的部分丢弃
+ * @note   可在中断中调用;经printf_tx_write写入发送缓冲,不等待发送
+ */
+void trace_log_write(const char *fmt, const int32_t *arg, uint8_t num)
+{
+    uint8_t record[TRACE_LOG_RECORD_MAX];
+    uint8_t len = 2;
+    uint32_t tick;
+
+    if(TRACE_LOG_OUT_ENABLE() == 0)
+    {
+        return;
+    }
+    if(num > TRACE_LOG_ARG_MAX)
+    {
+        num = TRACE_LOG_ARG_MAX;
+    }
+    record[0] = TRACE_LOG_SYNC;
+    len += 5;//时间差在临界区内填写,先写ID和参数
+    len += trace_log_put_varint(&record[len], (uint32_t)(uintptr_t)fmt - TRACE_LOG_ID_BASE);
+    for(uint8_t i = 0; i < num; i++)
+    {
+        len += trace_log_put_varint(&record[len], ((uint32_t)arg[i] << 1) ^ (uint32_t)(arg[i] >> 31));//zigzag
+    }
+
+    //时间差与写入须在同一临界区,保证记录顺序与时间差一致
+    TRACE_LOG_ENTER_CRITICAL();
+    tick = HAL_GetTick();
+    uint8_t tick_len = trace_log_put_varint(&record[2], tick - trace_log_last_tick);
+    if(tick_len < 5)
+    {
+        memmove(&record[2 + tick_len], &record[7], len - 7);
+        len -= 5 - tick_len;
+    }
+    record[1] = len - 2;
+    if(TRACE_LOG_OUTPUT(record, len) == len)
+    {
+        trace_log_last_tick = tick;
+    }
+    else
+    {
+        trace_log_drop++;
+    }
+    TRACE_LOG_EXIT_CRITICAL();
+}
+
+/**
+ * @brief  获取因发送缓冲满而丢弃的记录数
+ */
+uint32_t trace_log_overflow(void)
+{
+    return trace_log_drop;
+}
+
+/**
+ * @brief  设置模块日志等级
+ * @param  module: trace_module_t,TRACE_MOD_ALL为全部模块
+ * @param  level: trace_level_t,输出不高于此等级的日志
+ */
+void trace_log_level_set(uint8_t module, uint8_t level)
+{
+    uint32_t bits;
+
+    if(module == TRACE_MOD_ALL)
+    {
+        bits = TRACE_MOD_MASK_ALL;
+    }
+    else if(module < TRACE_MOD_NUM)
+    {
+        bits = 1UL << module;
+    }
+    else
+    {
+        return;
+    }
+    TRACE_LOG_ENTER_CRITICAL();
+    for(uint8_t i = TRACE_LEVEL_ERROR; i < TRACE_LEVEL_NUM; i++)
+    {
+        if(i <= level)
+        {
+            trace_log_mask[i] |= bits;
+        }
+        else
+        {
+            trace_log_mask[i] &= ~bits;
+        }
+    }
+    TRACE_LOG_EXIT_CRITICAL();
+}
+
+/**
+ * @brief  获取模块日志等级
+ * @param  module: trace_module_t
+ * @retval trace_level_t
+ */
+uint8_t trace_log_level_get(uint8_t module)
+{
+    uint8_t level = TRACE_LEVEL_OFF;
+
+    if(module >= TRACE_MOD_NUM)
+    {
+        return TRACE_LEVEL_OFF;
+    }
+    for(uint8_t i = TRACE_LEVEL_ERROR; i < TRACE_LEVEL_NUM; i++)
+    {
+        if(trace_log_mask[i] & (1UL << module))
+        {
+            level = i;
+        }
+    }
+    return level;
+}
+
+/**
+ * @brief  解析日志等级配置命令
+ * @param  cmd: "模块名,等级",如"MODBUS_RTU,4"、"ALL,0",等级0-关闭 1-错误 2-警告 3-信息 4-调试
+ * @retval 0-成功 1-模块名或等级无效
+ * @note   在任务中调用,由printf_config_poll处理"CONFIG LOG="命令时调用
+ */
+uint8_t trace_log_config(const char *cmd)
+{
+    const char *comma = strchr(cmd, ',');
+    uint8_t module = TRACE_MOD_NUM;
+    uint8_t name_len;
+
+    if(comma == NULL || comma[1] < '0' || comma[1] >= '0' + TRACE_LEVEL_NUM)
+    {
+        return 1;
+    }
+    name_len = comma - cmd;
+    if(name_len == 3 && strncmp(cmd, "ALL", 3) == 0)
+    {
+        module = TRACE_MOD_ALL;
+    }
+    for(uint8_t i = 0; i < TRACE_MOD_NUM && module == TRACE_MOD_NUM; i++)
+    {
+        if(strlen(trace_log_module_name[i]) == name_len && strncmp(cmd, trace_log_module_name[i], name_len) == 0)
+        {
+            module = i;
+        }
+    }
+    if(module == TRACE_MOD_NUM)
+    {
+        return 1;
+    }
+    trace_log_level_set(module, comma[1] - '0');
+    return 0;
+}
@@ -0,0 +1,629 @@
+#include "main.h"
+#include "stdarg.h"
+#include "string.h"
+#include "sys_delay.h"
+#include "uart_port.h"
+#include "at_cmd_tools.h"
+#include "modbus_rtu.h"
+
+#if UART_PORT_NUM > 4
+#error "UART_PORT_NUM must not exceed 4, add uart_port thunks for more ports"
+#endif
+
+#define UART_PORT_ENTER_CRITICAL() uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define UART_PORT_EXIT_CRITICAL() __set_PRIMASK(primask)
+
+static uart_port_t uart_port[UART_PORT_NUM];
+
+/**
+ * @brief  注册并启动端口
+ * @param  id: 端口号,0 ~ UART_PORT_NUM-1
+ * @param  config: 端口参数,缓冲区由调用者静态分配
+ * @retval 端口句柄,参数错误时为NULL
+ * @note   在MX_USARTx_UART_Init与DMA初始化之后调用,重复注册将清空端口缓冲
+ */
+uart_port_t *uart_port_register(uint8_t id, const uart_port_config_t *config)
+{
+    uart_port_t *port;
+
+    if(id >= UART_PORT_NUM || config == NULL || config->huart == NULL || config->hdma_rx == NULL ||
+       config->rx_buf == NULL || config->rx_size < 2 || config->tx_buf == NULL ||
+       config->tx_size == 0 || (config->tx_size & (config->tx_size - 1)) != 0)
+    {
+        return NULL;
+    }
+    if(config->rx_mode == UART_PORT_RX_RING && (config->rx_line == NULL || config->rx_line_size < 2))
+    {
+        return NULL;
+    }
+    port = &uart_port[id];
+    memset(port, 0, sizeof(uart_port_t));
+    port->id = id;
+    port->rx_mode = config->rx_mode;
+    port->rx_line = config->rx_line;
+    port->rx_line_size = config->rx_line_size;
+    port->tx_buf = config->tx_buf;
+    port->tx_size = config->tx_size;
+    port->tx_policy = config->tx_policy;
+    port->hdma_rx = config->hdma_rx;
+    __HAL_UART_ENABLE_IT(config->huart, UART_IT_IDLE);
+    if(port->rx_mode == UART_PORT_RX_RING)
+    {
+        uart_ring_init(&port->rx_ring, config->rx_buf, config->rx_size);
+        HAL_UART_Receive_DMA(config->huart, config->rx_buf, config->rx_size);
+    }
+    else
+    {
+        port->rx_frame.buf = config->rx_buf;
+        port->rx_size = config->rx_size - 1;//保留'\0'
+        HAL_UART_Receive_DMA(config->huart, config->rx_buf, port->rx_size);
+    }
+    port->huart = config->huart;//最后赋值,此前中断分发不会找到该端口
+    return port;
+}
+
+/**
+ * @brief  获取已注册的端口
+ * @param  id: 端口号
+ * @retval 端口句柄,未注册时为NULL
+ */
+uart_port_t *uart_port_get(uint8_t id)
+{
+    if(id >= UART_PORT_NUM || uart_port[id].huart == NULL)
+    {
+        return NULL;
+    }
+    return &uart_port[id];
+}
+
+/**
+ * @brief  按串口句柄查找端口,端口数很少,顺序查找即可
+ */
+static uart_port_t *uart_port_find(UART_HandleTypeDef *huart)
+{
+    for(uint8_t i = 0; i < UART_PORT_NUM; i++)
+    {
+        if(uart_port[i].huart == huart)
+        {
+            return &uart_port[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief  串口中断中调用,处理过载与空闲中断
+ * @param  huart: 串口句柄,未注册的串口直接返回
+ */
+void uart_port_irq(UART_HandleTypeDef *huart)
+{
+    uart_port_t *port = uart_port_find(huart);
+
+    if(port == NULL)
+    {
+        return;
+    }
+    if(port->rx_mode == UART_PORT_RX_RING)
+    {
+        uart_ring_irq(huart, port->hdma_rx, &port->rx_ring);
+    }
+    else
+    {
+        uart_irq(huart, port->hdma_rx, &port->rx_frame, port->rx_size);
+    }
+}
+
+/**
+ * @brief  DMA接收半满/满回调中调用,仅环形模式需要
+ * @param  huart: 串口句柄
+ */
+void uart_port_rx_dma_irq(UART_HandleTypeDef *huart)
+{
+    uart_port_t *port = uart_port_find(huart);
+
+    if(port != NULL && port->rx_mode == UART_PORT_RX_RING)
+    {
+        uart_ring_dma_irq(port->hdma_rx, &port->rx_ring);
+    }
+}
+
+/**
+ * @brief  DMA发送完成回调中调用,回收已发送段并发送下一段
+ * @param  huart: 串口句柄
+ */
+void uart_port_tx_cplt(UART_HandleTypeDef *huart)
+{
+    uart_port_t *port = uart_port_find(huart);
+
+    if(port != NULL)
+    {
+        uart_port_tx_kick(port);
+    }
+}
+
+/**
+ * @brief  启动下一段DMA发送,需在临界区内调用
+ * @note   DMA空闲时按剩余计数回收上一段已发出的数据,再发送tail起的最大连续段(不跨越缓冲末尾)
+ */
+static void uart_port_tx_start(uart_port_t *port)
+{
+    uint32_t index;
+    uint32_t len;
+    uint32_t remain = 0;
+
+    if(port->tx_dma_len != 0)
+    {
+        if(port->huart->gState != HAL_UART_STATE_READY)
+        {
+            return;
+        }
+        //未调用uart_port_tx_cplt时由此回收;发送被中止时只回收已发出部分,余下数据重新发送
+        if(port->huart->hdmatx != NULL)
+        {
+            remain = __HAL_DMA_GET_COUNTER(port->huart->hdmatx);
+        }
+        if(remain > port->tx_dma_len)
+        {
+            remain = 0;
+        }
+        port->tx_tail += port->tx_dma_len - remain;
+        port->tx_dma_len = 0;
+    }
+    len = port->tx_head - port->tx_tail;
+    if(len == 0)
+    {
+        return;
+    }
+    index = port->tx_tail & (port->tx_size - 1);
+    if(len > port->tx_size - index)
+    {
+        len = port->tx_size - index;
+    }
+    if(HAL_UART_Transmit_DMA(port->huart, &port->tx_buf[index], len) == HAL_OK)
+    {
+        port->tx_dma_len = len;
+    }
+}
+
+/**
+ * @brief  回收已发送数据并继续发送
+ * @param  port: 端口
+ */
+void uart_port_tx_kick(uart_port_t *port)
+{
+    if(port == NULL || port->huart == NULL)
+    {
+        return;
+    }
+    UART_PORT_ENTER_CRITICAL();
+    uart_port_tx_start(port);
+    UART_PORT_EXIT_CRITICAL();
+}
+
+/**
+ * @brief  写入端口发送缓冲,不等待发送完成
+ * @param  port: 端口
+ * @param  data: 数据
+ * @param  len: 长度
+ * @retval 写入长度,缓冲满时按tx_policy处理,丢弃字节数计入uart_port_tx_overflow
+ * @note   单次写入整体写入或整体丢弃(丢弃最早策略下保证完整写入新数据)
+ * @note   UART_PORT_TX_BLOCK仅在任务中等待;中断中或已关中断时等待会死锁,改为丢弃新数据并计数
+ */
+uint16_t uart_port_write(uart_port_t *port, const uint8_t *data, uint16_t len)
+{
+    uint32_t index;
+    uint32_t first;
+    uint32_t free;
+
+    if(port == NULL || port->huart == NULL || len == 0 || len > port->tx_size)
+    {
+        return 0;
+    }
+    while(1)
+    {
+        UART_PORT_ENTER_CRITICAL();
+        free = port->tx_size - (port->tx_head - port->tx_tail);
+        if(free < len && port->tx_policy == UART_PORT_TX_BLOCK && primask == 0 && __get_IPSR() == 0)
+        {
+            uart_port_tx_start(port);
+            UART_PORT_EXIT_CRITICAL();
+            sys_delay_us(10);
+            continue;
+        }
+        if(free < len && port->tx_policy == UART_PORT_TX_DROP_OLDEST &&
+           (port->tx_head - port->tx_tail - port->tx_dma_len) >= len - free)
+        {
+            //正在发送的段不可丢弃,丢弃其后最早的数据(延伸至行尾,避免输出半行)并将余下数据前移
+            uint32_t dst = port->tx_tail + port->tx_dma_len;
+            uint32_t src = dst + (len - free);
+            uint32_t keep;
+
+            while(src != port->tx_head && port->tx_buf[(src - 1) & (port->tx_size - 1)] != '\n')
+            {
+                src++;
+            }
+            keep = port->tx_head - src;
+            port->tx_drop += src - dst;
+            if(port->tx_dma_len == 0)
+            {
+                port->tx_tail = src;
+            }
+            else
+            {
+                for(uint32_t i = 0; i < keep; i++)
+                {
+                    port->tx_buf[(dst + i) & (port->tx_size - 1)] = port->tx_buf[(src + i) & (port->tx_size - 1)];
+                }
+                port->tx_head = dst + keep;
+            }
+            free = port->tx_size - (port->tx_head - port->tx_tail);
+        }
+        if(free < len)
+        {
+            port->tx_drop += len;
+            UART_PORT_EXIT_CRITICAL();
+            return 0;
+        }
+        index = port->tx_head & (port->tx_size - 1);
+        first = port->tx_size - index;
+        if(first > len)
+        {
+            first = len;
+        }
+        memcpy(&port->tx_buf[index], data, first);
+        memcpy(port->tx_buf, &data[first], len - first);
+        port->tx_head += len;
+        uart_port_tx_start(port);
+        UART_PORT_EXIT_CRITICAL();
+        return len;
+    }
+}
+
+/**
+ * @brief  格式化输出至端口
+ * @param  port: 端口
+ * @param  fmt: 格式串
+ * @param  ap: 参数列表
+ * @retval 0-成功 1-失败或被丢弃
+ */
+static uint8_t uart_port_vprintf(uart_port_t *port, const char *fmt, va_list ap)
+{
+    char line[UART_PORT_LINE_LEN];
+    int len;
+
+    len = vsnprintf(line, sizeof(line), fmt, ap);
+    if(len <= 0)
+    {
+        return 1;
+    }
+    if(len >= (int)sizeof(line))
+    {
+        len = sizeof(line) - 1;
+    }
+    return (uart_port_write(port, (const uint8_t *)line, len) == len) ? 0 : 1;
+}
+
+/**
+ * @brief  格式化输出至端口
+ * @param  port: 端口
+ * @param  fmt: 格式串
+ * @retval 0-成功 1-失败或被丢弃
+ */
+uint8_t uart_port_printf(uart_port_t *port, const char *fmt, ...)
+{
+    va_list ap;
+    uint8_t ret;
+
+    va_start(ap, fmt);
+    ret = uart_port_vprintf(port, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
+/**
+ * @brief  阻塞等待端口发送缓冲发送完毕,用于复位、休眠或切换波特率前
+ * @param  port: 端口
+ */
+void uart_port_tx_flush(uart_port_t *port)
+{
+    if(port == NULL || port->huart == NULL)
+    {
+        return;
+    }
+    while(1)
+    {
+        UART_PORT_ENTER_CRITICAL();
+        uart_port_tx_start(port);
+        if(port->tx_head == port->tx_tail)
+        {
+            UART_PORT_EXIT_CRITICAL();
+            return;
+        }
+        UART_PORT_EXIT_CRITICAL();
+        sys_delay_us(10);
+    }
+}
+
+/**
+ * @brief  获取发送缓冲满时丢弃的累计字节数
+ * @param  port: 端口
+ */
+uint32_t uart_port_tx_overflow(uart_port_t *port)
+{
+    return (port == NULL) ? 0 : port->tx_drop;
+}
+
+/**
+ * @brief  获取最早一帧的连续数据
+ * @param  port: 端口
+ * @param  copy: 1-总是拷贝至rx_line并以'\0'结尾 0-未跨越缓冲末尾时直接指向环形缓冲
+ * @param  len: 数据长度
+ * @retval 数据指针,无帧时为NULL
+ */
+static const uint8_t *uart_port_rx_peek(uart_port_t *port, uint8_t copy, uint16_t *len)
+{
+    uart_rx_span span;
+
+    if(port->rx_mode != UART_PORT_RX_RING)
+    {
+        *len = uart_rx_get_len(port->rx_frame);
+        return uart_rx_get_buf(&port->rx_frame);//写入'\0',无需拷贝
+    }
+    if(port->rx_line_ready)
+    {
+        *len = port->rx_line_len;
+        return port->rx_line;
+    }
+    if(uart_ring_peek(&port->rx_ring, &span) == 0)
+    {
+        return NULL;
+    }
+    if(copy == 0 && span.len[1] == 0)
+    {
+        *len = span.len[0];
+        return span.data[0];
+    }
+    port->rx_line_len = uart_rx_span_copy(&span, port->rx_line, port->rx_line_size);
+    port->rx_line_ready = 1;//同一帧重复读取时不再拷贝
+    *len = port->rx_line_len;
+    return port->rx_line;
+}
+
+/**
+ * @brief  获取最早一帧,以'\0'结尾,供按字符串处理的调用者使用
+ * @param  port: 端口
+ * @retval 数据指针,无帧时为NULL;调用uart_port_rx_reset前有效
+ * @note   帧模式直接返回DMA缓冲;环形模式每帧拷贝一次至rx_line,超出rx_line_size时截断
+ */
+uint8_t *uart_port_rx_buf(uart_port_t *port)
+{
+    uint16_t len;
+
+    if(port == NULL || port->huart == NULL)
+    {
+        return NULL;
+    }
+    return (uint8_t *)uart_port_rx_peek(port, 1, &len);
+}
+
+/**
+ * @brief  获取最早一帧的长度
+ * @param  port: 端口
+ * @retval 数据长度,无帧时为0
+ */
+uint16_t uart_port_rx_len(uart_port_t *port)
+{
+    uart_rx_span span;
+
+    if(port == NULL || port->huart == NULL)
+    {
+        return 0;
+    }
+    if(port->rx_mode != UART_PORT_RX_RING)
+    {
+        return uart_rx_get_len(port->rx_frame);
+    }
+    if(port->rx_line_ready)
+    {
+        return port->rx_line_len;
+    }
+    if(uart_ring_peek(&port->rx_ring, &span) == 0)
+    {
+        return 0;
+    }
+    if(span.len[0] + span.len[1] > port->rx_line_size - 1)
+    {
+        return port->rx_line_size - 1;//与uart_port_rx_buf拷贝截断后的长度一致
+    }
+    return span.len[0] + span.len[1];
+}
+
+/**
+ * @brief  释放最早一帧
+ * @param  port: 端口
+ * @note   环形模式下后续帧保留,依次读取
+ */
+void uart_port_rx_reset(uart_port_t *port)
+{
+    if(port == NULL || port->huart == NULL)
+    {
+        return;
+    }
+    if(port->rx_mode == UART_PORT_RX_RING)
+    {
+        port->rx_line_ready = 0;
+        uart_ring_release(&port->rx_ring);
+    }
+    else
+    {
+        uart_rx_reset(&port->rx_frame);
+    }
+}
+
+/**
+ * @brief  设置接收回调,由uart_port_poll分发
+ * @param  port: 端口
+ * @param  handler: 接收回调,为NULL时uart_port_poll不处理该端口
+ * @param  arg: 透传参数
+ * @note   设置回调后不可再在同一端口使用uart_port_rx_buf读取(如阻塞的at_cmd_send)
+ */
+void uart_port_set_rx(uart_port_t *port, p_uart_port_rx handler, void *arg)
+{
+    if(port == NULL)
+    {
+        return;
+    }
+    port->rx_arg = arg;
+    port->rx_handler = handler;
+}
+
+/**
+ * @brief  将已接收的帧依次交给接收回调,于主循环或任务中调用
+ * @param  port: 端口
+ * @note   环形模式下未跨越缓冲末尾的帧直接传递环形缓冲中的数据,不拷贝
+ */
+void uart_port_poll(uart_port_t *port)
+{
+    const uint8_t *data;
+    uint16_t len;
+
+    if(port == NULL || port->huart == NULL || port->rx_handler == NULL)
+    {
+        return;
+    }
+    while((data = uart_port_rx_peek(port, 0, &len)) != NULL)
+    {
+        port->rx_handler(data, len, port->rx_arg);
+        uart_port_rx_reset(port);
+        if(port->rx_mode != UART_PORT_RX_RING)
+        {
+            break;//帧模式只有一帧
+        }
+    }
+}
+
+/* 协议栈绑定:at_device_t与modbus_rtu_fun_t的函数指针无上下文参数,按端口号生成转发函数 */
+
+#define UART_PORT_THUNK_DEFINE(n) \
+static uint8_t uart_port##n##_printf(char *fmt, ...) \
+{ \
+    va_list ap; \
+    uint8_t ret; \
+    va_start(ap, fmt); \
+    ret = uart_port_vprintf(&uart_port[n], fmt, ap); \
+    va_end(ap); \
+    return ret; \
+} \
+static uint8_t uart_port##n##_hex_printf(uint8_t *buf, uint16_t len) \
+{ \
+    return (uart_port_write(&uart_port[n], buf, len) == len) ? 0 : 1; \
+} \
+static void uart_port##n##_rx_reset(void) \
+{ \
+    uart_port_rx_reset(&uart_port[n]); \
+} \
+static uint8_t *uart_port##n##_rx_buf(void) \
+{ \
+    return uart_port_rx_buf(&uart_port[n]); \
+} \
+static uint16_t uart_port##n##_rx_len(void) \
+{ \
+    return uart_port_rx_len(&uart_port[n]); \
+}
+
+#define UART_PORT_THUNK(n) {uart_port##n##_printf, uart_port##n##_hex_printf, uart_port##n##_rx_reset, uart_port##n##_rx_buf, uart_port##n##_rx_len}
+
+typedef struct
+{
+    p_printf_cmd printf;
+    p_hex_printf_cmd hex_printf;
+    p_ack_restart rx_reset;
+    p_get_buf rx_buf;
+    p_rtu_rx_get_len rx_len;
+}uart_port_thunk_t;
+
+UART_PORT_THUNK_DEFINE(0)
+#if UART_PORT_NUM > 1
+UART_PORT_THUNK_DEFINE(1)
+#endif
+#if UART_PORT_NUM > 2
+UART_PORT_THUNK_DEFINE(2)
+#endif
+#if UART_PORT_NUM > 3
+UART_PORT_THUNK_DEFINE(3)
+#endif
+
+static const uart_port_thunk_t uart_port_thunk[UART_PORT_NUM] =
+{
+    UART_PORT_THUNK(0),
+#if UART_PORT_NUM > 1
+    UART_PORT_THUNK(1),
+#endif
+#if UART_PORT_NUM > 2
+    UART_PORT_THUNK(2),
+#endif
+#if UART_PORT_NUM > 3
+    UART_PORT_THUNK(3),
+#endif
+};
+
+/**
+ * @brief  异步AT引擎接收适配,arg为at_device_t
+ */
+static void uart_port_at_engine_rx(const uint8_t *data, uint16_t len, void *arg)
+{
+    at_engine_rx_input((at_device_t *)arg, data, len);
+}
+
+/**
+ * @brief  AT设备绑定端口,替代各模块自行实现的printf/rx_reset/rx_buf函数
+ * @param  port: 端口
+ * @param  at_dev: AT设备,at_id与at_delay_ms保持不变
+ * @note   已调用at_engine_init时同时设置接收回调,由uart_port_poll将数据交给at_engine_rx_input
+ */
+void uart_port_bind_at(uart_port_t *port, at_device_t *at_dev)
+{
+    const uart_port_thunk_t *thunk;
+
+    if(port == NULL || at_dev == NULL)
+    {
+        return;
+    }
+    thunk = &uart_port_thunk[port->id];
+    at_dev->at_cmd_pprintf = thunk->printf;
+    at_dev->at_hex_printf_cmd = thunk->hex_printf;
+    at_dev->at_ack_restart = thunk->rx_reset;
+    at_dev->at_cmd_ack = thunk->rx_buf;
+    if(at_dev->at_delay_ms == NULL)
+    {
+        at_dev->at_delay_ms = sys_delay_ms;
+    }
+    if(at_dev->engine != NULL)
+    {
+        uart_port_set_rx(port, uart_port_at_engine_rx, at_dev);
+    }
+}
+
+/**
+ * @brief  modbus rtu绑定端口
+ * @param  port: 端口,modbus帧含0x00,环形模式下rx_line_size须不小于最大帧长
+ * @param  fun: modbus rtu收发函数
+ */
+void uart_port_bind_rtu(uart_port_t *port, modbus_rtu_fun_t *fun)
+{
+    const uart_port_thunk_t *thunk;
+
+    if(port == NULL || fun == NULL)
+    {
+        return;
+    }
+    thunk = &uart_port_thunk[port->id];
+    fun->rtu_hex_printf = thunk->hex_printf;
+    fun->rtu_rx_reset = thunk->rx_reset;
+    fun->rtu_rx_get_buf = thunk->rx_buf;
+    fun->rtu_rx_get_len = thunk->rx_len;
+    if(fun->rtu_delay_ms == NULL)
+    {
+        fun->rtu_delay_ms = sys_delay_ms;
+    }
+}
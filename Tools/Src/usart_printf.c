@@ -4,6 +4,11 @@
 #include "usart_printf.h"
 #include "stdarg.h"
 #include "string.h"
+#include "trace_log.h"
+#include "uart_port.h"
+
+#define PRINTF_CONFIG_DEBUG "CONFIG DEBUG="
+#define PRINTF_CONFIG_LOG "CONFIG LOG="
 
 void uart_irq(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdma_usart_rx, uart_rx_frame *rx_frame, uint16_t rx_len);
 void uart_enable_dma_it(UART_HandleTypeDef *huart, uart_rx_frame *rx_frame, uart_tx_frame *tx_frame, uint16_t rx_len);
@@ -93,15 +98,91 @@ int fputc(int ch, FILE *f)
 
 }
 #else
-/* 在PRINTF_UART放置uart_enable_dma_it,uart_irq放入对应位置,tx中断清除标识*/
-#define PRINTF_HUART huart1
-#define PRINTF_DMARX hdma_usart1_rx
+/* 配置串口由uart_port管理:初始化后调用printf_init注册,uart_port_irq/uart_port_tx_cplt放入对应中断与回调 */
 
-uart_rx_frame printf_rx_frame = {.buf = printf_rx_buffer};
-uart_tx_frame printf_tx_frame = {.uart_tx_buf = printf_tx_buffer};
+#if (PRINTF_TX_RING_SIZE & (PRINTF_TX_RING_SIZE - 1)) != 0
+#error "PRINTF_TX_RING_SIZE must be a power of 2"
+#endif
+
+/* 丢弃最早策略按'\n'对齐丢弃位置,二进制日志记录中没有'\n',丢弃会截断记录使上位机解析错位 */
+#if TRACE_LOG_ENABLE == 1 && PRINTF_TX_DROP_POLICY == PRINTF_TX_DROP_OLDEST
+#error "PRINTF_TX_DROP_OLDEST splits binary trace records, use PRINTF_TX_DROP_NEWEST when TRACE_LOG_ENABLE is 1"
+#endif
+
+static uint8_t printf_rx_buffer[PRINTF_RX_BUFFER_SIZE];
+#if PRINTF_RX_RING == 1
+static uint8_t printf_rx_line[PRINTF_RX_BUFFER_SIZE];
+#endif
+static uint8_t printf_tx_ring[PRINTF_TX_RING_SIZE];
+static uart_port_t *printf_port = NULL;
 
 uint8_t debug_out = 1;
 
+/**
+ * @brief 注册配置串口
+ * @param huart 配置串口句柄,如&huart1
+ * @param hdma_rx 配置串口DMA接收句柄,如&hdma_usart1_rx
+ * @return uint8_t 0:成功 1:失败
+ * @note 注册前的日志被丢弃
+ */
+uint8_t printf_init(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdma_rx)
+{
+    uart_port_config_t config = {0};
+
+    config.huart = huart;
+    config.hdma_rx = hdma_rx;
+    config.rx_buf = printf_rx_buffer;
+    config.rx_size = PRINTF_RX_BUFFER_SIZE;
+#if PRINTF_RX_RING == 1
+    config.rx_mode = UART_PORT_RX_RING;
+    config.rx_line = printf_rx_line;
+    config.rx_line_size = PRINTF_RX_BUFFER_SIZE;
+#else
+    config.rx_mode = UART_PORT_RX_FRAME;
+#endif
+    config.tx_buf = printf_tx_ring;
+    config.tx_size = PRINTF_TX_RING_SIZE;
+    config.tx_policy = PRINTF_TX_DROP_POLICY;
+    printf_port = uart_port_register(PRINTF_PORT_ID, &config);
+    return (printf_port == NULL) ? 1 : 0;
+}
+
+/**
+ * @brief 写入日志发送缓冲,不等待发送
+ * @param data 数据
+ * @param len 长度
+ * @return uint16_t 写入长度,缓冲满时按PRINTF_TX_DROP_POLICY丢弃,丢弃字节数计入printf_tx_overflow
+ * @note 可在中断中调用
+ */
+uint16_t printf_tx_write(const uint8_t *data, uint16_t len)
+{
+    return uart_port_write(printf_port, data, len);
+}
+
+/**
+ * @brief 日志DMA发送完成处理,可在HAL_UART_TxCpltCallback中调用,与uart_port_tx_cplt等效
+ */
+void printf_tx_cplt(void)
+{
+    uart_port_tx_kick(printf_port);
+}
+
+/**
+ * @brief 阻塞等待日志缓冲发送完毕,用于复位或休眠前
+ */
+void printf_tx_flush(void)
+{
+    uart_port_tx_flush(printf_port);
+}
+
+/**
+ * @brief 获取日志缓冲满时丢弃的累计字节数
+ */
+uint32_t printf_tx_overflow(void)
+{
+    return uart_port_tx_overflow(printf_port);
+}
+
 /**
  * @brief 配置用串口输出
  * 
@@ -112,37 +193,70 @@ uint8_t debug_out = 1;
 uint8_t config_pirntf(char *fmt, ...)
 {
     va_list ap;
-    wait_uart_tx_finish_flag(&printf_tx_frame);
+    char line[UART_PORT_LINE_LEN];
+    int len;
 
     va_start(ap, fmt);
-    vsprintf((char *)printf_tx_frame.uart_tx_buf, fmt, ap);
+    len = vsnprintf(line, sizeof(line), fmt, ap);
     va_end(ap);
+    if(len <= 0)
+    {
+        return 1;
+    }
+    if(len >= (int)sizeof(line))
+    {
+        len = sizeof(line) - 1;
+    }
+    return (printf_tx_write((const uint8_t *)line, len) == len) ? 0 : 1;
+}
 
-    printf_tx_frame.sta.len = strlen((const char *)printf_tx_frame.uart_tx_buf);
-    return HAL_UART_Transmit_DMA(&PRINTF_HUART, printf_tx_frame.uart_tx_buf, printf_tx_frame.sta.len);
+/**
+ * @brief 配置串口中断,只完成接收缓冲区,配置命令由printf_config_poll在任务中处理
+ * @note 与uart_port_irq等效,已在中断中调用uart_port_irq时无需再调用
+ * 
+ */
+void printf_irq(void)
+{
+    if(printf_port != NULL)
+    {
+        uart_port_irq(printf_port->huart);
+    }
 }
 
 /**
- * @brief 配置串口中断,用于完成缓冲区和配置日志输出
+ * @brief 处理配置串口收到的日志配置命令,于主循环或任务中周期调用
  * @note CONFIG DEBUG=0:关闭日志
  * @note CONFIG DEBUG=1:开启日志
+ * @note CONFIG LOG=模块名,等级:设置模块日志等级,如CONFIG LOG=MODBUS_RTU,4,模块名为ALL时设置全部模块
+ * @note 命令须位于帧首,处理后释放该帧,其他帧保留给调用者
  * 
+ * @return uint8_t 0:无配置命令 1:已处理
  */
-void printf_irq(void)
+uint8_t printf_config_poll(void)
 {
-    uart_irq(&PRINTF_HUART, &PRINTF_DMARX, &printf_rx_frame, PRINTF_RX_BUFFER_SIZE);
-    uint8_t *buf = config_get_rx_buffer();
-    if(strstr(buf, "CONFIG DEBUG=0") != NULL)
+    char *buf = (char *)config_get_rx_buffer();
+
+    if(buf == NULL)
     {
-        debug_out = 0;
-        config_rx_reset();
+        return 0;
     }
-    else if(strstr(buf, "CONFIG DEBUG=1") != NULL)
+    if(strncmp(buf, PRINTF_CONFIG_DEBUG, sizeof(PRINTF_CONFIG_DEBUG) - 1) == 0)
+    {
+        debug_out = (buf[sizeof(PRINTF_CONFIG_DEBUG) - 1] == '1') ? 1 : 0;
+    }
+    else if(strncmp(buf, PRINTF_CONFIG_LOG, sizeof(PRINTF_CONFIG_LOG) - 1) == 0)
+    {
+        if(trace_log_config(buf + sizeof(PRINTF_CONFIG_LOG) - 1) != 0)
+        {
+            config_pirntf("CONFIG LOG ERROR\r\n");
+        }
+    }
+    else
     {
-        debug_out = 1;
-        config_rx_reset();
+        return 0;
     }
-    
+    config_rx_reset();
+    return 1;
 }
 
 /**
@@ -156,9 +270,8 @@ int fputc(int ch, FILE *f)
 {
     if(debug_out)
     {
-        wait_uart_tx_finish_flag(&printf_tx_frame);
-        uint8_t temp[] = {ch};
-        HAL_UART_Transmit_DMA(&PRINTF_HUART, temp, 1);
+        uint8_t temp = ch;
+        printf_tx_write(&temp, 1);
     }
     return ch;
 }
@@ -172,17 +285,18 @@ int fputc(int ch, FILE *f)
  */
 uint8_t config_hex_printf(uint8_t *data, uint16_t len)
 {
-    return uart_hex_printf(&PRINTF_HUART, &printf_tx_frame, data, len, PRINTF_TX_BUFFER_SIZE);
+    return (printf_tx_write(data, len) == len) ? 0 : 1;
 }
 
 /**
  * @brief 获取配置输入缓冲区
+ * @note PRINTF_RX_RING启用时,将环形缓冲中最早的一帧拷贝至printf_rx_line(每帧一次),以兼容按字符串处理的调用者
  * 
  * @return uint8_t* 
  */
 uint8_t *config_get_rx_buffer(void)
 {
-    return uart_rx_get_buf(&printf_rx_frame);
+    return uart_port_rx_buf(printf_port);
 }
 
 /**
@@ -192,16 +306,17 @@ uint8_t *config_get_rx_buffer(void)
  */
 uint16_t config_get_rx_len(void)
 {
-    return uart_rx_get_len(printf_rx_frame);
+    return uart_port_rx_len(printf_port);
 }
 
 /**
  * @brief 重置配置输入缓存
+ * @note PRINTF_RX_RING启用时释放最早的一帧,后续帧不受影响
  * 
  */
 void config_rx_reset(void)
 {
-    uart_rx_reset(&printf_rx_frame);
+    uart_port_rx_reset(printf_port);
 }
 
 /**
@@ -215,6 +330,16 @@ void debug_out_set(uint8_t status)
     debug_out = status;
 }
 
+/**
+ * @brief 获取日志是否输出
+ * 
+ * @return uint8_t 0:关闭 1:开启
+ */
+uint8_t debug_out_get(void)
+{
+    return debug_out;
+}
+
 #endif
 
 /***********************************************END*******************************************/
@@ -243,7 +368,7 @@ void uart_irq(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdma_usart_rx, uart_
     {
         rx_frame->sta.finsh = 1;                                                                  /* 标记帧接收完成 */
         __HAL_UART_CLEAR_IDLEFLAG(huart);                                                         /* 清除UART总线空闲中断 */
-        HAL_UART_DMAStop(huart);                                                                  /* 停止DMA传输 */
+        HAL_UART_AbortReceive(huart);                                                             /* 仅停止DMA接收,不影响DMA发送 */
         tmp = __HAL_DMA_GET_COUNTER(hdma_usart_rx);                                               /* 清除DMA接收中断标志 */
         rx_frame->sta.len = ((rx_len - tmp) <= 0) ? 0 : (rx_len - tmp); /* 计算接收到的数据长度 */
         HAL_UART_Receive_DMA(huart, rx_frame->buf, rx_len);                          /* 重新开始DMA传输 */
@@ -371,4 +496,208 @@ uint16_t uart_rx_get_len(uart_rx_frame rx_frame)
     }
 }
 
+/**********************************DMA循环接收环形缓冲**************************************/
+/* 中断为唯一生产者(head/rx_total/frame_start),任务为唯一消费者(tail),无需关中断 */
+
+#define UART_RX_RING_BARRIER() __DMB()                /* 描述符内容先于head/tail可见 */
+
+/**
+ * @brief  初始化环形缓冲
+ * @param  ring: 环形缓冲
+ * @param  buf: DMA接收缓冲
+ * @param  size: 缓冲区大小
+ */
+void uart_ring_init(uart_rx_ring *ring, uint8_t *buf, uint16_t size)
+{
+    memset(ring, 0, sizeof(uart_rx_ring));
+    ring->buf = buf;
+    ring->size = size;
+}
+
+/**
+ * @brief  使能串口循环DMA接收与空闲中断
+ * @param  huart: 串口句柄,其DMA接收须配置为循环模式
+ * @param  ring: 环形缓冲,buf与size已初始化
+ * @param  tx_frame: 串口发送帧缓冲信息结构体
+ * @note   HAL_UART_Receive_DMA同时使能DMA半满与满中断,在HAL_UART_RxHalfCpltCallback/HAL_UART_RxCpltCallback中调用uart_ring_dma_irq
+ */
+void uart_ring_enable_dma_it(UART_HandleTypeDef *huart, uart_rx_ring *ring, uart_tx_frame *tx_frame)
+{
+    ring->dma_pos = 0;
+    ring->rx_total = 0;
+    ring->frame_start = 0;
+    ring->head = 0;
+    ring->tail = 0;
+    __HAL_UART_ENABLE_IT(huart, UART_IT_IDLE); /* 使能IDLE中断 */
+    HAL_UART_Receive_DMA(huart, ring->buf, ring->size); /* 开启循环DMA接收 */
+    tx_frame->sta.finsh = 1; /* 标记帧发送完成 */
+}
+
+/**
+ * @brief  串口中断中调用,处理空闲中断,不停止DMA
+ * @param  huart: 串口句柄
+ * @param  hdma_usart_rx: 串口DMA接收句柄
+ * @param  ring: 环形缓冲
+ */
+void uart_ring_irq(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdma_usart_rx, uart_rx_ring *ring)
+{
+    if (__HAL_UART_GET_FLAG(huart, UART_FLAG_ORE) != RESET) /* UART接收过载错误中断 */
+    {
+        __HAL_UART_CLEAR_OREFLAG(huart);
+        (void)huart->Instance->SR;
+        (void)huart->Instance->DR;
+    }
+
+    if (__HAL_UART_GET_FLAG(huart, UART_FLAG_IDLE) != RESET) /* UART总线空闲中断 */
+    {
+        __HAL_UART_CLEAR_IDLEFLAG(huart);
+        uart_ring_rx_update(ring, __HAL_DMA_GET_COUNTER(hdma_usart_rx), 1);
+    }
+}
+
+/**
+ * @brief  DMA半满/满回调中调用
+ * @param  hdma_usart_rx: 串口DMA接收句柄
+ * @param  ring: 环形缓冲
+ */
+void uart_ring_dma_irq(DMA_HandleTypeDef *hdma_usart_rx, uart_rx_ring *ring)
+{
+    uart_ring_rx_update(ring, __HAL_DMA_GET_COUNTER(hdma_usart_rx), 0);
+}
+
+/**
+ * @brief  根据DMA剩余计数更新环形缓冲,与硬件无关
+ * @param  ring: 环形缓冲
+ * @param  dma_counter: DMA剩余传输计数(NDTR)
+ * @param  idle: 1-空闲中断,结束当前帧 0-DMA半满/满中断
+ * @note   相邻两次调用间接收不超过size字节,由半满/满中断保证
+ * @note   未结束的帧超过半个缓冲时在半满/满中断处拆分,避免长数据流被自身覆盖
+ * @note   未释放数据被覆盖或描述符队列满时丢弃当前帧并计入overflow
+ */
+void uart_ring_rx_update(uart_rx_ring *ring, uint16_t dma_counter, uint8_t idle)
+{
+    uint16_t pos = ring->size - dma_counter;
+    uint16_t tail = ring->tail;
+    uint32_t base;
+    uint32_t pending;
+
+    if(pos >= ring->size)
+    {
+        pos = 0;
+    }
+    ring->rx_total += (uint16_t)(pos + ring->size - ring->dma_pos) % ring->size;
+    ring->dma_pos = pos;
+
+    //最早未释放的数据:队列非空时为队首帧,否则为当前帧
+    base = (tail != ring->head) ? ring->desc[tail & (UART_RX_RING_DESC_NUM - 1)].start : ring->frame_start;
+    if(ring->rx_total - base > ring->size)
+    {
+        ring->overflow++;
+        ring->frame_start = ring->rx_total;
+        return;
+    }
+
+    pending = ring->rx_total - ring->frame_start;
+    if(pending == 0 || (idle == 0 && pending < ring->size / 2))
+    {
+        return;
+    }
+    if((uint16_t)(ring->head - tail) >= UART_RX_RING_DESC_NUM)
+    {
+        ring->overflow++;
+        ring->frame_start = ring->rx_total;
+        return;
+    }
+    ring->desc[ring->head & (UART_RX_RING_DESC_NUM - 1)].start = ring->frame_start;
+    ring->desc[ring->head & (UART_RX_RING_DESC_NUM - 1)].len = pending;
+    ring->frame_start = ring->rx_total;
+    UART_RX_RING_BARRIER();
+    ring->head++;
+}
+
+/**
+ * @brief  获取最早的一帧,不拷贝
+ * @param  ring: 环形缓冲
+ * @param  span: 帧在缓冲中的位置,回绕时分为两段,第二段为空时len[1]为0
+ * @retval 1-有帧 0-无帧
+ * @note   数据在uart_ring_release前有效;已被DMA覆盖的帧直接跳过
+ */
+uint8_t uart_ring_peek(uart_rx_ring *ring, uart_rx_span *span)
+{
+    uart_rx_desc *desc;
+    uint16_t index;
+
+    while(1)
+    {
+        if(ring->tail == ring->head)
+        {
+            return 0;
+        }
+        UART_RX_RING_BARRIER();
+        desc = &ring->desc[ring->tail & (UART_RX_RING_DESC_NUM - 1)];
+        if(ring->rx_total - desc->start <= ring->size)
+        {
+            break;
+        }
+        ring->tail++;//消费过慢,帧已被覆盖
+    }
+    index = desc->start % ring->size;
+    span->data[0] = &ring->buf[index];
+    span->data[1] = ring->buf;
+    if(index + desc->len > ring->size)
+    {
+        span->len[0] = ring->size - index;
+        span->len[1] = desc->len - span->len[0];
+    }
+    else
+    {
+        span->len[0] = desc->len;
+        span->len[1] = 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief  释放最早的一帧,其缓冲空间可被DMA覆盖
+ * @param  ring: 环形缓冲
+ */
+void uart_ring_release(uart_rx_ring *ring)
+{
+    if(ring->tail != ring->head)
+    {
+        UART_RX_RING_BARRIER();
+        ring->tail++;
+    }
+}
+
+/**
+ * @brief  将帧拷贝为连续字符串,供需要连续缓冲的调用者使用
+ * @param  span: uart_ring_peek获取的帧
+ * @param  dst: 目标缓冲
+ * @param  size: 目标缓冲大小,含结尾'\0'
+ * @retval 拷贝长度,超出时截断
+ */
+uint16_t uart_rx_span_copy(const uart_rx_span *span, uint8_t *dst, uint16_t size)
+{
+    uint16_t len0 = span->len[0];
+    uint16_t len1 = span->len[1];
+
+    if(size == 0)
+    {
+        return 0;
+    }
+    if(len0 > size - 1)
+    {
+        len0 = size - 1;
+    }
+    if(len1 > size - 1 - len0)
+    {
+        len1 = size - 1 - len0;
+    }
+    memcpy(dst, span->data[0], len0);
+    memcpy(&dst[len0], span->data[1], len1);
+    dst[len0 + len1] = '\0';
+    return len0 + len1;
+}
+
 /**********************************************END*********************************************/
@@ -0,0 +1,119 @@
+/**
+ * @brief  at_ack_tokenize主机测试与性能对比,应答样本取自USR-TCP232与WH-L102
+ * @note   在仓库根目录编译运行:
+ *         gcc -O2 -Wall -ITools/Test/host -ITools/Inc Tools/Test/at_ack_tokenize_test.c Tools/Src/at_cmd_tools.c -o at_ack_tokenize_test
+ *         ./at_ack_tokenize_test
+ *         输出逐参数重复扫描(at_ack_get_normal_parameter)与一次扫描(at_ack_tokenize+at_ack_field_copy)的单条应答耗时
+ */
+#include <time.h>
+#include "main.h"
+#include "at_cmd_tools.h"
+#include "trace_log.h"
+
+#define BENCH_LOOP 1000000
+
+volatile uint32_t trace_log_mask[TRACE_LEVEL_NUM];
+void trace_log_write(const char *fmt, const int32_t *arg, uint8_t num) { (void)fmt; (void)arg; (void)num; }
+uint32_t HAL_GetTick(void) { return 0; }
+void HAL_Delay(uint32_t Delay) { (void)Delay; }
+
+static volatile uint32_t bench_sink;
+static int fail_num;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %d: %s\n", __LINE__, #cond); fail_num++; } } while(0)
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+ * @brief  同一应答分别用两种方式取出全部参数,打印单条耗时
+ * @param  name: 应答名称
+ * @param  old_resp: 旧解析器可识别的应答('='分隔)
+ * @param  new_resp: 模块实际应答
+ * @param  prefix: 应答前缀
+ * @param  num: 参数个数
+ */
+static void bench(const char *name, const char *old_resp, const char *new_resp, const char *prefix, uint8_t num)
+{
+    at_ack_fields_t fields;
+    char buf[40];
+    uint16_t index, len;
+    double t0 = now_ns();
+
+    for(uint32_t i = 0; i < BENCH_LOOP; i++)
+    {
+        for(uint8_t f = 1; f <= num; f++)
+        {
+            at_ack_get_normal_parameter((uint8_t *)old_resp, f, &index, &len);
+            bench_sink += len;
+        }
+    }
+    double t1 = now_ns();
+    for(uint32_t i = 0; i < BENCH_LOOP; i++)
+    {
+        at_ack_tokenize((const uint8_t *)new_resp, prefix, &fields);
+        for(uint8_t f = 1; f <= num; f++)
+        {
+            at_ack_field_copy(&fields, f, buf, sizeof(buf));
+            bench_sink += buf[0];
+        }
+    }
+    double t2 = now_ns();
+    printf("%-14s %u fields: per-field rescan %6.1f ns, tokenize+copy %6.1f ns\n",
+           name, num, (t1 - t0) / BENCH_LOOP, (t2 - t1) / BENCH_LOOP);
+}
+
+int main(void)
+{
+    at_ack_fields_t fields;
+    char buf[40];
+
+    /* USR-TCP232 */
+    const char *wann = "AT+WANN\r\n\r\n+OK=STATIC,192.168.0.7,255.255.255.0,192.168.0.1\r\n\r\n";
+    CHECK(at_ack_tokenize((const uint8_t *)wann, "+OK", &fields) == AT_CMD_OK && fields.num == 4);
+    CHECK(at_ack_field_copy(&fields, 3, buf, sizeof(buf)) == AT_CMD_OK && strcmp(buf, "255.255.255.0") == 0);
+
+    /* 回显中的'='不作为参数起点 */
+    const char *ping = "AT+PING=www.usr.cn\r\n\r\n+OK=SUCCESS\r\n";
+    at_ack_tokenize((const uint8_t *)ping, "+OK", &fields);
+    CHECK(at_ack_field_copy(&fields, 1, buf, sizeof(buf)) == AT_CMD_OK && strcmp(buf, "SUCCESS") == 0);
+
+    /* 引号内逗号、空参数、越界序号与缓冲不足 */
+    const char *quote = "+OK=\"a,b\",12,\"\"\r\n";
+    at_ack_tokenize((const uint8_t *)quote, "+OK", &fields);
+    CHECK(fields.num == 3);
+    CHECK(at_ack_field_copy(&fields, 1, buf, sizeof(buf)) == AT_CMD_OK && strcmp(buf, "a,b") == 0);
+    CHECK(at_ack_field_copy(&fields, 3, buf, sizeof(buf)) == AT_CMD_OK && strcmp(buf, "") == 0);
+    CHECK(at_ack_field_copy(&fields, 4, buf, sizeof(buf)) == AT_CMD_PARMINVAL);
+    CHECK(at_ack_field_copy(&fields, 1, buf, 3) == AT_CMD_ERROR);
+
+    /* 超过255字节的应答 */
+    char longer[400];
+    memset(longer, ' ', 300);
+    strcpy(longer + 300, "+OK=ON,OFF\r\n");
+    at_ack_tokenize((const uint8_t *)longer, "+OK", &fields);
+    CHECK(at_ack_field_copy(&fields, 2, buf, sizeof(buf)) == AT_CMD_OK && strcmp(buf, "OFF") == 0);
+
+    /* WH-L102 */
+    const char *wh_uart = "AT+UART\r\n\r\n+UART:115200,8,1,NONE,NFC\r\n\r\nOK\r\n";
+    at_ack_tokenize((const uint8_t *)wh_uart, "+UART", &fields);
+    CHECK(fields.num == 5);
+    CHECK(at_ack_field_copy(&fields, 4, buf, sizeof(buf)) == AT_CMD_OK && strcmp(buf, "NONE") == 0);
+
+    if(fail_num != 0)
+    {
+        return 1;
+    }
+    printf("functional ok\n");
+
+    const char *usr_uart = "AT+UART\r\n\r\n+OK=115200,8,1,NONE,NFC\r\n\r\n";
+    bench("USR WANN", wann, wann, "+OK", 4);
+    bench("USR UART", usr_uart, usr_uart, "+OK", 5);
+    bench("WH-L102 UART", "AT+UART\r\n\r\n+UART=115200,8,1,NONE,NFC\r\n\r\nOK\r\n", wh_uart, "+UART", 5);
+    bench("WH-L102 WMODE", "AT+WMODE\r\n\r\n+WMODE=TRANS\r\n\r\nOK\r\n", "AT+WMODE\r\n\r\n+WMODE:TRANS\r\n\r\nOK\r\n", "+WMODE", 1);
+    return 0;
+}
@@ -0,0 +1,451 @@
+/**
+ * @brief  flash_storage主机测试,RAM模拟NOR Flash(写入只能将1变为0,按扇区擦除),可在任意字节处模拟掉电
+ * @note   在仓库根目录编译运行:
+ *         gcc -O2 -Wall -DCRC32_USE_HW=0 -ITools/Test/host -ITools/Inc Tools/Test/flash_storage_test.c Tools/Src/flash_storage.c Tools/Src/crc_tools.c -o flash_storage_test
+ *         ./flash_storage_test
+ *         输出写放大、两种格式的每MB记录数与写入速率、掉电恢复的读取次数、一年1Hz写入后的擦除次数分布
+ */
+#include <time.h>
+#include <stdlib.h>
+#include "main.h"
+#include "flash_storage.h"
+
+#define SIM_SECTOR_NUM 64
+#define SIM_FLASH_SIZE (SIM_SECTOR_NUM * W25QXX_SECTOR_SIZE)
+#define SIM_TIME_BASE 1700000000U
+#define SIM_RECORD_MAX 8192
+
+static uint8_t sim_flash[SIM_FLASH_SIZE];
+static int32_t sim_budget = -1;//剩余可写入字节数,-1为不限,为0时写入与擦除失败(掉电)
+static uint32_t sim_read_num;
+static uint32_t sim_erase_num[SIM_SECTOR_NUM];
+static uint32_t sim_tick;
+static int fail_num;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %d: %s\n", __LINE__, #cond); fail_num++; } } while(0)
+
+uint32_t HAL_GetTick(void) { return sim_tick; }
+void HAL_Delay(uint32_t Delay) { sim_tick += Delay; }
+
+static uint8_t sim_read(uint32_t addr, uint8_t* buf, uint32_t len)
+{
+    memcpy(buf, &sim_flash[addr], len);
+    sim_read_num++;
+    return 1;
+}
+
+static uint8_t sim_write(uint32_t addr, uint8_t* buf, uint32_t len)
+{
+    for(uint32_t i = 0; i < len; i++)
+    {
+        if(sim_budget == 0)
+        {
+            return 0;
+        }
+        if(sim_budget > 0)
+        {
+            sim_budget--;
+        }
+        sim_flash[addr + i] &= buf[i];
+    }
+    return 1;
+}
+
+static uint8_t sim_erase_sector(uint32_t addr)
+{
+    if(sim_budget == 0)
+    {
+        return 0;
+    }
+    memset(&sim_flash[addr / W25QXX_SECTOR_SIZE * W25QXX_SECTOR_SIZE], 0xFF, W25QXX_SECTOR_SIZE);
+    sim_erase_num[addr / W25QXX_SECTOR_SIZE]++;
+    return 1;
+}
+
+static uint8_t sim_erase(void)
+{
+    memset(sim_flash, 0xFF, sizeof(sim_flash));
+    return 1;
+}
+
+static StorageDriver sim_driver = {sim_read, sim_write, sim_erase_sector, sim_erase};
+
+/**
+ * @brief  清空模拟Flash并以指定格式初始化
+ * @param  format: 数据块格式
+ * @param  sectors: 存储区扇区数,含2个管理扇区
+ */
+static void sim_reset(StorageFormat format, uint32_t sectors)
+{
+    sim_erase();
+    memset(sim_erase_num, 0, sizeof(sim_erase_num));
+    sim_budget = -1;
+    storage_set_format(format);
+    CHECK(storage_init(0, sectors * W25QXX_SECTOR_SIZE));
+}
+
+static double now_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief  写入一条数据,时间戳为SIM_TIME_BASE + id,变长记录的数据长度为id % 20
+ * @retval 1:成功 0:失败
+ */
+static uint8_t sim_put(StorageFormat format, uint32_t id)
+{
+    if(format == STORAGE_FORMAT_FIXED)
+    {
+        StorageBlock block = {0};
+
+        block.type = 1;
+        block.id = id;
+        block.timestamp = SIM_TIME_BASE + id;
+        return write_data_block(&block);
+    }
+    uint8_t data[20];
+    memset(data, (uint8_t)id, sizeof(data));
+    return write_record(1, id, SIM_TIME_BASE + id, data, id % 20);
+}
+
+/**
+ * @brief  游标遍历,输出各记录的id
+ * @param  filter: 过滤条件,NULL为不过滤
+ * @param  ids: 输出缓冲,不小于SIM_RECORD_MAX
+ * @retval 记录数
+ */
+static uint32_t sim_collect(StorageFormat format, const StorageFilter* filter, uint32_t* ids)
+{
+    StorageCursor cursor;
+    uint32_t num = 0;
+
+    if(!storage_cursor_open(&cursor, STORAGE_CURSOR_FORWARD, filter))
+    {
+        return 0;
+    }
+    while(num < SIM_RECORD_MAX)
+    {
+        if(format == STORAGE_FORMAT_FIXED)
+        {
+            const StorageBlock* block = storage_cursor_next(&cursor);
+            if(block == NULL) break;
+            CHECK(block->timestamp == SIM_TIME_BASE + block->id);
+            ids[num++] = block->id;
+        }
+        else
+        {
+            const StorageRecord* record = storage_cursor_next_record(&cursor);
+            if(record == NULL) break;
+            CHECK(record->timestamp == SIM_TIME_BASE + record->id && record->length == record->id % 20);
+            ids[num++] = record->id;
+        }
+    }
+    storage_cursor_close(&cursor);
+    return num;
+}
+
+/**
+ * @brief  user-002: 暂存页写入的写放大
+ */
+static void test_write_amplification(void)
+{
+    StorageWriteStats stats;
+
+    sim_reset(STORAGE_FORMAT_FIXED, 10);
+    storage_reset_write_stats();
+    for(uint32_t id = 0; id < 3000; id++)
+    {
+        CHECK(sim_put(STORAGE_FORMAT_FIXED, id));
+        sim_tick += 10;
+        storage_flush_poll();
+    }
+    CHECK(storage_flush());
+    storage_get_write_stats(&stats);
+    printf("write amplification: logical %u flash %u writes %u erases %u -> %.3f\n",
+           stats.logical_bytes, stats.flash_bytes, stats.page_writes, stats.sector_erases,
+           (double)stats.flash_bytes / stats.logical_bytes);
+    CHECK(stats.flash_bytes < stats.logical_bytes * 11 / 10);
+    CHECK(stats.page_writes < stats.logical_bytes / STORAGE_PAGE_SIZE * 2);
+}
+
+/**
+ * @brief  user-004: 定长与变长格式的每MB记录数与写入速率
+ * @param  length: 每条数据长度,定长格式固定占用STORAGE_BLOCK_DATA_SIZE
+ * @param  ratio: 输出变长格式相对定长格式的每MB记录数之比
+ */
+static void test_density(uint16_t length, double* ratio)
+{
+    double per_mb[2];
+
+    for(uint8_t f = 0; f < 2; f++)
+    {
+        StorageFormat format = (f == 0) ? STORAGE_FORMAT_FIXED : STORAGE_FORMAT_VAR;
+        StorageWriteStats stats;
+        uint8_t data[STORAGE_BLOCK_DATA_SIZE * 4];
+        const uint32_t num = 20000;
+
+        sim_reset(format, SIM_SECTOR_NUM);
+        storage_reset_write_stats();
+        double t0 = now_s();
+        for(uint32_t id = 0; id < num; id++)
+        {
+            memset(data, (uint8_t)id, sizeof(data));
+            if(format == STORAGE_FORMAT_FIXED)
+            {
+                StorageBlock block = {0};
+                block.length = length;
+                block.type = 1;
+                block.id = id;
+                block.timestamp = SIM_TIME_BASE + id;
+                memcpy(block.data, data, STORAGE_BLOCK_DATA_SIZE);
+                CHECK(write_data_block(&block));
+            }
+            else
+            {
+                CHECK(write_record(1, id, SIM_TIME_BASE + id, data, length));
+            }
+        }
+        CHECK(storage_flush());
+        double t1 = now_s();
+        storage_get_write_stats(&stats);
+        per_mb[f] = stats.records * 1048576.0 / stats.flash_bytes;
+        printf("%-5s %2u byte payload: %6.0f records/MB, ingest %5.2f M records/s\n",
+               (f == 0) ? "fixed" : "var", length, per_mb[f], num / (t1 - t0) / 1e6);
+    }
+    *ratio = per_mb[1] / per_mb[0];
+}
+
+/**
+ * @brief  user-005/user-001: 随机位置掉电后重新初始化,数据不丢失、写入位置正确,
+ *         按时间过滤的查询结果与不过滤遍历后筛选的结果一致
+ * @param  trials: 掉电次数,定长与变长格式交替
+ */
+static void test_power_cut(uint32_t trials)
+{
+    static uint32_t all[SIM_RECORD_MAX];
+    static uint32_t hit[SIM_RECORD_MAX];
+    uint32_t max_reads = 0;
+    uint32_t query_num = 0;
+
+    srand(1);
+    for(uint32_t trial = 0; trial < trials; trial++)
+    {
+        StorageFormat format = (trial & 1) ? STORAGE_FORMAT_VAR : STORAGE_FORMAT_FIXED;
+        uint32_t id = 1;
+        uint32_t durable = 0;
+        uint32_t total = 2000 + rand() % 8000;
+        int fail_before = fail_num;
+
+        sim_reset(format, 10);
+        for(; id < total; id++)
+        {
+            CHECK(sim_put(format, id));
+            if(rand() % 50 == 0)
+            {
+                CHECK(storage_flush());
+                durable = id;
+            }
+        }
+
+        /* 随机写入字节数后掉电,掉电前已完成flush的数据须保留 */
+        sim_budget = rand() % 3000;
+        for(;; id++)
+        {
+            if(!sim_put(format, id)) break;
+            if(rand() % 50 == 0)
+            {
+                if(!storage_flush()) break;
+                if(sim_budget != 0) durable = id;
+            }
+            if(sim_budget == 0) break;
+        }
+        sim_budget = -1;
+        sim_read_num = 0;
+        CHECK(storage_init(0, 10 * W25QXX_SECTOR_SIZE));
+        if(sim_read_num > max_reads)
+        {
+            max_reads = sim_read_num;
+        }
+
+        uint32_t num = sim_collect(format, NULL, all);
+        CHECK(num > 0 && all[num - 1] >= durable);
+        for(uint32_t i = 1; i < num; i++)
+        {
+            CHECK(all[i] > all[i - 1]);
+        }
+
+        /* 时间查询覆盖最新扇区与随机区间 */
+        for(uint8_t q = 0; q < 4 && num > 0; q++)
+        {
+            uint32_t first = all[(q == 0) ? num - 1 - rand() % ((num < 40) ? num : 40) : rand() % num];
+            uint32_t last = first + rand() % 200;
+            StorageFilter filter = {STORAGE_FILTER_TIME, 0, 0, SIM_TIME_BASE + first, SIM_TIME_BASE + last};
+            uint32_t expect = 0;
+            uint32_t expect_first = 0;
+
+            for(uint32_t i = 0; i < num; i++)
+            {
+                if(all[i] >= first && all[i] <= last)
+                {
+                    if(expect == 0) expect_first = all[i];
+                    expect++;
+                }
+            }
+            CHECK(sim_collect(format, &filter, hit) == expect);
+
+            uint32_t addr = find_by_time_range(SIM_TIME_BASE + first, SIM_TIME_BASE + last);
+            CHECK(addr != STORAGE_INVALID_ADDR);
+            if(format == STORAGE_FORMAT_FIXED)
+            {
+                StorageBlock block;
+                CHECK(read_by_address(addr, &block) && block.id == expect_first);
+            }
+            else
+            {
+                StorageRecord record;
+                uint8_t buf[STORAGE_RECORD_MAX_SIZE];
+                CHECK(read_record_by_address(addr, &record, buf) && record.id == expect_first);
+            }
+            query_num++;
+        }
+
+        /* 恢复后继续写入 */
+        id += 1000;
+        for(uint32_t k = 0; k < 500; k++)
+        {
+            CHECK(sim_put(format, id + k));
+        }
+        CHECK(storage_flush());
+        CHECK(storage_init(0, 10 * W25QXX_SECTOR_SIZE));
+        num = sim_collect(format, NULL, all);
+        CHECK(num > 0 && all[num - 1] == id + 499);
+
+        if(fail_num != fail_before)
+        {
+            printf("power cut trial %u (%s) failed\n", trial, (format == STORAGE_FORMAT_FIXED) ? "fixed" : "var");
+            return;
+        }
+    }
+    printf("power cut: %u trials, %u time queries, max init reads %u\n", trials, query_num, max_reads);
+}
+
+/**
+ * @brief  user-001: 写满扇区后切换写入扇区时掉电,写入扇区只剩未写完的数据块(count为0,used不为0),
+ *         查询上一扇区内的时间不能漏掉记录;6个数据扇区时二分查找会探测到环形末尾的空扇区
+ */
+static void test_empty_head(void)
+{
+    const uint32_t sectors = 8;
+    const uint32_t per_sector = (W25QXX_SECTOR_SIZE - STORAGE_SECTOR_HEADER_SIZE) / sizeof(StorageBlock);
+    const uint32_t total = per_sector * 9;
+    static uint32_t all[SIM_RECORD_MAX];
+    static uint32_t hit[SIM_RECORD_MAX];
+
+    for(int32_t budget = 0; budget < 64; budget++)
+    {
+        sim_reset(STORAGE_FORMAT_FIXED, sectors);
+        for(uint32_t id = 1; id <= total; id++)
+        {
+            CHECK(sim_put(STORAGE_FORMAT_FIXED, id));
+        }
+        CHECK(storage_flush());
+
+        sim_budget = budget;
+        if(sim_put(STORAGE_FORMAT_FIXED, total + 1))
+        {
+            storage_flush();
+        }
+        sim_budget = -1;
+        CHECK(storage_init(0, sectors * W25QXX_SECTOR_SIZE));
+
+        uint32_t num = sim_collect(STORAGE_FORMAT_FIXED, NULL, all);
+        CHECK(num > 0 && all[num - 1] >= total);
+        for(uint32_t first = total - 2 * per_sector; first <= total; first += 7)
+        {
+            StorageFilter filter = {STORAGE_FILTER_TIME, 0, 0, SIM_TIME_BASE + first, SIM_TIME_BASE + total + 1};
+            uint32_t expect = 0;
+            StorageBlock block;
+
+            for(uint32_t i = 0; i < num; i++)
+            {
+                if(all[i] >= first) expect++;
+            }
+            CHECK(sim_collect(STORAGE_FORMAT_FIXED, &filter, hit) == expect);
+            CHECK(read_by_address(find_by_time_range(SIM_TIME_BASE + first, SIM_TIME_BASE + total + 1), &block) &&
+                  block.id == first);
+        }
+    }
+}
+
+/**
+ * @brief  user-006: 一年1Hz写入,每60条flush,每天重新初始化,每90天切换格式
+ */
+static void test_wear_year(void)
+{
+    const uint32_t sectors = 34;
+    StorageFormat format = STORAGE_FORMAT_FIXED;
+    StorageWearStats wear;
+    uint32_t data_min = 0xFFFFFFFF;
+    uint32_t data_max = 0;
+
+    sim_reset(format, sectors);
+    for(uint32_t s = 0; s < 365U * 86400U; s++)
+    {
+        CHECK(sim_put(format, s));
+        if(s % 60 == 59)
+        {
+            storage_flush();
+        }
+        if(s % 86400 == 86399)
+        {
+            storage_flush();
+            CHECK(storage_init(0, sectors * W25QXX_SECTOR_SIZE));
+        }
+        if(s % (90 * 86400) == 90 * 86400 - 1)
+        {
+            format = (format == STORAGE_FORMAT_FIXED) ? STORAGE_FORMAT_VAR : STORAGE_FORMAT_FIXED;
+            storage_set_format(format);
+            CHECK(storage_init(0, sectors * W25QXX_SECTOR_SIZE));
+        }
+    }
+    storage_get_wear_stats(&wear);
+    for(uint32_t i = STORAGE_META_SECTOR_NUM; i < sectors; i++)
+    {
+        if(sim_erase_num[i] < data_min) data_min = sim_erase_num[i];
+        if(sim_erase_num[i] > data_max) data_max = sim_erase_num[i];
+    }
+    printf("one year at 1 Hz: data sector erases %u..%u (stats %u..%u avg %u), meta sector erases %u/%u\n",
+           data_min, data_max, wear.min_erase, wear.max_erase, wear.avg_erase, sim_erase_num[0], sim_erase_num[1]);
+    CHECK(data_max - data_min <= 2);
+    CHECK(wear.max_erase - wear.min_erase <= 2);
+    CHECK(sim_erase_num[0] <= sim_erase_num[1] + 1 && sim_erase_num[1] <= sim_erase_num[0] + 1);
+}
+
+int main(void)
+{
+    double ratio;
+
+    storage_driver_register(&sim_driver);
+
+    test_write_amplification();
+
+    test_density(4, &ratio);
+    CHECK(ratio > 1.5);
+    test_density(12, &ratio);
+    CHECK(ratio > 1.0);
+
+    test_power_cut(1200);
+    test_empty_head();
+
+    test_wear_year();
+
+    if(fail_num != 0)
+    {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/**
+ * @brief  主机测试用main.h,代替CubeMX生成的main.h,仅提供被测模块用到的HAL接口
+ * @note   HAL_GetTick/HAL_Delay由各测试文件实现,以便控制时间
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define __weak __attribute__((weak))
+
+typedef enum
+{
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+/* 单线程测试,临界区为空操作 */
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline uint32_t __get_IPSR(void) { return 0; }
+static inline void __disable_irq(void) {}
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+#define __DMB() __sync_synchronize()
+
+/* 串口与DMA:仅保留被测模块访问的成员,HAL_UART_xxx由各测试文件实现 */
+#define RESET 0U
+#define HAL_UART_STATE_READY 0x20U
+#define HAL_UART_STATE_BUSY_TX 0x21U
+
+#define UART_FLAG_ORE 0x0008U
+#define UART_FLAG_IDLE 0x0010U
+#define UART_IT_IDLE 0x0010U
+
+typedef struct
+{
+    volatile uint32_t SR;
+    volatile uint32_t DR;
+} USART_TypeDef;
+
+typedef struct
+{
+    volatile uint32_t CNDTR;
+} DMA_HandleTypeDef;
+
+typedef struct
+{
+    USART_TypeDef *Instance;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    volatile uint32_t gState;
+} UART_HandleTypeDef;
+
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__) (((__HANDLE__)->Instance->SR & (__FLAG__)) == (__FLAG__))
+#define __HAL_UART_CLEAR_OREFLAG(__HANDLE__) ((__HANDLE__)->Instance->SR &= ~UART_FLAG_ORE)
+#define __HAL_UART_CLEAR_IDLEFLAG(__HANDLE__) ((__HANDLE__)->Instance->SR &= ~UART_FLAG_IDLE)
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __INTERRUPT__) ((void)(__HANDLE__))
+#define __HAL_DMA_GET_COUNTER(__HANDLE__) ((__HANDLE__)->CNDTR)
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart);
+
+#endif /* __MAIN_H */
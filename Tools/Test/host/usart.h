@@ -0,0 +1,16 @@
+#ifndef __USART_H__
+#define __USART_H__
+
+/**
+ * @brief  主机测试用usart.h,代替CubeMX工程中的usart.h,声明由测试文件模拟的模块收发函数
+ */
+
+#include "main.h"
+#include "at_cmd_tools.h"
+#include "sys_delay.h"
+
+uint8_t NET_printf(char *fmt, ...);
+void NET_rx_reset(void);
+uint8_t *NET_rx_get_buf(void);
+
+#endif /* __USART_H__ */
@@ -0,0 +1,11 @@
+#ifndef __W25QXX_SPI_DRIVER_H__
+#define __W25QXX_SPI_DRIVER_H__
+
+/**
+ * @brief  主机测试用w25qxx_spi_driver.h,仅提供flash_storage.h与mcu_config.h用到的定义
+ */
+
+#define W25QXX_SECTOR_SIZE 4096
+#define W25QXX_SECTOR_ADDR(x) ((x) * W25QXX_SECTOR_SIZE)
+
+#endif /* __W25QXX_SPI_DRIVER_H__ */
@@ -0,0 +1,265 @@
+/**
+ * @brief  modbus_rtu轮询计划主机测试,模拟从站按请求应答,统计每次扫描的帧数与耗时
+ * @note   在仓库根目录编译运行:
+ *         gcc -O2 -Wall -Wno-unknown-pragmas -DCRC32_USE_HW=0 -ITools/Test/host -ITools/Inc Tools/Test/modbus_plan_test.c Tools/Src/modbus_rtu.c Tools/Src/crc_tools.c Tools/Src/trace_log.c Tools/Src/usart_printf.c Tools/Src/uart_port.c Tools/Src/at_cmd_tools.c -o modbus_plan_test
+ *         ./modbus_plan_test
+ */
+#include "main.h"
+#include "modbus_rtu.h"
+#include "crc_tools.h"
+
+#define SIM_NEVER 0xFFFFFFFFFFFFFFFFULL
+#define SIM_TURNAROUND_US 3000
+#define POINT_NUM 40
+
+static uint64_t sim_now;
+static uint64_t sim_timer_at = SIM_NEVER;
+static uint64_t sim_rx_at = SIM_NEVER;
+static uint8_t sim_rx_buf[MODBUS_RTU_RECV_BUF_LEN + 8];
+static uint16_t sim_rx_len;
+static uint8_t sim_rx_ready;
+static uint32_t sim_frames;
+static modbus_rtu_master_t master;
+static int fail_num;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %d: %s\n", __LINE__, #cond); fail_num++; } } while(0)
+
+uint32_t HAL_GetTick(void) { return (uint32_t)(sim_now / 1000); }
+void HAL_Delay(uint32_t Delay) { sim_now += Delay * 1000ULL; }
+void sys_delay_ms(uint32_t Delay) { (void)Delay; }
+void sys_delay_us(uint32_t udelay) { (void)udelay; }
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size) { (void)huart; (void)pData; (void)Size; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) { (void)huart; (void)pData; (void)Size; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart) { (void)huart; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart) { (void)huart; return HAL_OK; }
+
+static uint16_t sim_reg(uint8_t slave, uint16_t addr) { return slave * 1000 + addr; }
+static uint8_t sim_bit(uint8_t slave, uint16_t addr) { return ((slave + addr) * 7 >> 2) & 1; }
+
+static void sim_timer_start(uint32_t us)
+{
+    sim_timer_at = sim_now + us;
+}
+
+/**
+ * @brief  模拟从站: 发送结束后经过应答延时回复读请求,从站0x7F不应答
+ */
+static uint8_t sim_tx(uint8_t *buf, uint16_t len)
+{
+    uint8_t rsp[MODBUS_RTU_RECV_BUF_LEN + 8];
+    uint16_t n = 0;
+    uint16_t addr = buf[2] << 8 | buf[3];
+    uint16_t num = buf[4] << 8 | buf[5];
+
+    sim_frames++;
+    if(buf[0] == 0x7F)
+    {
+        return 0;
+    }
+    rsp[n++] = buf[0];
+    rsp[n++] = buf[1];
+    if(buf[1] >= MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS)
+    {
+        rsp[n++] = num * 2;
+        for(uint16_t i = 0; i < num; i++)
+        {
+            rsp[n++] = sim_reg(buf[0], addr + i) >> 8;
+            rsp[n++] = sim_reg(buf[0], addr + i) & 0xFF;
+        }
+    }
+    else
+    {
+        rsp[n++] = (num + 7) / 8;
+        memset(&rsp[n], 0, (num + 7) / 8);
+        for(uint16_t i = 0; i < num; i++)
+        {
+            rsp[n + i / 8] |= sim_bit(buf[0], addr + i) << (i % 8);
+        }
+        n += (num + 7) / 8;
+    }
+    uint16_t crc = modbus_rtu_crc16(rsp, n);
+    rsp[n++] = crc >> 8;
+    rsp[n++] = crc & 0xFF;
+    memcpy(sim_rx_buf, rsp, n);
+    sim_rx_len = n;
+    /* 空闲中断在应答后1个字符时间到达 */
+    sim_rx_at = sim_now + len * master.char_us + SIM_TURNAROUND_US + (n + 1) * master.char_us;
+    return 0;
+}
+
+static uint8_t *sim_rx_get_buf(void) { return sim_rx_ready ? sim_rx_buf : NULL; }
+static uint16_t sim_rx_get_len(void) { return sim_rx_len; }
+static void sim_rx_reset(void) { sim_rx_ready = 0; }
+
+/**
+ * @brief  按时间顺序触发接收与定时中断,直到主站空闲
+ */
+static void sim_run(void)
+{
+    while(modbus_rtu_master_pending(&master) != 0 || master.state != MODBUS_RTU_MASTER_IDLE)
+    {
+        if(sim_rx_at == SIM_NEVER && sim_timer_at == SIM_NEVER)
+        {
+            break;
+        }
+        if(sim_rx_at <= sim_timer_at)
+        {
+            sim_now = sim_rx_at;
+            sim_rx_at = SIM_NEVER;
+            sim_rx_ready = 1;
+            modbus_rtu_master_rx_irq(&master);
+        }
+        else
+        {
+            sim_now = sim_timer_at;
+            sim_timer_at = SIM_NEVER;
+            modbus_rtu_master_timer_irq(&master);
+        }
+    }
+}
+
+static uint32_t scan_num;
+
+static void scan_done(modbus_rtu_plan_t *plan)
+{
+    (void)plan;
+    scan_num++;
+}
+
+static uint32_t other_num;
+static uint32_t other_refill;//完成回调中再提交的请求数
+
+static void other_done(uint8_t status, modbus_rtu_msg_t *msg, void *arg)
+{
+    (void)status;
+    (void)msg;
+    (void)arg;
+    other_num++;
+    if(other_refill != 0)
+    {
+        other_refill--;
+        CHECK(modbus_rtu_master_read(&master, 5, MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS, 0, 1, other_done, NULL) == MODBUS_STATUS_OK);
+    }
+}
+
+/**
+ * @brief  检查各点位的值与模拟从站一致
+ */
+static uint8_t points_ok(modbus_rtu_point_t *point, uint16_t num)
+{
+    for(uint16_t i = 0; i < num; i++)
+    {
+        for(uint16_t j = 0; j < point[i].reg_num; j++)
+        {
+            uint16_t expect = point[i].function_code >= MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS ?
+                              sim_reg(point[i].slave_addr, point[i].reg_addr + j) :
+                              sim_bit(point[i].slave_addr, point[i].reg_addr + j);
+            if(point[i].value[j] != expect)
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int main(void)
+{
+    static modbus_rtu_point_t point[POINT_NUM];
+    static uint16_t value[POINT_NUM][8];
+    static modbus_rtu_plan_t plan;
+    const uint16_t addr[10] = {0, 1, 9, 12, 13, 20, 33, 34, 35, 60};
+    modbus_rtu_fun_t fun = {sim_tx, sim_rx_reset, sim_rx_get_buf, sim_rx_get_len, NULL};
+    uint16_t num = 0;
+
+    modbus_rtu_master_init(&master, &fun, sim_timer_start, 19200);
+
+    /* 4个从站,每站8个保持寄存器点位与2个线圈点位 */
+    for(uint8_t slave = 1; slave <= 4; slave++)
+    {
+        for(uint8_t k = 0; k < 10; k++)
+        {
+            point[num].slave_addr = slave;
+            point[num].function_code = (k < 8) ? MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS : MODBUS_RTU_FUNCTION_CODE_READ_COILS;
+            point[num].reg_addr = addr[k];
+            point[num].reg_num = (k == 3) ? 4 : 1 + (k == 6);
+            point[num].value = value[num];
+            num++;
+        }
+    }
+
+    /* 每次扫描的帧数: 不合并时每点一帧,gap越大帧越少 */
+    printf("unmerged: %u frames per scan\n", num);
+    for(uint16_t gap = 0; gap <= 32; gap += 8)
+    {
+        CHECK(modbus_rtu_plan_build(&plan, point, num, gap) == MODBUS_STATUS_OK);
+        memset(value, 0xEE, sizeof(value));
+        sim_frames = 0;
+        scan_num = 0;
+        uint64_t t0 = sim_now;
+        CHECK(modbus_rtu_plan_scan(&plan, &master, scan_done) == MODBUS_STATUS_OK);
+        sim_run();
+        CHECK(scan_num == 1 && sim_frames == plan.frame_num);
+        CHECK(points_ok(point, num));
+        for(uint8_t i = 0; i < plan.frame_num; i++)
+        {
+            CHECK(plan.frame[i].status == MODBUS_STATUS_OK);
+        }
+        printf("gap %2u: %2u frames per scan, scan %5.1f ms\n", gap, sim_frames, (sim_now - t0) / 1000.0);
+        if(gap == 0)
+        {
+            /* 只合并相邻与重叠的点位: 每站保持寄存器5帧、线圈2帧 */
+            CHECK(plan.frame_num == 4 * 7);
+        }
+        if(gap == 32)
+        {
+            /* 每站保持寄存器受单帧长度限制分为2帧,线圈合并为1帧 */
+            CHECK(plan.frame_num == 4 * 3);
+        }
+    }
+
+    /* 队列被其他请求占满时开始扫描,请求完成腾出队列后计划继续提交 */
+    CHECK(modbus_rtu_plan_build(&plan, point, num, 8) == MODBUS_STATUS_OK);
+    memset(value, 0xEE, sizeof(value));
+    sim_frames = 0;
+    scan_num = 0;
+    other_num = 0;
+    for(uint8_t i = 0; i < MODBUS_RTU_QUEUE_LEN; i++)
+    {
+        CHECK(modbus_rtu_master_read(&master, 5, MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS, i, 1, other_done, NULL) == MODBUS_STATUS_OK);
+    }
+    CHECK(modbus_rtu_plan_scan(&plan, &master, scan_done) == MODBUS_STATUS_OK);
+    CHECK(modbus_rtu_plan_scan(&plan, &master, scan_done) == MODBUS_STATUS_ERROR);
+    sim_run();
+    CHECK(other_num == MODBUS_RTU_QUEUE_LEN && scan_num == 1);
+    CHECK(sim_frames == MODBUS_RTU_QUEUE_LEN + plan.frame_num);
+    CHECK(points_ok(point, num));
+
+    /* 其他请求(含不应答的从站)在完成回调中补满队列,停止补充后计划仍能完成 */
+    scan_num = 0;
+    other_num = 0;
+    other_refill = 20;
+    for(uint8_t i = 0; i < MODBUS_RTU_QUEUE_LEN; i++)
+    {
+        CHECK(modbus_rtu_master_read(&master, 0x7F, MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS, i, 1, other_done, NULL) == MODBUS_STATUS_OK);
+    }
+    CHECK(modbus_rtu_plan_scan(&plan, &master, scan_done) == MODBUS_STATUS_OK);
+    sim_run();
+    CHECK(other_num == MODBUS_RTU_QUEUE_LEN + 20 && scan_num == 1);
+    CHECK(plan.done == plan.frame_num);
+
+    /* 空计划立即完成 */
+    scan_num = 0;
+    CHECK(modbus_rtu_plan_build(&plan, point, 0, 8) == MODBUS_STATUS_OK);
+    CHECK(modbus_rtu_plan_scan(&plan, &master, scan_done) == MODBUS_STATUS_OK);
+    CHECK(scan_num == 1);
+    CHECK(modbus_rtu_plan_scan(&plan, &master, scan_done) == MODBUS_STATUS_OK);
+    CHECK(scan_num == 2);
+
+    if(fail_num != 0)
+    {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * @brief  modbus_rtu从站主机测试,异步主站与从站经模拟串口回环,输出每次请求的总线往返时间与从站处理耗时
+ * @note   在仓库根目录编译运行:
+ *         gcc -O2 -Wall -Wno-unknown-pragmas -DCRC32_USE_HW=0 -DMODBUS_RTU_SLAVE_MODE=1 -ITools/Test/host -ITools/Inc Tools/Test/modbus_slave_test.c Tools/Src/modbus_rtu.c Tools/Src/crc_tools.c Tools/Src/trace_log.c Tools/Src/usart_printf.c Tools/Src/uart_port.c Tools/Src/at_cmd_tools.c -o modbus_slave_test
+ *         ./modbus_slave_test
+ */
+#include <time.h>
+#include "main.h"
+#include "modbus_rtu.h"
+
+#define SIM_NEVER 0xFFFFFFFFFFFFFFFFULL
+#define SIM_BAUDRATE 115200
+#define SIM_REG_NUM 100
+#define SIM_COIL_NUM 64
+#define SIM_ROUNDS 2000
+
+static uint64_t sim_now;
+static uint64_t sim_timer_at = SIM_NEVER;
+static uint64_t sim_master_rx_at = SIM_NEVER;
+static uint8_t master_rx_buf[MODBUS_RTU_RECV_BUF_LEN + 8];
+static uint16_t master_rx_len;
+static uint8_t master_rx_ready;
+static uint8_t slave_rx_buf[MODBUS_RTU_SEND_BUF_LEN];
+static uint16_t slave_rx_len;
+static uint8_t slave_rx_ready;
+static uint32_t slave_rx_reset_num;
+static uint8_t slave_tx_buf[MODBUS_RTU_SEND_BUF_LEN];
+static uint8_t slave_tx_busy;
+static double slave_poll_s;
+static uint32_t slave_poll_num;
+static uint16_t holding[SIM_REG_NUM];
+static uint16_t coil[SIM_COIL_NUM];
+static modbus_rtu_master_t master;
+static modbus_rtu_slave_t slave;
+static int fail_num;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %d: %s\n", __LINE__, #cond); fail_num++; } } while(0)
+
+uint32_t HAL_GetTick(void) { return (uint32_t)(sim_now / 1000); }
+void HAL_Delay(uint32_t Delay) { sim_now += Delay * 1000ULL; }
+void sys_delay_ms(uint32_t Delay) { (void)Delay; }
+void sys_delay_us(uint32_t udelay) { (void)udelay; }
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size) { (void)huart; (void)pData; (void)Size; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) { (void)huart; (void)pData; (void)Size; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart) { (void)huart; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart) { (void)huart; return HAL_OK; }
+
+static double now_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void sim_timer_start(uint32_t us)
+{
+    sim_timer_at = sim_now + us;
+}
+
+/* 从站串口: 主站帧发送完毕即进入空闲中断,由从站处理并启动TX DMA */
+static uint8_t *slave_rx_get_buf(void) { return slave_rx_ready ? slave_rx_buf : NULL; }
+static uint16_t slave_rx_get_len(void) { return slave_rx_len; }
+static void slave_rx_reset(void) { slave_rx_ready = 0; slave_rx_reset_num++; }
+static uint8_t *slave_tx_get_buf(void) { return slave_tx_busy ? NULL : slave_tx_buf; }
+
+static uint8_t slave_tx_start(uint16_t len)
+{
+    /* 主站在应答发送完毕后1个字符时间进入空闲中断 */
+    memcpy(master_rx_buf, slave_tx_buf, len);
+    master_rx_len = len;
+    sim_master_rx_at = sim_now + (len + 1) * master.char_us;
+    return 0;
+}
+
+static uint8_t slave_poll(void)
+{
+    double t0 = now_s();
+    uint8_t status = modbus_rtu_slave_poll(&slave);
+    slave_poll_s += now_s() - t0;
+    slave_poll_num++;
+    return status;
+}
+
+/* 主站串口 */
+static uint8_t master_tx(uint8_t *buf, uint16_t len)
+{
+    memcpy(slave_rx_buf, buf, len);
+    slave_rx_len = len;
+    slave_rx_ready = 1;
+    sim_now += len * master.char_us;
+    slave_poll();
+    return 0;
+}
+
+static uint8_t *master_rx_get_buf(void) { return master_rx_ready ? master_rx_buf : NULL; }
+static uint16_t master_rx_get_len(void) { return master_rx_len; }
+static void master_rx_reset(void) { master_rx_ready = 0; }
+
+/**
+ * @brief  按时间顺序触发主站接收与定时中断,直到主站空闲
+ */
+static void sim_run(void)
+{
+    while(modbus_rtu_master_pending(&master) != 0 || master.state != MODBUS_RTU_MASTER_IDLE)
+    {
+        if(sim_master_rx_at == SIM_NEVER && sim_timer_at == SIM_NEVER)
+        {
+            break;
+        }
+        if(sim_master_rx_at <= sim_timer_at)
+        {
+            sim_now = sim_master_rx_at;
+            sim_master_rx_at = SIM_NEVER;
+            master_rx_ready = 1;
+            modbus_rtu_master_rx_irq(&master);
+        }
+        else
+        {
+            sim_now = sim_timer_at;
+            sim_timer_at = SIM_NEVER;
+            modbus_rtu_master_timer_irq(&master);
+        }
+    }
+}
+
+static uint8_t last_status;
+static modbus_rtu_msg_t last_msg;
+static uint32_t done_num;
+static uint64_t done_at;
+
+static void request_done(uint8_t status, modbus_rtu_msg_t *msg, void *arg)
+{
+    (void)arg;
+    last_status = status;
+    if(msg != NULL)
+    {
+        last_msg = *msg;
+    }
+    done_num++;
+    done_at = sim_now;
+}
+
+int main(void)
+{
+    static modbus_rtu_region_t region[2];
+    modbus_rtu_fun_t master_fun = {master_tx, master_rx_reset, master_rx_get_buf, master_rx_get_len, NULL};
+    modbus_rtu_fun_t slave_fun = {NULL, slave_rx_reset, slave_rx_get_buf, slave_rx_get_len, NULL};
+    uint8_t data[8];
+
+    /* 应答缓冲不足以容纳异常应答 */
+    CHECK(modbus_rtu_slave_init(&slave, &slave_fun, 1, slave_tx_get_buf, slave_tx_start, 4) == MODBUS_STATUS_PARMINVAL);
+    CHECK(modbus_rtu_slave_init(&slave, &slave_fun, 1, slave_tx_get_buf, slave_tx_start, sizeof(slave_tx_buf)) == MODBUS_STATUS_OK);
+    region[0].table = MODBUS_RTU_TABLE_HOLDING_REGISTER;
+    region[0].num = SIM_REG_NUM;
+    region[0].value = holding;
+    region[1].table = MODBUS_RTU_TABLE_COIL;
+    region[1].num = SIM_COIL_NUM;
+    region[1].value = coil;
+    modbus_rtu_slave_region_add(&slave, &region[0]);
+    modbus_rtu_slave_region_add(&slave, &region[1]);
+    for(uint16_t i = 0; i < SIM_REG_NUM; i++)
+    {
+        holding[i] = 0x1000 + i;
+    }
+    modbus_rtu_master_init(&master, &master_fun, sim_timer_start, SIM_BAUDRATE);
+
+    /* 读写回环 */
+    CHECK(modbus_rtu_master_read(&master, 1, MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS, 10, 3, request_done, NULL) == MODBUS_STATUS_OK);
+    sim_run();
+    CHECK(done_num == 1 && last_status == MODBUS_STATUS_OK && last_msg.data_len == 6);//解析后去掉字节数
+    CHECK(last_msg.data[0] == 0x10 && last_msg.data[1] == 10 && last_msg.data[4] == 0x10 && last_msg.data[5] == 12);
+    data[0] = 0x12;
+    data[1] = 0x34;
+    data[2] = 0x56;
+    data[3] = 0x78;
+    CHECK(modbus_rtu_master_write(&master, 1, MODBUS_RTU_FUNCTION_CODE_WRITE_MULTIPLE_REGISTERS, 20, 2, data, 4, request_done, NULL) == MODBUS_STATUS_OK);
+    data[0] = 0x05;
+    CHECK(modbus_rtu_master_write(&master, 1, MODBUS_RTU_FUNCTION_CODE_WRITE_MULTIPLE_COILS, 8, 3, data, 1, request_done, NULL) == MODBUS_STATUS_OK);
+    sim_run();
+    CHECK(done_num == 3 && last_status == MODBUS_STATUS_OK);
+    CHECK(holding[20] == 0x1234 && holding[21] == 0x5678);
+    CHECK(coil[8] == 1 && coil[9] == 0 && coil[10] == 1);
+
+    /* 未映射地址返回异常应答 */
+    CHECK(modbus_rtu_master_read(&master, 1, MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS, SIM_REG_NUM, 1, request_done, NULL) == MODBUS_STATUS_OK);
+    sim_run();
+    CHECK(done_num == 4 && last_status == MODBUS_STATUS_EXCEPTION && last_msg.data[0] == MODBUS_RTU_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+
+    /* TX DMA缓冲忙: 保留接收帧,缓冲空闲后再次处理 */
+    memcpy(slave_rx_buf, (uint8_t[]){1, 0x03, 0x00, 0x05, 0x00, 0x01, 0x94, 0x0B}, 8);
+    slave_rx_len = 8;
+    slave_rx_ready = 1;
+    slave_tx_busy = 1;
+    slave_rx_reset_num = 0;
+    CHECK(modbus_rtu_slave_poll(&slave) == MODBUS_STATUS_ERROR);
+    CHECK(slave_rx_ready == 1 && slave_rx_reset_num == 0);
+    slave_tx_busy = 0;
+    CHECK(modbus_rtu_slave_poll(&slave) == MODBUS_STATUS_OK);
+    CHECK(slave_rx_ready == 0 && master_rx_len == 7 && master_rx_buf[4] == 0x05);
+    sim_master_rx_at = SIM_NEVER;
+
+    /* 往返时间: 从主站开始发送到应答回调 */
+    uint64_t total_us = 0;
+    slave_poll_s = 0;
+    slave_poll_num = 0;
+    for(uint32_t i = 0; i < SIM_ROUNDS; i++)
+    {
+        uint16_t num = 1 + i % 16;
+        uint32_t before = done_num;
+        sim_run();
+        uint64_t t0 = sim_now;
+        CHECK(modbus_rtu_master_read(&master, 1, MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS, i % 64, num, request_done, NULL) == MODBUS_STATUS_OK);
+        sim_run();
+        CHECK(done_num == before + 1 && last_status == MODBUS_STATUS_OK && last_msg.data_len == num * 2);
+        total_us += done_at - t0;
+    }
+    printf("loopback at %u bps: %.0f us per request on the bus, slave poll %.0f ns\n", SIM_BAUDRATE,
+           (double)total_us / SIM_ROUNDS, slave_poll_s / slave_poll_num * 1e9);
+
+    if(fail_num != 0)
+    {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
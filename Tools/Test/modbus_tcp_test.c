@@ -0,0 +1,257 @@
+/**
+ * @brief  modbus_tcp网关主机测试,TCP流分段/合并输入,经异步RTU主站转发到模拟从站,检查MBAP应答与0x0B网关超时异常
+ * @note   在仓库根目录编译运行:
+ *         gcc -O2 -Wall -Wno-unknown-pragmas -DCRC32_USE_HW=0 -ITools/Test/host -ITools/Inc Tools/Test/modbus_tcp_test.c Tools/Src/modbus_tcp.c Tools/Src/modbus_rtu.c Tools/Src/crc_tools.c Tools/Src/trace_log.c Tools/Src/usart_printf.c Tools/Src/uart_port.c Tools/Src/at_cmd_tools.c -o modbus_tcp_test
+ *         ./modbus_tcp_test
+ */
+#include "main.h"
+#include "modbus_rtu.h"
+#include "modbus_tcp.h"
+#include "crc_tools.h"
+
+#define SIM_NEVER 0xFFFFFFFFFFFFFFFFULL
+#define SIM_TURNAROUND_US 3000
+#define SIM_SILENT_UNIT 0x7F
+#define REPLY_MAX 16
+
+static uint64_t sim_now;
+static uint64_t sim_timer_at = SIM_NEVER;
+static uint64_t sim_rx_at = SIM_NEVER;
+static uint8_t sim_rx_buf[MODBUS_RTU_RECV_BUF_LEN + 8];
+static uint16_t sim_rx_len;
+static uint8_t sim_rx_ready;
+static uint32_t sim_frames;
+static uint8_t reply[REPLY_MAX][MODBUS_TCP_TX_BUF_LEN];
+static uint16_t reply_len[REPLY_MAX];
+static uint8_t reply_num;
+static modbus_rtu_master_t master;
+static modbus_tcp_gateway_t gw;
+static int fail_num;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %d: %s\n", __LINE__, #cond); fail_num++; } } while(0)
+
+uint32_t HAL_GetTick(void) { return (uint32_t)(sim_now / 1000); }
+void HAL_Delay(uint32_t Delay) { sim_now += Delay * 1000ULL; }
+void sys_delay_ms(uint32_t Delay) { (void)Delay; }
+void sys_delay_us(uint32_t udelay) { (void)udelay; }
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size) { (void)huart; (void)pData; (void)Size; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) { (void)huart; (void)pData; (void)Size; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart) { (void)huart; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart) { (void)huart; return HAL_OK; }
+
+static void sim_timer_start(uint32_t us)
+{
+    sim_timer_at = sim_now + us;
+}
+
+/**
+ * @brief  模拟RTU从站: 读保持寄存器返回unit * 256 + 地址,SIM_SILENT_UNIT不应答
+ */
+static uint8_t rtu_tx(uint8_t *buf, uint16_t len)
+{
+    uint8_t rsp[MODBUS_RTU_RECV_BUF_LEN + 8];
+    uint16_t n = 0;
+    uint16_t addr = buf[2] << 8 | buf[3];
+    uint16_t num = buf[4] << 8 | buf[5];
+
+    sim_frames++;
+    if(buf[0] == SIM_SILENT_UNIT || buf[0] == 0)
+    {
+        return 0;
+    }
+    rsp[n++] = buf[0];
+    rsp[n++] = buf[1];
+    rsp[n++] = num * 2;
+    for(uint16_t i = 0; i < num; i++)
+    {
+        rsp[n++] = buf[0];
+        rsp[n++] = (uint8_t)(addr + i);
+    }
+    uint16_t crc = modbus_rtu_crc16(rsp, n);
+    rsp[n++] = crc >> 8;
+    rsp[n++] = crc & 0xFF;
+    memcpy(sim_rx_buf, rsp, n);
+    sim_rx_len = n;
+    sim_rx_at = sim_now + len * master.char_us + SIM_TURNAROUND_US + (n + 1) * master.char_us;
+    return 0;
+}
+
+static uint8_t *rtu_rx_get_buf(void) { return sim_rx_ready ? sim_rx_buf : NULL; }
+static uint16_t rtu_rx_get_len(void) { return sim_rx_len; }
+static void rtu_rx_reset(void) { sim_rx_ready = 0; }
+
+/* 上行透传链路: 记录网关发出的应答 */
+static uint8_t net_tx(uint8_t *buf, uint16_t len)
+{
+    CHECK(reply_num < REPLY_MAX && len <= MODBUS_TCP_TX_BUF_LEN);
+    if(reply_num < REPLY_MAX)
+    {
+        memcpy(reply[reply_num], buf, len);
+        reply_len[reply_num] = len;
+        reply_num++;
+    }
+    return 0;
+}
+
+static uint8_t *net_rx_get_buf(void) { return NULL; }
+static uint16_t net_rx_get_len(void) { return 0; }
+static void net_rx_reset(void) {}
+
+/**
+ * @brief  按时间顺序触发接收与定时中断,直到主站空闲
+ */
+static void sim_run(void)
+{
+    while(modbus_rtu_master_pending(&master) != 0 || master.state != MODBUS_RTU_MASTER_IDLE)
+    {
+        if(sim_rx_at == SIM_NEVER && sim_timer_at == SIM_NEVER)
+        {
+            break;
+        }
+        if(sim_rx_at <= sim_timer_at)
+        {
+            sim_now = sim_rx_at;
+            sim_rx_at = SIM_NEVER;
+            sim_rx_ready = 1;
+            modbus_rtu_master_rx_irq(&master);
+        }
+        else
+        {
+            sim_now = sim_timer_at;
+            sim_timer_at = SIM_NEVER;
+            modbus_rtu_master_timer_irq(&master);
+        }
+    }
+}
+
+/**
+ * @brief  组读保持寄存器请求
+ * @retval 帧长度
+ */
+static uint16_t mbap_read(uint8_t *buf, uint16_t transaction_id, uint8_t unit, uint16_t addr, uint16_t num)
+{
+    const uint8_t frame[12] = {transaction_id >> 8, transaction_id & 0xFF, 0, 0, 0, 6, unit,
+                               MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS, addr >> 8, addr & 0xFF, num >> 8, num & 0xFF};
+    memcpy(buf, frame, sizeof(frame));
+    return sizeof(frame);
+}
+
+/**
+ * @brief  检查读保持寄存器应答的MBAP头与数据
+ */
+static uint8_t reply_read_ok(uint8_t index, uint16_t transaction_id, uint8_t unit, uint16_t addr, uint16_t num)
+{
+    const uint8_t *r = reply[index];
+
+    if(reply_len[index] != MODBUS_TCP_MBAP_LEN + 2 + num * 2 || (r[0] << 8 | r[1]) != transaction_id ||
+       r[2] != 0 || r[3] != 0 || (r[4] << 8 | r[5]) != 3 + num * 2 || r[6] != unit ||
+       r[7] != MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS || r[8] != num * 2)
+    {
+        return 0;
+    }
+    for(uint16_t i = 0; i < num; i++)
+    {
+        if(r[9 + i * 2] != unit || r[10 + i * 2] != (uint8_t)(addr + i))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief  检查异常应答
+ */
+static uint8_t reply_exception_ok(uint8_t index, uint16_t transaction_id, uint8_t unit, uint8_t exception)
+{
+    const uint8_t *r = reply[index];
+
+    return reply_len[index] == MODBUS_TCP_MBAP_LEN + 2 && (r[0] << 8 | r[1]) == transaction_id &&
+           (r[4] << 8 | r[5]) == 3 && r[6] == unit &&
+           r[7] == (MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS | 0x80) && r[8] == exception;
+}
+
+int main(void)
+{
+    modbus_rtu_fun_t rtu = {rtu_tx, rtu_rx_reset, rtu_rx_get_buf, rtu_rx_get_len, NULL};
+    modbus_rtu_fun_t net = {net_tx, net_rx_reset, net_rx_get_buf, net_rx_get_len, NULL};
+    uint8_t stream[128];
+    uint16_t len;
+
+    modbus_rtu_master_init(&master, &rtu, sim_timer_start, 9600);
+    modbus_tcp_gateway_init(&gw, &master, &net);
+
+    /* 单帧逐字节到达,MBAP头也被拆开 */
+    len = mbap_read(stream, 0x1234, 1, 0x10, 3);
+    for(uint16_t i = 0; i < len; i++)
+    {
+        CHECK(modbus_tcp_gateway_input(&gw, &stream[i], 1) == (i == len - 1));
+    }
+    sim_run();
+    CHECK(reply_num == 1 && reply_read_ok(0, 0x1234, 1, 0x10, 3));
+
+    /* 两帧合并为一段,第三帧拆在两段之间 */
+    reply_num = 0;
+    len = mbap_read(stream, 1, 2, 0, 1);
+    len += mbap_read(&stream[len], 2, 3, 0x20, 4);
+    len += mbap_read(&stream[len], 3, 4, 0x30, 2);
+    CHECK(modbus_tcp_gateway_input(&gw, stream, len - 8) == 2);
+    CHECK(modbus_tcp_gateway_input(&gw, &stream[len - 8], 8) == 1);
+    sim_run();
+    CHECK(reply_num == 3);
+    CHECK(reply_read_ok(0, 1, 2, 0, 1) && reply_read_ok(1, 2, 3, 0x20, 4) && reply_read_ok(2, 3, 4, 0x30, 2));
+
+    /* 从站不应答: 重试用尽后返回0x0B网关目标无响应 */
+    reply_num = 0;
+    sim_frames = 0;
+    len = mbap_read(stream, 0xBEEF, SIM_SILENT_UNIT, 0, 1);
+    CHECK(modbus_tcp_gateway_input(&gw, stream, len) == 1);
+    sim_run();
+    CHECK(sim_frames == 1 + MODBUS_RTU_RETRY);
+    CHECK(reply_num == 1 && reply_exception_ok(0, 0xBEEF, SIM_SILENT_UNIT, MODBUS_TCP_EXCEPTION_GATEWAY_TARGET));
+
+    /* 超时事务之后的请求正常转发,事务槽已释放 */
+    reply_num = 0;
+    for(uint8_t i = 0; i < MODBUS_TCP_TXN_NUM; i++)
+    {
+        len = mbap_read(stream, 0x100 + i, 5, i, 1);
+        CHECK(modbus_tcp_gateway_input(&gw, stream, len) == 1);
+    }
+    sim_run();
+    CHECK(reply_num == MODBUS_TCP_TXN_NUM);
+    for(uint8_t i = 0; i < reply_num; i++)
+    {
+        CHECK(reply_read_ok(i, 0x100 + i, 5, i, 1));
+    }
+
+    /* 非MBAP字节逐字节丢弃后重新同步 */
+    reply_num = 0;
+    memset(stream, 0xA5, 5);
+    len = 5 + mbap_read(&stream[5], 7, 6, 1, 1);
+    CHECK(modbus_tcp_gateway_input(&gw, stream, len) == 1);
+    sim_run();
+    CHECK(gw.drop_count == 5 && reply_num == 1 && reply_read_ok(0, 7, 6, 1, 1));
+
+    /* 超过RTU缓冲的帧返回0x03并跳过其余字节,其后的帧不受影响 */
+    reply_num = 0;
+    len = MODBUS_TCP_MBAP_LEN + MODBUS_TCP_PDU_MAX_LEN + 10;
+    memset(stream, 0, len);
+    stream[1] = 9;
+    stream[4] = (len - 6) >> 8;
+    stream[5] = (len - 6) & 0xFF;
+    stream[6] = 1;
+    stream[7] = MODBUS_RTU_FUNCTION_CODE_READ_HOLDING_REGISTERS;
+    len += mbap_read(&stream[len], 10, 1, 2, 1);
+    CHECK(modbus_tcp_gateway_input(&gw, stream, 20) == 0);
+    CHECK(modbus_tcp_gateway_input(&gw, &stream[20], len - 20) == 1);
+    sim_run();
+    CHECK(reply_num == 2 && reply_exception_ok(0, 9, 1, MODBUS_TCP_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(reply_read_ok(1, 10, 1, 2, 1));
+
+    if(fail_num != 0)
+    {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * @brief  net_at_config_load/net_at_config_apply主机测试,模拟USR-TCP232的AT应答与应答延迟
+ * @note   在仓库根目录编译运行:
+ *         gcc -O2 -Wall -ITools/Test/host -ITools/Inc -IModule_Driver/Ethernet/USR_TCP232_Ethernet/Inc Tools/Test/net_at_config_test.c Module_Driver/Ethernet/USR_TCP232_Ethernet/Src/net_at_fun.c Tools/Src/at_cmd_tools.c -o net_at_config_test
+ *         ./net_at_config_test
+ */
+#include <stdarg.h>
+#include "main.h"
+#include "usart.h"
+#include "mcu_config.h"
+#include "net_at_fun.h"
+#include "trace_log.h"
+
+#define MOCK_ACK_DELAY_MS 30//模块应答延迟
+
+volatile uint32_t trace_log_mask[TRACE_LEVEL_NUM];
+void trace_log_write(const char *fmt, const int32_t *arg, uint8_t num) { (void)fmt; (void)arg; (void)num; }
+
+static uint32_t mock_tick, mock_ready_tick;
+static uint32_t mock_cmd_num, mock_set_num, mock_restart_num;
+static char mock_rx[256], mock_pending[256];
+/* 模块内保存的配置 */
+static char mock_wann[64] = "DHCP,0.0.0.0,0.0.0.0,0.0.0.0";
+static char mock_sock[64] = "TCPC,0.0.0.0,0";
+static char mock_sockport[32] = "0,0";
+static int fail_num;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %d: %s\n", __LINE__, #cond); fail_num++; } } while(0)
+
+uint32_t HAL_GetTick(void) { return mock_tick; }
+void HAL_Delay(uint32_t Delay) { mock_tick += Delay; }
+void sys_delay_ms(uint32_t Delay) { mock_tick += Delay; }
+
+void NET_rx_reset(void)
+{
+    mock_rx[0] = '\0';
+}
+
+uint8_t *NET_rx_get_buf(void)
+{
+    if(mock_pending[0] != '\0' && mock_tick >= mock_ready_tick)
+    {
+        strcpy(mock_rx, mock_pending);
+        mock_pending[0] = '\0';
+    }
+    return mock_rx[0] != '\0' ? (uint8_t *)mock_rx : NULL;
+}
+
+static void mock_reply(const char *reply)
+{
+    strcpy(mock_pending, reply);
+    mock_ready_tick = mock_tick + MOCK_ACK_DELAY_MS;
+}
+
+/**
+ * @brief  模拟模块解析命令: 查询返回保存值,设置更新保存值
+ */
+uint8_t NET_printf(char *fmt, ...)
+{
+    char cmd[256], reply[128];
+    va_list args;
+    char *end, *para;
+
+    va_start(args, fmt);
+    vsnprintf(cmd, sizeof(cmd), fmt, args);
+    va_end(args);
+    mock_cmd_num++;
+
+    if(strcmp(cmd, "+++") == 0)
+    {
+        mock_reply("a");
+        return 0;
+    }
+    if(strcmp(cmd, "a") == 0)
+    {
+        mock_reply("+OK");
+        return 0;
+    }
+    end = strchr(cmd, '\r');
+    if(end != NULL)
+    {
+        *end = '\0';
+    }
+    para = strchr(cmd, '=');
+    if(para != NULL)
+    {
+        *para++ = '\0';
+        mock_set_num++;
+        if(strcmp(cmd, "AT+WANN") == 0) strcpy(mock_wann, para);
+        else if(strcmp(cmd, "AT+SOCK") == 0) strcpy(mock_sock, para);
+        else if(strcmp(cmd, "AT+SOCKPORT") == 0) strcpy(mock_sockport, para);
+        mock_reply("\r\n+OK\r\n");
+    }
+    else if(strcmp(cmd, "AT+WANN") == 0 || strcmp(cmd, "AT+SOCK") == 0 || strcmp(cmd, "AT+SOCKPORT") == 0)
+    {
+        const char *value = (strcmp(cmd, "AT+WANN") == 0) ? mock_wann :
+                            (strcmp(cmd, "AT+SOCK") == 0) ? mock_sock : mock_sockport;
+        sprintf(reply, "\r\n+OK=%s\r\n", value);
+        mock_reply(reply);
+    }
+    else
+    {
+        if(strcmp(cmd, "AT+Z") == 0)
+        {
+            mock_restart_num++;
+        }
+        mock_reply("\r\n+OK\r\n");
+    }
+    return 0;
+}
+
+/**
+ * @brief  执行一次apply,返回下发的设置命令数
+ */
+static uint32_t apply(const char *name, const mcu_network_config_t *config)
+{
+    uint32_t start = mock_tick;
+    at_cmd_status_t ret;
+
+    mock_cmd_num = 0;
+    mock_set_num = 0;
+    ret = net_at_config_apply(config);
+    printf("%-32s ret=%d cmds=%2u set=%u time=%5u ms\n", name, ret, mock_cmd_num, mock_set_num, mock_tick - start);
+    CHECK(ret == AT_CMD_OK);
+    return mock_set_num;
+}
+
+int main(void)
+{
+    mcu_network_config_t config = {0};
+
+    net_at_fun_init();
+    config.dhcp_flag = 0;
+    strcpy(config.static_local_ip, "192.168.1.20");
+    strcpy(config.local_mask, "255.255.255.0");
+    strcpy(config.local_gateway, "192.168.1.1");
+    strcpy(config.tcp_server_ip, "192.168.1.100");
+    strcpy(config.tcp_server_port, "502");
+    strcpy(config.static_local_port, "20108");
+
+    /* 无快照时下发全部命令 */
+    CHECK(apply("apply without snapshot", &config) == 3);
+    CHECK(strcmp(mock_sockport, "502,20108") == 0);
+
+    CHECK(net_at_config_load() == AT_CMD_OK);
+    CHECK(apply("apply, unchanged", &config) == 0);
+
+    strcpy(config.tcp_server_ip, "192.168.1.101");
+    CHECK(apply("apply, server ip changed", &config) == 1);
+    CHECK(strcmp(mock_sock, "TCPC,192.168.1.101,502") == 0);
+
+    /* 模块SOCKPORT中的服务器端口被外部改动,与SOCK中的端口不一致 */
+    strcpy(mock_sockport, "600,20108");
+    CHECK(net_at_config_load() == AT_CMD_OK);
+    CHECK(apply("apply, sockport server differs", &config) == 1);
+    CHECK(strcmp(mock_sockport, "502,20108") == 0);
+    CHECK(apply("apply again, unchanged", &config) == 0);
+
+    /* DHCP下静态地址不比较 */
+    config.dhcp_flag = 1;
+    CHECK(apply("apply, dhcp on", &config) == 1);
+    strcpy(config.local_gateway, "192.168.1.254");
+    CHECK(apply("apply, static fields under dhcp", &config) == 0);
+
+    net_at_config_invalidate();
+    CHECK(apply("apply after invalidate", &config) == 3);
+
+    if(fail_num != 0)
+    {
+        return 1;
+    }
+    printf("ok, restarts %u\n", mock_restart_num);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/**
+ * @brief  uart_ring_rx_update主机测试,模拟循环DMA的剩余计数(NDTR)、半满/满中断与空闲中断
+ * @note   在仓库根目录编译运行:
+ *         gcc -O2 -Wall -Wno-unknown-pragmas -ITools/Test/host -ITools/Inc Tools/Test/uart_ring_test.c Tools/Src/usart_printf.c Tools/Src/uart_port.c Tools/Src/trace_log.c Tools/Src/at_cmd_tools.c -o uart_ring_test
+ *         ./uart_ring_test
+ */
+#include "main.h"
+#include "usart_printf.h"
+
+#define RING_SIZE 64
+
+static USART_TypeDef sim_usart;
+static DMA_HandleTypeDef sim_dma_rx;
+static UART_HandleTypeDef sim_huart = {&sim_usart, NULL, &sim_dma_rx, HAL_UART_STATE_READY};
+static uint8_t ring_buf[RING_SIZE];
+static uart_rx_ring ring;
+static uart_tx_frame tx_frame;
+static int fail_num;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %d: %s\n", __LINE__, #cond); fail_num++; } } while(0)
+
+uint32_t HAL_GetTick(void) { return 0; }
+void HAL_Delay(uint32_t Delay) { (void)Delay; }
+void sys_delay_ms(uint32_t Delay) { (void)Delay; }
+void sys_delay_us(uint32_t udelay) { (void)udelay; }
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size) { (void)huart; (void)pData; (void)Size; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart) { (void)huart; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart) { (void)huart; return HAL_OK; }
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    (void)pData;
+    huart->hdmarx->CNDTR = Size;
+    return HAL_OK;
+}
+
+/**
+ * @brief  模拟DMA循环写入:NDTR递减至0后重装为RING_SIZE,经过半满与满位置时进入DMA回调
+ * @param  data: 接收数据
+ * @param  len: 数据长度
+ * @param  idle: 1-数据后总线空闲,进入空闲中断
+ */
+static void sim_rx(const char *data, uint16_t len, uint8_t idle)
+{
+    for(uint16_t i = 0; i < len; i++)
+    {
+        ring_buf[RING_SIZE - sim_dma_rx.CNDTR] = (uint8_t)data[i];
+        sim_dma_rx.CNDTR--;
+        if(sim_dma_rx.CNDTR == RING_SIZE / 2)
+        {
+            uart_ring_dma_irq(&sim_dma_rx, &ring);//HAL_UART_RxHalfCpltCallback
+        }
+        else if(sim_dma_rx.CNDTR == 0)
+        {
+            sim_dma_rx.CNDTR = RING_SIZE;
+            uart_ring_dma_irq(&sim_dma_rx, &ring);//HAL_UART_RxCpltCallback
+        }
+    }
+    if(idle != 0)
+    {
+        sim_usart.SR |= UART_FLAG_IDLE;
+        uart_ring_irq(&sim_huart, &sim_dma_rx, &ring);
+        CHECK((sim_usart.SR & UART_FLAG_IDLE) == 0);
+    }
+}
+
+/**
+ * @brief  取出队首帧拷贝为字符串并释放
+ * @param  out: 输出缓冲,不小于RING_SIZE + 1
+ * @param  wrap: 输出帧是否跨越缓冲末尾,可为NULL
+ * @retval 1-有帧 0-无帧
+ */
+static uint8_t take(char *out, uint8_t *wrap)
+{
+    uart_rx_span span;
+
+    if(uart_ring_peek(&ring, &span) == 0)
+    {
+        return 0;
+    }
+    uart_rx_span_copy(&span, (uint8_t *)out, RING_SIZE + 1);
+    if(wrap != NULL)
+    {
+        *wrap = (span.len[1] != 0);
+    }
+    uart_ring_release(&ring);
+    return 1;
+}
+
+static void restart(void)
+{
+    uart_ring_init(&ring, ring_buf, RING_SIZE);
+    uart_ring_enable_dma_it(&sim_huart, &ring, &tx_frame);
+}
+
+int main(void)
+{
+    char out[RING_SIZE + 1];
+    uint8_t wrap;
+
+    /* 连续多帧排队,任务晚于中断读取 */
+    restart();
+    sim_rx("AT+A\r\n", 6, 1);
+    sim_rx("OK\r\n", 4, 1);
+    sim_rx("+RECV:3\r\n", 9, 1);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "AT+A\r\n") == 0);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "OK\r\n") == 0);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "+RECV:3\r\n") == 0);
+    CHECK(take(out, NULL) == 0);
+
+    /* 帧内经过半满位置,未超过半个缓冲不拆分 */
+    restart();
+    sim_rx("0123456789012345678901234", 25, 1);
+    sim_rx("abcdefghijklmnop", 16, 1);
+    CHECK(take(out, &wrap) == 1 && strcmp(out, "0123456789012345678901234") == 0 && wrap == 0);
+    CHECK(take(out, &wrap) == 1 && strcmp(out, "abcdefghijklmnop") == 0 && wrap == 0);
+
+    /* 帧跨越缓冲末尾,NDTR经过满中断重装 */
+    sim_rx("WRAPPED-FRAME-0123456789", 24, 1);
+    CHECK(take(out, &wrap) == 1 && strcmp(out, "WRAPPED-FRAME-0123456789") == 0 && wrap == 1);
+    CHECK(ring.overflow == 0);
+
+    /* 帧恰好结束于缓冲末尾: 空闲中断时NDTR已重装为size */
+    restart();
+    sim_rx("01234567890123456789", 20, 1);
+    sim_rx("abcdefghijabcdefghij", 20, 1);
+    CHECK(take(out, NULL) == 1 && take(out, NULL) == 1);
+    sim_rx("END-AT-BUFFER-TAIL-01234", 24, 1);
+    CHECK(sim_dma_rx.CNDTR == RING_SIZE);
+    CHECK(take(out, &wrap) == 1 && strcmp(out, "END-AT-BUFFER-TAIL-01234") == 0 && wrap == 0);
+    CHECK(take(out, NULL) == 0);
+
+    /* NDTR读到0(重装前)按位置0处理 */
+    restart();
+    memcpy(ring_buf, "ZERO", 4);
+    uart_ring_rx_update(&ring, RING_SIZE - 4, 1);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "ZERO") == 0);
+    memcpy(&ring_buf[4], "0123456789012345678901234567890123456789012345678901234567890", 60);
+    uart_ring_rx_update(&ring, 0, 1);
+    CHECK(take(out, &wrap) == 1 && strlen(out) == 60 && wrap == 0);
+
+    /* 无空闲的长数据流在半满/满中断处按半个缓冲拆分 */
+    restart();
+    sim_rx("0123456789012345678901234567890123456789", 40, 0);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "01234567890123456789012345678901") == 0);
+    CHECK(take(out, NULL) == 0);
+    sim_rx("abcdefghijabcdefghijabcdefghijabcdefghij", 40, 0);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "23456789abcdefghijabcdefghijabcd") == 0);
+    CHECK(take(out, NULL) == 0);
+    sim_rx("", 0, 1);
+    CHECK(take(out, &wrap) == 1 && strcmp(out, "efghijabcdefghij") == 0 && wrap == 0);
+    CHECK(ring.overflow == 0);
+
+    /* 消费者未释放时长数据流覆盖拆分出的帧,peek跳过全部已覆盖的帧 */
+    restart();
+    sim_rx("0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789", 100, 0);
+    CHECK(ring.overflow == 1);
+    sim_rx("", 0, 1);
+    CHECK(ring.overflow == 2);
+    CHECK(take(out, NULL) == 0);
+
+    /* 描述符队列满: 丢弃新帧,已排队的帧不受影响 */
+    restart();
+    for(uint8_t i = 0; i < UART_RX_RING_DESC_NUM + 2; i++)
+    {
+        char frame[2] = {(char)('a' + i), '\0'};
+        sim_rx(frame, 1, 1);
+    }
+    CHECK(ring.overflow == 2);
+    for(uint8_t i = 0; i < UART_RX_RING_DESC_NUM; i++)
+    {
+        CHECK(take(out, NULL) == 1 && out[0] == 'a' + i && out[1] == '\0');
+    }
+    CHECK(take(out, NULL) == 0);
+
+    /* 未释放的帧被DMA覆盖: 丢弃当前帧并计入overflow,peek跳过已覆盖的帧 */
+    restart();
+    sim_rx("FIRST", 5, 1);
+    sim_rx("012345678901234567890123456789", 30, 1);
+    sim_rx("abcdefghijklmnopqrstuvwxyzabcd", 30, 1);
+    CHECK(ring.overflow == 1);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "012345678901234567890123456789") == 0);
+    CHECK(take(out, NULL) == 0);
+    sim_rx("NEXT", 4, 1);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "NEXT") == 0);
+
+    /* 半满中断被延迟,两次更新间当前帧超过缓冲大小 */
+    restart();
+    memset(ring_buf, 'x', RING_SIZE);
+    uart_ring_rx_update(&ring, RING_SIZE - 20, 0);
+    uart_ring_rx_update(&ring, RING_SIZE - 20 - 50 + RING_SIZE, 1);
+    CHECK(ring.overflow == 1);
+    CHECK(take(out, NULL) == 0);
+    sim_dma_rx.CNDTR = RING_SIZE - 6;
+    sim_rx("AFTER", 5, 1);
+    CHECK(take(out, NULL) == 1 && strcmp(out, "AFTER") == 0);
+
+    if(fail_num != 0)
+    {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}